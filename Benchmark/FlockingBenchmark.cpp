@@ -0,0 +1,1006 @@
+/* Standalone benchmark of the engine independent flocking simulation.
+ * Runs synthetic flocks of increasing sizes for a fixed number of ticks, and reports the cost per boid and per tick,
+ * the number of neighbors tested and the memory used by the simulation.
+ * Can also record the ticks of a run to a file, and replay a recording made by the benchmark or by the flocking component.
+ */
+
+#include "FlockingCore/AFCoreFlockSimulation.h"
+#include "FlockingCore/AFCoreFixedTimestep.h"
+#include "FlockingCore/AFCoreFlockQuantization.h"
+#include "FlockingCore/AFCoreFlockRecorder.h"
+#include "FlockingCore/AFCoreIntegration.h"
+#include "FlockingCore/AFCoreMortonOrder.h"
+#include "FlockingCore/AFCoreSyntheticFlocks.h"
+#include "FlockingCore/AFCoreUpdateScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined( __linux__ )
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+using namespace AFFlockingCore;
+
+namespace
+{
+    struct FBenchmarkOptions
+    {
+        std::vector< int32_t > FlockSizes { 100, 1000, 10000, 100000 };
+        int32_t TicksCount = 100;
+        // Each size is split in this number of flocks, simulated together like the flocking subsystem does
+        int32_t FlocksCount = 1;
+        int32_t ThreadsCount = 1;
+        uint32_t Seed = 12345;
+        // Average distance between two boids, which keeps the density of the flock constant whatever its size
+        float BoidSpacing = 150.0f;
+        float DeltaTime = 1.0f / 60.0f;
+        // Levels of detail relative to a viewer at the origin, and budget of the steering update. A budget of 0 is unlimited
+        bool bUseLOD = false;
+        float BudgetMicroseconds = 0.0f;
+        // Topological mode : number of nearest neighbors taken into account by each force. 0 uses all the boids within the radii
+        int32_t MaxNeighborsCount = 0;
+        float AlignmentRadius = 300.0f;
+        float CohesionRadius = 500.0f;
+        // The forces which are not enabled get a weight of 0, which selects the steering kernels without them
+        bool bUseAlignment = true;
+        bool bUseCohesion = true;
+        bool bUseSeparation = true;
+        // Computes alignment and cohesion with the far field octree
+        bool bUseFarFieldOctree = false;
+        // Number of ticks between two sorts of the boids of each flock along a Z-order curve. 0 keeps the order in which they were spawned
+        int32_t MortonSortInterval = 0;
+        // Rate of the steering update, in steps per second, independent from the 60 ticks per second of the boids movement. 0 updates the steering every tick
+        float FixedRate = 0.0f;
+        int32_t MaxStepsCount = 4;
+        // Number of ticks between two replicated states of each flock, quantized and delta encoded against the previous one. 0 disables the measure
+        int32_t ReplicationInterval = 0;
+        float ReplicationPositionPrecision = 2.0f;
+        float ReplicationVelocityPrecision = 1.0f;
+        // Every tick of the last size is recorded in this file when it is not empty
+        std::string RecordPath;
+        // When not empty, the frames of this recording are replayed instead of running the synthetic flocks
+        std::string ReplayPath;
+        FSteeringOptions SteeringOptions;
+    };
+
+    /* Counts the hardware cache misses of the process, including the threads created after the counter, through perf_event_open.
+     * Unavailable on other platforms, in most containers, and when perf_event_paranoid forbids it */
+    class FCacheMissesCounter
+    {
+    public:
+        explicit FCacheMissesCounter( const uint64_t cache_id ) :
+            FileDescriptor( -1 )
+        {
+#if defined( __linux__ )
+            perf_event_attr attributes;
+            std::memset( &attributes, 0, sizeof( attributes ) );
+            attributes.type = PERF_TYPE_HW_CACHE;
+            attributes.size = sizeof( attributes );
+            attributes.config = cache_id | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 );
+            attributes.inherit = 1;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            FileDescriptor = static_cast< int >( syscall( SYS_perf_event_open, &attributes, 0, -1, -1, 0 ) );
+#else
+            ( void ) cache_id;
+#endif
+        }
+
+        ~FCacheMissesCounter()
+        {
+#if defined( __linux__ )
+            if ( FileDescriptor >= 0 )
+            {
+                close( FileDescriptor );
+            }
+#endif
+        }
+
+        FCacheMissesCounter( const FCacheMissesCounter & ) = delete;
+        FCacheMissesCounter & operator=( const FCacheMissesCounter & ) = delete;
+
+        bool IsAvailable() const
+        {
+            return FileDescriptor >= 0;
+        }
+
+        // Sum over the process and its threads
+        uint64_t Read() const
+        {
+            uint64_t value = 0;
+#if defined( __linux__ )
+            if ( FileDescriptor < 0 || read( FileDescriptor, &value, sizeof( value ) ) != static_cast< ssize_t >( sizeof( value ) ) )
+            {
+                return 0;
+            }
+#endif
+            return value;
+        }
+
+    private:
+        int FileDescriptor;
+    };
+
+    struct FCacheMissesCounters
+    {
+        FCacheMissesCounters() :
+#if defined( __linux__ )
+            L1D( PERF_COUNT_HW_CACHE_L1D ),
+            LLC( PERF_COUNT_HW_CACHE_LL )
+#else
+            L1D( 0 ),
+            LLC( 0 )
+#endif
+        {
+        }
+
+        FCacheMissesCounter L1D;
+        FCacheMissesCounter LLC;
+    };
+
+    /* Keeps worker threads alive between the ticks, so the benchmark does not measure the thread creation */
+    class FWorkerPool
+    {
+    public:
+        explicit FWorkerPool( const int32_t threads_count ) :
+            Generation( 0 ),
+            PendingWorkersCount( 0 ),
+            bExit( false )
+        {
+            for ( auto thread_index = 1; thread_index < threads_count; ++thread_index )
+            {
+                Workers.emplace_back( [ this, thread_index ]() {
+                    WorkerLoop( thread_index );
+                } );
+            }
+        }
+
+        ~FWorkerPool()
+        {
+            {
+                std::lock_guard< std::mutex > lock( Mutex );
+                bExit = true;
+            }
+
+            WakeUp.notify_all();
+
+            for ( auto & worker : Workers )
+            {
+                worker.join();
+            }
+        }
+
+        int32_t GetThreadsCount() const
+        {
+            return static_cast< int32_t >( Workers.size() ) + 1;
+        }
+
+        // Calls job( thread_index ) on every thread of the pool, the calling thread included, and waits for all of them
+        void Run( const std::function< void( int32_t ) > & job )
+        {
+            {
+                std::lock_guard< std::mutex > lock( Mutex );
+                Job = job;
+                PendingWorkersCount = static_cast< int32_t >( Workers.size() );
+                ++Generation;
+            }
+
+            WakeUp.notify_all();
+            job( 0 );
+
+            std::unique_lock< std::mutex > lock( Mutex );
+            Done.wait( lock, [ this ]() {
+                return PendingWorkersCount == 0;
+            } );
+        }
+
+    private:
+        void WorkerLoop( const int32_t thread_index )
+        {
+            uint64_t last_generation = 0;
+
+            for ( ;; )
+            {
+                std::function< void( int32_t ) > job;
+
+                {
+                    std::unique_lock< std::mutex > lock( Mutex );
+                    WakeUp.wait( lock, [ this, last_generation ]() {
+                        return bExit || Generation != last_generation;
+                    } );
+
+                    if ( bExit )
+                    {
+                        return;
+                    }
+
+                    last_generation = Generation;
+                    job = Job;
+                }
+
+                job( thread_index );
+
+                {
+                    std::lock_guard< std::mutex > lock( Mutex );
+                    --PendingWorkersCount;
+                }
+
+                Done.notify_one();
+            }
+        }
+
+        std::vector< std::thread > Workers;
+        std::mutex Mutex;
+        std::condition_variable WakeUp;
+        std::condition_variable Done;
+        std::function< void( int32_t ) > Job;
+        uint64_t Generation;
+        int32_t PendingWorkersCount;
+        bool bExit;
+    };
+
+    struct FBenchmarkResult
+    {
+        int32_t BoidsCount;
+        double SteeringNanosecondsPerBoidPerTick;
+        double NeighborCandidatesPerBoid;
+        double PairTestsPerBoid;
+        double UpdatedBoidsRatio;
+        double NeighborListsRebuildsRatio;
+        double NeighborListsAverageLength;
+        double SteppedTicksRatio;
+        size_t SimulationBytes;
+        // Misses per boid and per tick during the steering update. Negative when the counter is unavailable
+        double L1DMissesPerBoid;
+        double LLCMissesPerBoid;
+        double Checksum;
+        // Sum of the components of the steering velocities computed during the run. Only computed when recording, to compare with the replay
+        double SteeringChecksum;
+        // Size of the first replicated state, without base, and of the following delta encoded states
+        double ReplicationFullBytesPerBoid;
+        double ReplicationDeltaBytesPerBoid;
+        // Distance between the boids and their replicated location
+        double ReplicationMaxLocationError;
+        bool bReplicationDecodeMatches;
+    };
+
+    /* Quantizes and encodes the flocks like the replication of the flocking component, each state being delta encoded against the previous one, and decodes them back */
+    class FReplicationMeasure
+    {
+    public:
+        FReplicationMeasure() :
+            FullBitsCount( 0 ),
+            DeltaBitsCount( 0 ),
+            FullBoidsCount( 0 ),
+            DeltaBoidsCount( 0 ),
+            MaxLocationError( 0.0 ),
+            bDecodeMatches( true )
+        {
+        }
+
+        void Send( const FFlockState & state, const FBenchmarkOptions & options )
+        {
+            const auto flocks_count = static_cast< int32_t >( state.Flocks.size() );
+            const auto is_first_state = SentFlocks.empty();
+
+            SentFlocks.resize( flocks_count );
+
+            for ( auto flock_index = 0; flock_index < flocks_count; ++flock_index )
+            {
+                const auto & flock = state.Flocks[ flock_index ];
+                auto & sent_flock = SentFlocks[ flock_index ];
+                auto & quantized_flock = QuantizedFlock;
+
+                quantized_flock.Reset( flock.OwnerLocation, options.ReplicationPositionPrecision, options.ReplicationVelocityPrecision, flock.BoidsCount );
+
+                for ( auto index = 0; index < flock.BoidsCount; ++index )
+                {
+                    const auto & boid = state.Boids[ flock.FirstBoidIndex + index ];
+                    quantized_flock.SetBoid( index, boid.Center, boid.Velocity );
+                    MaxLocationError = std::max( MaxLocationError, static_cast< double >( ( quantized_flock.GetBoidLocation( index ) - boid.Center ).Size() ) );
+                }
+
+                Writer.Reset();
+                EncodeQuantizedFlock( Writer, quantized_flock, is_first_state ? nullptr : &sent_flock );
+
+                FBitsReader reader( Writer.GetBytes().data(), Writer.GetBitsCount() );
+                bDecodeMatches &= DecodeQuantizedFlock( reader, DecodedFlock, is_first_state ? nullptr : &sent_flock ) && DecodedFlock == quantized_flock;
+
+                ( is_first_state ? FullBitsCount : DeltaBitsCount ) += Writer.GetBitsCount();
+                ( is_first_state ? FullBoidsCount : DeltaBoidsCount ) += flock.BoidsCount;
+                std::swap( sent_flock, quantized_flock );
+            }
+        }
+
+        void GetResult( FBenchmarkResult & result ) const
+        {
+            result.ReplicationFullBytesPerBoid = static_cast< double >( FullBitsCount ) / 8.0 / static_cast< double >( std::max< int64_t >( FullBoidsCount, 1 ) );
+            result.ReplicationDeltaBytesPerBoid = static_cast< double >( DeltaBitsCount ) / 8.0 / static_cast< double >( std::max< int64_t >( DeltaBoidsCount, 1 ) );
+            result.ReplicationMaxLocationError = MaxLocationError;
+            result.bReplicationDecodeMatches = bDecodeMatches;
+        }
+
+    private:
+        std::vector< FQuantizedFlock > SentFlocks;
+        FQuantizedFlock QuantizedFlock;
+        FQuantizedFlock DecodedFlock;
+        FBitsWriter Writer;
+        int64_t FullBitsCount;
+        int64_t DeltaBitsCount;
+        int64_t FullBoidsCount;
+        int64_t DeltaBoidsCount;
+        double MaxLocationError;
+        bool bDecodeMatches;
+    };
+
+    FSyntheticFlocksParams GetSyntheticFlocksParams( const FBenchmarkOptions & options )
+    {
+        FSyntheticFlocksParams params;
+        params.FlocksCount = options.FlocksCount;
+        params.Seed = options.Seed;
+        params.BoidSpacing = options.BoidSpacing;
+        params.bUseLOD = options.bUseLOD;
+        params.Params.MaxNeighborsCount = options.MaxNeighborsCount;
+        params.Params.AlignmentRadius = options.AlignmentRadius;
+        params.Params.CohesionRadius = options.CohesionRadius;
+        params.Params.AlignmentWeight = options.bUseAlignment ? 1.0f : 0.0f;
+        params.Params.CohesionWeight = options.bUseCohesion ? 1.0f : 0.0f;
+        params.Params.SeparationWeight = options.bUseSeparation ? 1.0f : 0.0f;
+        params.Params.bUseFarFieldOctree = options.bUseFarFieldOctree;
+        return params;
+    }
+
+    /* Sorts the boids of each flock along a Z-order curve, like the flocking component does with its permutation of the boids.
+     * The benchmark owns the state, so the boids are directly moved */
+    void SortBoidsByMortonCode( FFlockState & state, std::vector< FVec3 > & centers, std::vector< int32_t > & order, std::vector< uint64_t > & keys )
+    {
+        for ( auto & flock : state.Flocks )
+        {
+            centers.resize( flock.BoidsCount );
+            order.resize( flock.BoidsCount );
+
+            for ( auto index = 0; index < flock.BoidsCount; ++index )
+            {
+                centers[ index ] = state.Boids[ flock.FirstBoidIndex + index ].Center;
+            }
+
+            SortByMortonCode( order.data(), centers.data(), flock.BoidsCount, keys );
+
+            const std::vector< FBoid > boids( state.Boids.begin() + flock.FirstBoidIndex, state.Boids.begin() + flock.FirstBoidIndex + flock.BoidsCount );
+            const std::vector< float > multipliers( state.PursuitOffsetMultipliers.begin() + flock.FirstBoidIndex, state.PursuitOffsetMultipliers.begin() + flock.FirstBoidIndex + flock.BoidsCount );
+
+            for ( auto index = 0; index < flock.BoidsCount; ++index )
+            {
+                state.Boids[ flock.FirstBoidIndex + index ] = boids[ order[ index ] ];
+                state.PursuitOffsetMultipliers[ flock.FirstBoidIndex + index ] = multipliers[ order[ index ] ];
+            }
+
+            ++flock.BoidsOrderVersion;
+        }
+    }
+
+    void ComputeSteering( FFlockSimulation & simulation, FFlockState & state, FWorkerPool & worker_pool, std::vector< FSteeringScratch > & scratches )
+    {
+        const auto update_count = static_cast< int32_t >( state.BoidsToUpdate.size() );
+
+        if ( worker_pool.GetThreadsCount() > 1 )
+        {
+            const auto batch_size = ( update_count + worker_pool.GetThreadsCount() - 1 ) / worker_pool.GetThreadsCount();
+
+            worker_pool.Run( [ & ]( const int32_t thread_index ) {
+                const auto first = std::min( thread_index * batch_size, update_count );
+                const auto last = std::min( first + batch_size, update_count );
+                simulation.ComputeSteeringVelocities( state, first, last, scratches[ thread_index ] );
+            } );
+        }
+        else
+        {
+            simulation.ComputeSteeringVelocities( state, 0, update_count, scratches[ 0 ] );
+        }
+    }
+
+    FBenchmarkResult RunBenchmark( const int32_t boids_count, const FBenchmarkOptions & options, FWorkerPool & worker_pool, const FCacheMissesCounters & cache_misses_counters, FFlockRecorder & recorder )
+    {
+        const auto synthetic_flocks_params = GetSyntheticFlocksParams( options );
+        auto state = MakeSyntheticFlocks( boids_count, synthetic_flocks_params );
+        FFlockSimulation simulation;
+        FUpdateScheduler scheduler;
+        std::vector< FSteeringScratch > scratches( worker_pool.GetThreadsCount() );
+        const std::vector< FVec3 > viewer_locations { FVec3( 0.0f ) };
+        const auto use_scheduler = options.bUseLOD || options.BudgetMicroseconds > 0.0f;
+
+        std::chrono::nanoseconds steering_duration( 0 );
+        FSteeringCounters counters;
+        int64_t updated_boids_count = 0;
+        int32_t neighbor_lists_rebuilds_count = 0;
+        double neighbor_lists_lengths_sum = 0.0;
+        uint64_t l1d_misses_count = 0;
+        uint64_t llc_misses_count = 0;
+        std::vector< FVec3 > morton_centers;
+        std::vector< int32_t > morton_order;
+        std::vector< uint64_t > morton_keys;
+        FFixedTimestep fixed_timestep;
+        std::vector< FBoid > tick_boids;
+        int32_t steps_ticks_count = 0;
+        std::chrono::nanoseconds recording_duration( 0 );
+        auto steering_checksum = 0.0;
+        FReplicationMeasure replication_measure;
+
+        recorder.SetMaxFramesCount( options.RecordPath.empty() ? 0 : options.TicksCount );
+
+        for ( auto tick_index = 0; tick_index < options.TicksCount; ++tick_index )
+        {
+            UpdateSyntheticOwners( state, static_cast< float >( tick_index ) * options.DeltaTime, synthetic_flocks_params );
+
+            const auto step_duration = options.FixedRate > 0.0f ? 1.0f / options.FixedRate : options.DeltaTime;
+            const auto steps_count = options.FixedRate > 0.0f ? fixed_timestep.Advance( options.DeltaTime, step_duration, options.MaxStepsCount ) : 1;
+
+            if ( steps_count > 0 )
+            {
+                const auto start_l1d_misses_count = cache_misses_counters.L1D.Read();
+                const auto start_llc_misses_count = cache_misses_counters.LLC.Read();
+                const auto start_time = std::chrono::steady_clock::now();
+
+                if ( options.MortonSortInterval > 0 && tick_index % options.MortonSortInterval == 0 )
+                {
+                    SortBoidsByMortonCode( state, morton_centers, morton_order, morton_keys );
+                }
+
+                if ( use_scheduler )
+                {
+                    scheduler.Schedule( state, viewer_locations, options.BudgetMicroseconds );
+                }
+
+                const auto update_count = static_cast< int32_t >( state.BoidsToUpdate.size() );
+
+                if ( !options.RecordPath.empty() )
+                {
+                    const auto record_start_time = std::chrono::steady_clock::now();
+                    recorder.Record( state, options.SteeringOptions );
+                    recording_duration += std::chrono::steady_clock::now() - record_start_time;
+                }
+
+                // Like the components, the boids only move once per tick, so the later steps start from a copy moved by the previous ones
+                if ( steps_count > 1 )
+                {
+                    tick_boids = state.Boids;
+                }
+
+                std::chrono::nanoseconds compute_duration( 0 );
+
+                for ( auto step_index = 0; step_index < steps_count; ++step_index )
+                {
+                    if ( step_index > 0 )
+                    {
+                        AdvanceFixedStep( state, step_duration );
+                    }
+
+                    if ( options.FixedRate > 0.0f )
+                    {
+                        for ( auto & boid : state.Boids )
+                        {
+                            boid.PreviousSteeringVelocity = boid.SteeringVelocity;
+                        }
+                    }
+
+                    simulation.BuildNeighborSearch( state, options.SteeringOptions );
+
+                    if ( simulation.HasRebuiltNeighborLists() )
+                    {
+                        ++neighbor_lists_rebuilds_count;
+                        neighbor_lists_lengths_sum += simulation.GetNeighborLists().GetAverageLength();
+                    }
+
+                    const auto compute_start_time = std::chrono::steady_clock::now();
+
+                    ComputeSteering( simulation, state, worker_pool, scratches );
+                    compute_duration += std::chrono::steady_clock::now() - compute_start_time;
+                }
+
+                const auto end_time = std::chrono::steady_clock::now();
+
+                if ( steps_count > 1 )
+                {
+                    for ( auto boid_index = 0; boid_index < boids_count; ++boid_index )
+                    {
+                        state.Boids[ boid_index ].Center = tick_boids[ boid_index ].Center;
+                        state.Boids[ boid_index ].Velocity = tick_boids[ boid_index ].Velocity;
+                    }
+                }
+                steering_duration += end_time - start_time;
+                l1d_misses_count += cache_misses_counters.L1D.Read() - start_l1d_misses_count;
+                llc_misses_count += cache_misses_counters.LLC.Read() - start_llc_misses_count;
+                updated_boids_count += update_count;
+
+                if ( use_scheduler )
+                {
+                    scheduler.ReportUpdateDuration( update_count,
+                        std::chrono::duration< double, std::micro >( end_time - start_time - compute_duration ).count(),
+                        std::chrono::duration< double, std::micro >( compute_duration ).count() );
+                }
+
+                if ( !options.RecordPath.empty() )
+                {
+                    steering_checksum += GetSteeringChecksum( state );
+                }
+
+                ++steps_ticks_count;
+            }
+
+            // Like the movement components, which directly use the requested velocity
+            if ( options.FixedRate > 0.0f )
+            {
+                const auto ratio = fixed_timestep.GetInterpolationRatio( 1.0f / options.FixedRate );
+
+                for ( auto & boid : state.Boids )
+                {
+                    boid.Velocity = GetInterpolatedSteeringVelocity( boid, ratio );
+                    boid.Center += boid.Velocity * options.DeltaTime;
+                }
+            }
+            else
+            {
+                IntegrateBoids( state.Boids.data(), boids_count, options.DeltaTime, 0.0f );
+            }
+
+            if ( options.ReplicationInterval > 0 && tick_index % options.ReplicationInterval == 0 )
+            {
+                replication_measure.Send( state, options );
+            }
+        }
+
+        for ( const auto & scratch : scratches )
+        {
+            counters.Add( scratch.Counters );
+        }
+
+        const auto boid_ticks = static_cast< double >( boids_count ) * static_cast< double >( options.TicksCount );
+
+        FBenchmarkResult result;
+        result.BoidsCount = boids_count;
+        result.SteeringNanosecondsPerBoidPerTick = static_cast< double >( ( steering_duration - recording_duration ).count() ) / boid_ticks;
+        result.NeighborCandidatesPerBoid = static_cast< double >( counters.NeighborCandidatesCount ) / boid_ticks;
+        result.PairTestsPerBoid = static_cast< double >( counters.PairTestsCount ) / boid_ticks;
+        result.UpdatedBoidsRatio = static_cast< double >( updated_boids_count ) / boid_ticks;
+        result.NeighborListsRebuildsRatio = static_cast< double >( neighbor_lists_rebuilds_count ) / static_cast< double >( options.TicksCount );
+        result.SteppedTicksRatio = static_cast< double >( steps_ticks_count ) / static_cast< double >( options.TicksCount );
+        result.NeighborListsAverageLength = neighbor_lists_rebuilds_count > 0 ? neighbor_lists_lengths_sum / static_cast< double >( neighbor_lists_rebuilds_count ) : 0.0;
+        result.SimulationBytes = simulation.GetAllocatedSize()
+                                 + state.Boids.capacity() * sizeof( FBoid )
+                                 + state.BoidFlockIndices.capacity() * sizeof( int32_t )
+                                 + state.PursuitOffsetMultipliers.capacity() * sizeof( float )
+                                 + state.BoidsToUpdate.capacity() * sizeof( int32_t );
+        result.L1DMissesPerBoid = cache_misses_counters.L1D.IsAvailable() ? static_cast< double >( l1d_misses_count ) / boid_ticks : -1.0;
+        result.LLCMissesPerBoid = cache_misses_counters.LLC.IsAvailable() ? static_cast< double >( llc_misses_count ) / boid_ticks : -1.0;
+        result.Checksum = GetCentersChecksum( state );
+        result.SteeringChecksum = steering_checksum;
+        replication_measure.GetResult( result );
+        return result;
+    }
+
+    bool ReadFile( const std::string & path, std::vector< uint8_t > & bytes )
+    {
+        auto * file = std::fopen( path.c_str(), "rb" );
+
+        if ( file == nullptr )
+        {
+            return false;
+        }
+
+        std::fseek( file, 0, SEEK_END );
+        const auto size = std::ftell( file );
+        std::fseek( file, 0, SEEK_SET );
+
+        bytes.resize( size > 0 ? static_cast< size_t >( size ) : 0 );
+        const auto success = size >= 0 && std::fread( bytes.data(), 1, bytes.size(), file ) == bytes.size();
+        std::fclose( file );
+        return success;
+    }
+
+    bool WriteFile( const std::string & path, const std::vector< uint8_t > & bytes )
+    {
+        auto * file = std::fopen( path.c_str(), "wb" );
+
+        if ( file == nullptr )
+        {
+            return false;
+        }
+
+        const auto success = std::fwrite( bytes.data(), 1, bytes.size(), file ) == bytes.size();
+        return std::fclose( file ) == 0 && success;
+    }
+
+    /* Feeds the recorded frames to the simulation, with the steering options they were recorded with.
+     * The steering checksum must not change when optimizing the simulation, unless the optimization is expected to change the result */
+    int ReplayRecording( const FBenchmarkOptions & options, FWorkerPool & worker_pool )
+    {
+        std::vector< uint8_t > bytes;
+        std::vector< FRecordedFrame > frames;
+
+        if ( !ReadFile( options.ReplayPath, bytes ) || !ReadFlockRecording( bytes.data(), bytes.size(), frames ) )
+        {
+            std::fprintf( stderr, "could not read the recording %s\n", options.ReplayPath.c_str() );
+            return 1;
+        }
+
+        FFlockSimulation simulation;
+        std::vector< FSteeringScratch > scratches( worker_pool.GetThreadsCount() );
+        std::chrono::nanoseconds steering_duration( 0 );
+        std::chrono::nanoseconds max_frame_duration( 0 );
+        int64_t boids_count = 0;
+        int64_t updated_boids_count = 0;
+        auto steering_checksum = 0.0;
+
+        for ( auto & frame : frames )
+        {
+            const auto start_time = std::chrono::steady_clock::now();
+
+            simulation.BuildNeighborSearch( frame.State, frame.Options );
+            ComputeSteering( simulation, frame.State, worker_pool, scratches );
+
+            const auto frame_duration = std::chrono::steady_clock::now() - start_time;
+            steering_duration += frame_duration;
+            max_frame_duration = std::max( max_frame_duration, std::chrono::duration_cast< std::chrono::nanoseconds >( frame_duration ) );
+            boids_count += static_cast< int64_t >( frame.State.Boids.size() );
+            updated_boids_count += static_cast< int64_t >( frame.State.BoidsToUpdate.size() );
+            steering_checksum += GetSteeringChecksum( frame.State );
+        }
+
+        const auto frames_count = std::max< size_t >( frames.size(), 1 );
+
+        std::printf( "replayed %zu frames of %.1f boids on average, %.1f updated\n", frames.size(), static_cast< double >( boids_count ) / frames_count, static_cast< double >( updated_boids_count ) / frames_count );
+        std::printf( "%.1f ns per updated boid, %.1f us per frame on average, %.1f us for the slowest frame\n",
+            static_cast< double >( steering_duration.count() ) / static_cast< double >( std::max< int64_t >( updated_boids_count, 1 ) ),
+            static_cast< double >( steering_duration.count() ) / 1000.0 / frames_count,
+            static_cast< double >( max_frame_duration.count() ) / 1000.0 );
+        std::printf( "steering checksum: %.3f\n", steering_checksum );
+        return 0;
+    }
+
+    std::string FormatMissesPerBoid( const double misses_per_boid )
+    {
+        if ( misses_per_boid < 0.0 )
+        {
+            return "n/a";
+        }
+
+        char text[ 32 ];
+        std::snprintf( text, sizeof( text ), "%.2f", misses_per_boid );
+        return text;
+    }
+
+    long GetPeakResidentSetKilobytes()
+    {
+#if defined( __linux__ )
+        rusage usage;
+        if ( getrusage( RUSAGE_SELF, &usage ) == 0 )
+        {
+            return usage.ru_maxrss;
+        }
+#endif
+        return -1;
+    }
+
+    std::vector< int32_t > ParseSizes( const char * argument )
+    {
+        std::vector< int32_t > sizes;
+        std::stringstream stream( argument );
+        std::string size;
+
+        while ( std::getline( stream, size, ',' ) )
+        {
+            sizes.push_back( std::atoi( size.c_str() ) );
+        }
+
+        return sizes;
+    }
+
+    bool ParseForces( const char * argument, FBenchmarkOptions & options )
+    {
+        options.bUseAlignment = false;
+        options.bUseCohesion = false;
+        options.bUseSeparation = false;
+
+        std::stringstream stream( argument );
+        std::string force;
+
+        while ( std::getline( stream, force, ',' ) )
+        {
+            if ( force == "alignment" )
+            {
+                options.bUseAlignment = true;
+            }
+            else if ( force == "cohesion" )
+            {
+                options.bUseCohesion = true;
+            }
+            else if ( force == "separation" )
+            {
+                options.bUseSeparation = true;
+            }
+            else if ( force != "none" )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void PrintUsage()
+    {
+        std::printf( "Usage: FlockingBenchmark [options]\n"
+                     "  --sizes 100,1000,10000,100000  Flock sizes to run\n"
+                     "  --ticks 100                    Number of ticks per flock\n"
+                     "  --flocks 1                     Number of flocks each size is split in\n"
+                     "  --cross-flock-separation 0|1   Let the boids of the other flocks contribute to the separation force\n"
+                     "  --lod 0|1                      Update the boids far from the origin less often\n"
+                     "  --budget-us 0                  Budget of the steering update per tick, in microseconds. 0 is unlimited\n"
+                     "  --threads 1                    Number of threads computing the steering velocities\n"
+                     "  --kernel simd|scalar           Kernel used to compute the neighbor forces\n"
+                     "  --neighbors 0                  Maximum number of nearest neighbors of each force. 0 is unlimited\n"
+                     "  --skin 0                       Skin distance of the Verlet neighbor lists. 0 disables them\n"
+                     "  --alignment-radius 300         Alignment radius of the flocks\n"
+                     "  --cohesion-radius 500          Cohesion radius of the flocks\n"
+                     "  --forces alignment,cohesion,separation  Neighbor forces of the flocks, or none. The others get a weight of 0\n"
+                     "  --debug-forces 0|1             Store the weighted forces of every boid, like the debug drawing\n"
+                     "  --far-field 0|1                Compute alignment and cohesion with an octree, and compare the result with the spatial hash\n"
+                     "  --morton-sort 0                Number of ticks between two sorts of the boids along a Z-order curve. 0 disables it\n"
+                     "  --fixed-rate 0                 Steps per second of the steering update, with interpolated velocities. 0 updates it every tick\n"
+                     "  --replication 0                Ticks between two replicated states, quantized and delta encoded. 0 disables the measure\n"
+                     "  --replication-precision 2,1    Quantization step of the replicated locations and velocities\n"
+                     "  --record file                  Record every tick of the last size in this file\n"
+                     "  --replay file                  Replay the frames of this recording instead of running the synthetic flocks\n"
+                     "  --spacing 150                  Average distance between two boids\n"
+                     "  --seed 12345                   Seed of the synthetic flocks\n" );
+    }
+
+    bool ParseOptions( const int argc, char ** argv, FBenchmarkOptions & options )
+    {
+        for ( auto argument_index = 1; argument_index < argc; ++argument_index )
+        {
+            const auto * argument = argv[ argument_index ];
+            const auto * value = argument_index + 1 < argc ? argv[ argument_index + 1 ] : nullptr;
+
+            if ( std::strcmp( argument, "--help" ) == 0 || value == nullptr )
+            {
+                return false;
+            }
+
+            if ( std::strcmp( argument, "--sizes" ) == 0 )
+            {
+                options.FlockSizes = ParseSizes( value );
+            }
+            else if ( std::strcmp( argument, "--ticks" ) == 0 )
+            {
+                options.TicksCount = std::max( 1, std::atoi( value ) );
+            }
+            else if ( std::strcmp( argument, "--flocks" ) == 0 )
+            {
+                options.FlocksCount = std::max( 1, std::atoi( value ) );
+            }
+            else if ( std::strcmp( argument, "--cross-flock-separation" ) == 0 )
+            {
+                options.SteeringOptions.bSeparateFromOtherFlocks = std::atoi( value ) != 0;
+            }
+            else if ( std::strcmp( argument, "--lod" ) == 0 )
+            {
+                options.bUseLOD = std::atoi( value ) != 0;
+            }
+            else if ( std::strcmp( argument, "--budget-us" ) == 0 )
+            {
+                options.BudgetMicroseconds = static_cast< float >( std::atof( value ) );
+            }
+            else if ( std::strcmp( argument, "--threads" ) == 0 )
+            {
+                options.ThreadsCount = std::max( 1, std::atoi( value ) );
+            }
+            else if ( std::strcmp( argument, "--kernel" ) == 0 )
+            {
+                options.SteeringOptions.bUseVectorizedKernel = std::strcmp( value, "scalar" ) != 0;
+            }
+            else if ( std::strcmp( argument, "--neighbors" ) == 0 )
+            {
+                options.MaxNeighborsCount = std::max( 0, std::atoi( value ) );
+            }
+            else if ( std::strcmp( argument, "--skin" ) == 0 )
+            {
+                options.SteeringOptions.NeighborListSkinDistance = static_cast< float >( std::atof( value ) );
+            }
+            else if ( std::strcmp( argument, "--alignment-radius" ) == 0 )
+            {
+                options.AlignmentRadius = static_cast< float >( std::atof( value ) );
+            }
+            else if ( std::strcmp( argument, "--cohesion-radius" ) == 0 )
+            {
+                options.CohesionRadius = static_cast< float >( std::atof( value ) );
+            }
+            else if ( std::strcmp( argument, "--forces" ) == 0 )
+            {
+                if ( !ParseForces( value, options ) )
+                {
+                    return false;
+                }
+            }
+            else if ( std::strcmp( argument, "--debug-forces" ) == 0 )
+            {
+                options.SteeringOptions.bStoreDebugForces = std::atoi( value ) != 0;
+            }
+            else if ( std::strcmp( argument, "--far-field" ) == 0 )
+            {
+                options.bUseFarFieldOctree = std::atoi( value ) != 0;
+            }
+            else if ( std::strcmp( argument, "--morton-sort" ) == 0 )
+            {
+                options.MortonSortInterval = std::max( 0, std::atoi( value ) );
+            }
+            else if ( std::strcmp( argument, "--fixed-rate" ) == 0 )
+            {
+                options.FixedRate = std::max( 0.0f, static_cast< float >( std::atof( value ) ) );
+            }
+            else if ( std::strcmp( argument, "--spacing" ) == 0 )
+            {
+                options.BoidSpacing = static_cast< float >( std::atof( value ) );
+            }
+            else if ( std::strcmp( argument, "--replication" ) == 0 )
+            {
+                options.ReplicationInterval = std::max( 0, std::atoi( value ) );
+            }
+            else if ( std::strcmp( argument, "--replication-precision" ) == 0 )
+            {
+                if ( std::sscanf( value, "%f,%f", &options.ReplicationPositionPrecision, &options.ReplicationVelocityPrecision ) != 2
+                     || options.ReplicationPositionPrecision <= 0.0f
+                     || options.ReplicationVelocityPrecision <= 0.0f )
+                {
+                    return false;
+                }
+            }
+            else if ( std::strcmp( argument, "--record" ) == 0 )
+            {
+                options.RecordPath = value;
+            }
+            else if ( std::strcmp( argument, "--replay" ) == 0 )
+            {
+                options.ReplayPath = value;
+            }
+            else if ( std::strcmp( argument, "--seed" ) == 0 )
+            {
+                options.Seed = static_cast< uint32_t >( std::strtoul( value, nullptr, 10 ) );
+            }
+            else
+            {
+                return false;
+            }
+
+            ++argument_index;
+        }
+
+        return true;
+    }
+}
+
+int main( int argc, char ** argv )
+{
+    FBenchmarkOptions options;
+
+    if ( !ParseOptions( argc, argv, options ) )
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    // Before the worker threads, so the counters include them
+    const FCacheMissesCounters cache_misses_counters;
+    FWorkerPool worker_pool( options.ThreadsCount );
+
+    if ( !options.ReplayPath.empty() )
+    {
+        return ReplayRecording( options, worker_pool );
+    }
+
+    FFlockRecorder recorder;
+
+    std::printf( "kernel=%s neighbors=%d skin=%.1f forces=%s%s%s%s debug-forces=%d alignment-radius=%.1f cohesion-radius=%.1f far-field=%d morton-sort=%d fixed-rate=%.1f threads=%d flocks=%d cross-flock-separation=%d lod=%d budget=%.0fus ticks=%d spacing=%.1f seed=%u\n",
+        options.SteeringOptions.bUseVectorizedKernel ? "simd" : "scalar",
+        options.MaxNeighborsCount,
+        options.SteeringOptions.NeighborListSkinDistance,
+        options.bUseAlignment ? "a" : "",
+        options.bUseCohesion ? "c" : "",
+        options.bUseSeparation ? "s" : "",
+        options.bUseAlignment || options.bUseCohesion || options.bUseSeparation ? "" : "none",
+        options.SteeringOptions.bStoreDebugForces ? 1 : 0,
+        options.AlignmentRadius,
+        options.CohesionRadius,
+        options.bUseFarFieldOctree ? 1 : 0,
+        options.MortonSortInterval,
+        options.FixedRate,
+        worker_pool.GetThreadsCount(),
+        options.FlocksCount,
+        options.SteeringOptions.bSeparateFromOtherFlocks ? 1 : 0,
+        options.bUseLOD ? 1 : 0,
+        options.BudgetMicroseconds,
+        options.TicksCount,
+        options.BoidSpacing,
+        options.Seed );
+    std::printf( "%10s %16s %10s %14s %14s %14s %12s %12s %20s\n", "boids", "ns/boid/tick", "updated %", "candidates", "pair tests", "sim KiB", "L1D miss", "LLC miss", "checksum" );
+
+    for ( const auto boids_count : options.FlockSizes )
+    {
+        const auto result = RunBenchmark( boids_count, options, worker_pool, cache_misses_counters, recorder );
+
+        std::printf( "%10d %16.1f %10.1f %14.1f %14.1f %14.1f %12s %12s %20.3f\n",
+            result.BoidsCount,
+            result.SteeringNanosecondsPerBoidPerTick,
+            result.UpdatedBoidsRatio * 100.0,
+            result.NeighborCandidatesPerBoid,
+            result.PairTestsPerBoid,
+            static_cast< double >( result.SimulationBytes ) / 1024.0,
+            FormatMissesPerBoid( result.L1DMissesPerBoid ).c_str(),
+            FormatMissesPerBoid( result.LLCMissesPerBoid ).c_str(),
+            result.Checksum );
+
+        if ( options.SteeringOptions.NeighborListSkinDistance > 0.0f )
+        {
+            std::printf( "%10s neighbor lists rebuilt on %.1f%% of the ticks, %.1f neighbors per list\n", "", result.NeighborListsRebuildsRatio * 100.0, result.NeighborListsAverageLength );
+        }
+
+        if ( options.FixedRate > 0.0f )
+        {
+            std::printf( "%10s steering updated on %.1f%% of the ticks\n", "", result.SteppedTicksRatio * 100.0 );
+        }
+
+        if ( options.bUseFarFieldOctree )
+        {
+            const auto error = MeasureFarFieldError( boids_count, GetSyntheticFlocksParams( options ), options.SteeringOptions );
+            std::printf( "%10s steering error against the exact result : mean %.3f%%, max %.3f%% of the max velocity\n", "", error.MeanError * 100.0, error.MaxError * 100.0 );
+        }
+
+        if ( options.ReplicationInterval > 0 )
+        {
+            const auto updates_per_second = 1.0 / ( options.DeltaTime * options.ReplicationInterval );
+            std::printf( "%10s replication: %.2f bytes per boid for the first state, then %.2f bytes per boid per update, %.1f KiB/s at %.1f updates per second. Max location error %.2f%s\n",
+                "",
+                result.ReplicationFullBytesPerBoid,
+                result.ReplicationDeltaBytesPerBoid,
+                result.ReplicationDeltaBytesPerBoid * boids_count * updates_per_second / 1024.0,
+                updates_per_second,
+                result.ReplicationMaxLocationError,
+                result.bReplicationDecodeMatches ? "" : ". DECODING MISMATCH" );
+        }
+
+        if ( !options.RecordPath.empty() && boids_count == options.FlockSizes.back() )
+        {
+            std::vector< uint8_t > bytes;
+            recorder.WriteTo( bytes );
+
+            if ( !WriteFile( options.RecordPath, bytes ) )
+            {
+                std::fprintf( stderr, "could not write the recording %s\n", options.RecordPath.c_str() );
+                return 1;
+            }
+
+            std::printf( "%10s recorded %d frames, %.1f KiB, in %s. Steering checksum: %.3f\n", "", recorder.GetFramesCount(), static_cast< double >( bytes.size() ) / 1024.0, options.RecordPath.c_str(), result.SteeringChecksum );
+        }
+    }
+
+    std::printf( "peak RSS: %ld KiB\n", GetPeakResidentSetKilobytes() );
+
+    return 0;
+}
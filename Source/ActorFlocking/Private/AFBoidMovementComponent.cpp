@@ -0,0 +1,90 @@
+#include "AFBoidMovementComponent.h"
+
+#include "AFFlockingCoreConversions.h"
+#include "FlockingCore/AFCoreIntegration.h"
+
+#include <Components/SceneComponent.h>
+
+UAFBoidMovementComponent::UAFBoidMovementComponent()
+{
+    MaxSpeed = 600.0f;
+    MaxAcceleration = 0.0f;
+    CollisionSweepInterval = 0.0f;
+    bRotationFollowsVelocity = true;
+    bAllowFlockMoves = true;
+    bUpdateOnlyIfRendered = false;
+    SteeringVelocity = FVector::ZeroVector;
+    TimeSinceSweep = 0.0f;
+    bIsMovedByFlock = false;
+}
+
+float UAFBoidMovementComponent::GetMaxSpeed() const
+{
+    return MaxSpeed;
+}
+
+void UAFBoidMovementComponent::TickComponent( const float delta_time, const ELevelTick tick_type, FActorComponentTickFunction * this_tick_function )
+{
+    Super::TickComponent( delta_time, tick_type, this_tick_function );
+
+    // SetUpdatedComponent enables the tick again, but the flock already moves the boid
+    if ( !bIsMovedByFlock )
+    {
+        MoveBoid( delta_time );
+    }
+}
+
+void UAFBoidMovementComponent::SetSteeringVelocity( const FVector & steering_velocity )
+{
+    SteeringVelocity = steering_velocity;
+}
+
+bool UAFBoidMovementComponent::SetMovedByFlock( const bool moved_by_flock )
+{
+    bIsMovedByFlock = moved_by_flock && bAllowFlockMoves;
+    SetComponentTickEnabled( !bIsMovedByFlock );
+    return bIsMovedByFlock;
+}
+
+bool UAFBoidMovementComponent::MoveBoid( const float delta_time )
+{
+    if ( ShouldSkipUpdate( delta_time ) )
+    {
+        return false;
+    }
+
+    Velocity = ToVector( AFFlockingCore::GetAcceleratedVelocity( ToCoreVector( Velocity ), ToCoreVector( SteeringVelocity ), delta_time, MaxAcceleration ) ).GetClampedToMaxSize( MaxSpeed );
+
+    const auto delta = Velocity * delta_time;
+
+    // A boid which stopped keeps its last orientation
+    if ( delta.IsNearlyZero() )
+    {
+        UpdateComponentVelocity();
+        return false;
+    }
+
+    const auto rotation = bRotationFollowsVelocity ? Velocity.ToOrientationQuat() : UpdatedComponent->GetComponentQuat();
+
+    TimeSinceSweep += delta_time;
+
+    if ( CollisionSweepInterval <= 0.0f || TimeSinceSweep < CollisionSweepInterval )
+    {
+        MoveUpdatedComponent( delta, rotation, false );
+        UpdateComponentVelocity();
+        return false;
+    }
+
+    TimeSinceSweep = 0.0f;
+
+    FHitResult hit;
+    SafeMoveUpdatedComponent( delta, rotation, true, hit );
+
+    if ( hit.IsValidBlockingHit() )
+    {
+        SlideAlongSurface( delta, 1.0f - hit.Time, hit.Normal, hit, true );
+    }
+
+    UpdateComponentVelocity();
+    return true;
+}
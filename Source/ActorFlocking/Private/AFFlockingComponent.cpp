@@ -1,65 +1,67 @@
 #include "AFFlockingComponent.h"
 
+#include "AFBoidMovementComponent.h"
+#include "AFFlockingCoreConversions.h"
+#include "AFFlockingStats.h"
+#include "AFFlockingSubsystem.h"
+#include "FlockingCore/AFCoreIntegration.h"
+#include "FlockingCore/AFCoreMortonOrder.h"
+
+#include <Async/ParallelFor.h>
+#include <Components/InstancedStaticMeshComponent.h>
 #include <Curves/CurveFloat.h>
-#include <DrawDebugHelpers.h>
 #include <Engine/World.h>
 #include <GameFramework/Character.h>
 #include <GameFramework/CharacterMovementComponent.h>
+#include <GameFramework/NavMovementComponent.h>
+#include <GameFramework/PlayerController.h>
+#include <Misc/DateTime.h>
+#include <Misc/FileHelper.h>
+#include <Misc/Paths.h>
+#include <Net/UnrealNetwork.h>
 #include <TimerManager.h>
 
-DECLARE_STATS_GROUP( TEXT( "Flocking" ), STATGROUP_Flocking, STATCAT_Advanced );
-DECLARE_CYCLE_STAT( TEXT( "Flocking Tick" ), STAT_FlockingComponentTick, STATGROUP_Flocking );
-DECLARE_CYCLE_STAT( TEXT( "Flocking RequestDirectMove" ), STAT_FlockingComponentRequestDirectMove, STATGROUP_Flocking );
-DECLARE_CYCLE_STAT( TEXT( "Flocking Update Steering Velocity" ), STAT_FlockingComponentUpdateSteeringVelocity, STATGROUP_Flocking );
-
-namespace
-{
-    FVector Seek( const FAFBoidsData & flock_data, const FVector & target, const float slowdown_distance = 100.0f )
-    {
-        const auto to_target = target - flock_data.Center;
-        const auto to_target_direction = to_target.GetSafeNormal();
-
-        auto desired_velocity = to_target_direction * flock_data.MaxVelocity;
-
-        if ( slowdown_distance > 0.0f )
-        {
-            const auto distance_to_target = to_target.Size();
-            const auto slowdown_falloff = FMath::Clamp( distance_to_target / slowdown_distance, 0.0f, 1.0f );
-
-            desired_velocity *= slowdown_falloff;
-        }
-
-        return desired_velocity;
-    }
-
-    FVector Flee( const FAFBoidsData & flock_data, const FVector & from )
-    {
-        const auto desired_velocity = ( flock_data.Center - from ).GetSafeNormal() * flock_data.MaxVelocity;
-        return desired_velocity;
-    }
-
-    FVector Pursuit( const FAFBoidsData & flock_data, const FVector & target, const FVector & target_velocity, const float slowdown_distance = 100.0f )
-    {
-        const auto distance = ( target - flock_data.Center ).Size();
-        const auto time = distance / flock_data.MaxVelocity;
-        const auto future_position = target + target_velocity * time;
-        return Seek( flock_data, future_position, slowdown_distance );
-    }
-
-    FVector Evade( const FAFBoidsData & flock_data, const FVector & target, const FVector & target_velocity )
-    {
-        const auto distance = ( target - flock_data.Center ).Size();
-        const auto time = distance / flock_data.MaxVelocity;
-        const auto future_position = target + target_velocity * time;
-        return Flee( flock_data, future_position );
-    }
-
-    FVector FollowLeader( const FAFBoidsData & flock_data, const FAFBoidsData & leader_flock_data, const float distance = 100.0f )
-    {
-        const auto target = leader_flock_data.Velocity.GetSafeNormal() * -1.0f * distance;
-        return Seek( flock_data, target );
-    }
-}
+CSV_DEFINE_CATEGORY( Flocking, true );
+CSV_DEFINE_CATEGORY( FlockingCounters, true );
+
+UE_TRACE_CHANNEL_DEFINE( FlockingChannel );
+
+DEFINE_STAT( STAT_FlockingComponentTick );
+DEFINE_STAT( STAT_FlockingSubsystemTick );
+DEFINE_STAT( STAT_FlockingComponentRequestDirectMove );
+DEFINE_STAT( STAT_FlockingComponentUpdateSteeringVelocity );
+DEFINE_STAT( STAT_FlockingGather );
+DEFINE_STAT( STAT_FlockingSchedule );
+DEFINE_STAT( STAT_FlockingComponentBuildSpatialHash );
+DEFINE_STAT( STAT_FlockingComputeSteering );
+DEFINE_STAT( STAT_FlockingComponentAsyncSteeringTask );
+DEFINE_STAT( STAT_FlockingComponentAsyncSteeringWait );
+DEFINE_STAT( STAT_FlockingComponentDrawDebug );
+DEFINE_STAT( STAT_FlockingUpdateLightweightBoids );
+DEFINE_STAT( STAT_FlockingSortBoids );
+DEFINE_STAT( STAT_FlockingReassignQueue );
+DEFINE_STAT( STAT_FlockingRecordFrame );
+DEFINE_STAT( STAT_FlockingReplication );
+DEFINE_STAT( STAT_FlockingObstacleAvoidance );
+DEFINE_STAT( STAT_FlockingMoveBoids );
+DEFINE_STAT( STAT_FlockingBatchedFlocks );
+DEFINE_STAT( STAT_FlockingBoids );
+DEFINE_STAT( STAT_FlockingLightweightBoids );
+DEFINE_STAT( STAT_FlockingNeighborCandidates );
+DEFINE_STAT( STAT_FlockingPairTests );
+DEFINE_STAT( STAT_FlockingNeighbors );
+DEFINE_STAT( STAT_FlockingNeighborListsRebuilds );
+DEFINE_STAT( STAT_FlockingNeighborListsAverageLength );
+DEFINE_STAT( STAT_FlockingLOD0Boids );
+DEFINE_STAT( STAT_FlockingLOD1Boids );
+DEFINE_STAT( STAT_FlockingLOD2Boids );
+DEFINE_STAT( STAT_FlockingUpdatedBoids );
+DEFINE_STAT( STAT_FlockingDeferredBoids );
+DEFINE_STAT( STAT_FlockingReplicatedBytes );
+DEFINE_STAT( STAT_FlockingSwaps );
+DEFINE_STAT( STAT_FlockingObstacleTraces );
+DEFINE_STAT( STAT_FlockingBoidSweeps );
+DEFINE_STAT( STAT_FlockingSleepingFlocks );
 
 FAFFlockSettings::FAFFlockSettings()
 {
@@ -73,6 +75,13 @@ FAFFlockSettings::FAFFlockSettings()
     CohesionRadius = 500.0f;
     SeparationWeight = 1.0f;
     SeparationRadius = 300.0f;
+    MaxNeighborsCount = 0;
+    bUseFarFieldOctree = false;
+    ObstacleAvoidanceWeight = 0.0f;
+    ObstacleTraceDistance = 500.0f;
+    ObstacleTraceChannel = ECC_WorldStatic;
+    MaxObstacleTracesPerTick = 32;
+    ObstacleMemoryHalfLife = 0.5f;
     QueueCurve = nullptr;
     bAllowSwapPositions = false;
     SwapPositionDelayInterval.Min = 0.0f;
@@ -85,16 +94,85 @@ FAFFlockSettings::FAFFlockSettings()
 
 void FAFFlockSettings::LerpBetween( const FAFFlockSettings & start, const FAFFlockSettings & end, const float ratio )
 {
-    PursuitWeight = FMath::Lerp( start.PursuitWeight, end.PursuitWeight, ratio );
-    PursuitSlowdownRadius = FMath::Lerp( start.PursuitSlowdownRadius, end.PursuitSlowdownRadius, ratio );
-    PursuitDistanceBehind = FMath::Lerp( start.PursuitDistanceBehind, end.PursuitDistanceBehind, ratio );
-    NonForwardVelocityBrakingFactor = FMath::Lerp( start.NonForwardVelocityBrakingFactor, end.NonForwardVelocityBrakingFactor, ratio );
-    AlignmentWeight = FMath::Lerp( start.AlignmentWeight, end.AlignmentWeight, ratio );
-    AlignmentRadius = FMath::Lerp( start.AlignmentRadius, end.AlignmentRadius, ratio );
-    CohesionWeight = FMath::Lerp( start.CohesionWeight, end.CohesionWeight, ratio );
-    CohesionRadius = FMath::Lerp( start.CohesionRadius, end.CohesionRadius, ratio );
-    SeparationWeight = FMath::Lerp( start.SeparationWeight, end.SeparationWeight, ratio );
-    SeparationRadius = FMath::Lerp( start.SeparationRadius, end.SeparationRadius, ratio );
+    AFFlockingCore::FFlockParams params;
+    params.LerpBetween( start.GetParams(), end.GetParams(), ratio );
+    SetParams( params );
+}
+
+AFFlockingCore::FFlockParams FAFFlockSettings::GetParams() const
+{
+    AFFlockingCore::FFlockParams params;
+    params.PursuitWeight = PursuitWeight;
+    params.PursuitSlowdownRadius = PursuitSlowdownRadius;
+    params.PursuitDistanceBehind = PursuitDistanceBehind;
+    params.NonForwardVelocityBrakingFactor = NonForwardVelocityBrakingFactor;
+    params.AlignmentWeight = AlignmentWeight;
+    params.AlignmentRadius = AlignmentRadius;
+    params.CohesionWeight = CohesionWeight;
+    params.CohesionRadius = CohesionRadius;
+    params.SeparationWeight = SeparationWeight;
+    params.SeparationRadius = SeparationRadius;
+    params.MaxNeighborsCount = MaxNeighborsCount;
+    params.bUseFarFieldOctree = bUseFarFieldOctree;
+    params.ObstacleAvoidanceWeight = ObstacleAvoidanceWeight;
+    return params;
+}
+
+void FAFFlockSettings::SetParams( const AFFlockingCore::FFlockParams & params )
+{
+    PursuitWeight = params.PursuitWeight;
+    PursuitSlowdownRadius = params.PursuitSlowdownRadius;
+    PursuitDistanceBehind = params.PursuitDistanceBehind;
+    NonForwardVelocityBrakingFactor = params.NonForwardVelocityBrakingFactor;
+    AlignmentWeight = params.AlignmentWeight;
+    AlignmentRadius = params.AlignmentRadius;
+    CohesionWeight = params.CohesionWeight;
+    CohesionRadius = params.CohesionRadius;
+    SeparationWeight = params.SeparationWeight;
+    SeparationRadius = params.SeparationRadius;
+    MaxNeighborsCount = params.MaxNeighborsCount;
+    bUseFarFieldOctree = params.bUseFarFieldOctree;
+    ObstacleAvoidanceWeight = params.ObstacleAvoidanceWeight;
+}
+
+FAFFlockingLOD::FAFFlockingLOD() :
+    bEnableLOD( false ),
+    LOD1MinDistance( 2500.0f ),
+    LOD1UpdateInterval( 2 ),
+    LOD2MinDistance( 6000.0f ),
+    LOD2UpdateInterval( 4 ),
+    UpdateBudgetMicroseconds( 0.0f )
+{
+}
+
+AFFlockingCore::FLODParams FAFFlockingLOD::GetParams() const
+{
+    AFFlockingCore::FLODParams params;
+    params.bEnabled = bEnableLOD;
+    params.MinDistances[ 1 ] = LOD1MinDistance;
+    params.MinDistances[ 2 ] = FMath::Max( LOD1MinDistance, LOD2MinDistance );
+    params.UpdateIntervals[ 1 ] = FMath::Max( 1, LOD1UpdateInterval );
+    params.UpdateIntervals[ 2 ] = FMath::Max( 1, LOD2UpdateInterval );
+    return params;
+}
+
+FAFFlockingSleep::FAFFlockingSleep() :
+    bEnableSleep( false ),
+    MaxOwnerVelocity( 1.0f ),
+    MaxTargetDistance( 500.0f ),
+    SettleDuration( 1.0f ),
+    SleepTickInterval( 0.0f )
+{
+}
+
+FAFLightweightBoidsSettings::FAFLightweightBoidsSettings() :
+    Count( 0 ),
+    Mesh( nullptr ),
+    MeshScale( FVector::OneVector ),
+    MaxVelocity( 600.0f ),
+    MaxAcceleration( 2000.0f ),
+    SpawnRadius( 1000.0f )
+{
 }
 
 FAFFlockingDebug::FAFFlockingDebug() :
@@ -102,298 +180,1970 @@ FAFFlockingDebug::FAFFlockingDebug() :
     bDrawPursuitForce( false ),
     bDrawAlignmentForce( false ),
     bDrawCohesionForce( false ),
-    bDrawSeparationForce( false )
+    bDrawSeparationForce( false ),
+    bDrawObstacleAvoidanceForce( false ),
+    MaxDrawnBoidsCount( 256 ),
+    DrawnBoidsStride( 1 ),
+    BoidSphereSegmentsCount( 8 )
 {
 }
 
-FAFBoidsData::FAFBoidsData( const UCharacterMovementComponent & movement_component ) :
-    Center( movement_component.GetOwner()->GetActorLocation() ),
-    Velocity( movement_component.GetOwner()->GetVelocity() ),
-    MaxVelocity( movement_component.GetMaxSpeed() ),
-    SteeringVelocity( 0.0f, 0.0f, 0.0f )
+bool FAFFlockingDebug::IsEnabled() const
 {
+    return bDrawBoidSphere || bDrawPursuitForce || bDrawAlignmentForce || bDrawCohesionForce || bDrawSeparationForce || bDrawObstacleAvoidanceForce;
 }
 
-UAFFlockingComponent::UAFFlockingComponent()
+FAFFlockingRecording::FAFFlockingRecording() :
+    RecordedFramesCount( 0 ),
+    SaveOnSpikeMicroseconds( 0.0f )
 {
-    PrimaryComponentTick.bCanEverTick = true;
-    PrimaryComponentTick.bStartWithTickEnabled = true;
-    TransitionDuration = 0.0f;
-    TransitionTimer = 0.0f;
 }
 
-void UAFFlockingComponent::RegisterMovementComponent( UCharacterMovementComponent * movement_component )
+FAFFlockingReplication::FAFFlockingReplication() :
+    bReplicateFlock( false ),
+    PositionPrecision( 2.0f ),
+    VelocityPrecision( 1.0f ),
+    FullStateInterval( 64 )
 {
-    if ( movement_component == nullptr )
-    {
-        return;
-    }
+}
 
-    ensureMsgf( movement_component->IsFlying(), TEXT( "You should register flying actors to the flock" ) );
+FAFFlockingPerformance::FAFFlockingPerformance() :
+    bUseVectorizedSteering( true ),
+    bUseParallelSteering( false ),
+    ParallelSteeringMinBatchSize( 64 ),
+    NeighborListSkinDistance( 0.0f ),
+    BoidsSortInterval( 0 ),
+    FixedTimestepRate( 0.0f ),
+    MaxSubstepsCount( 4 ),
+    bUseAsyncSteering( false ),
+    AsyncSteeringLatency( EAFAsyncSteeringLatency::NextFrame ),
+    bUseFlockingSubsystem( false )
+{
+}
 
-    BoidsMovementComponents.AddUnique( movement_component );
+FAFBoidHandle::FAFBoidHandle() :
+    Id( INDEX_NONE )
+{
 }
 
-void UAFFlockingComponent::UnRegisterMovementComponent( UCharacterMovementComponent * movement_component )
+FAFBoidHandle::FAFBoidHandle( const int32 id ) :
+    Id( id )
 {
-    BoidsMovementComponents.Remove( movement_component );
 }
 
-void UAFFlockingComponent::BeginPlay()
+bool FAFBoidHandle::IsValid() const
 {
-    Super::BeginPlay();
+    return Id != INDEX_NONE;
+}
 
-    SetSettings( FlockSettingsData );
+int32 FAFBoidHandle::GetId() const
+{
+    return Id;
 }
 
-#if WITH_EDITOR
-void UAFFlockingComponent::PostEditChangeProperty( FPropertyChangedEvent & property_changed_event )
+FAFFlockSimulationFrame::FAFFlockSimulationFrame() :
+    bStoreDebugForces( false ),
+    bSeparateFromOtherFlocks( false ),
+    StepsCount( 1 ),
+    StepDuration( 0.0f ),
+    BuildNeighborSearchMicroseconds( 0.0 ),
+    ComputeSteeringMicroseconds( 0.0 )
 {
-    Super::PostEditChangeProperty( property_changed_event );
+}
 
-    static const FName SettingsDataName( TEXT( "FlockSettingsData" ) );
+void FAFFlockSimulationFrame::ScheduleBoidsUpdate( AFFlockingCore::FUpdateScheduler & scheduler, const UWorld * world, const float budget_microseconds )
+{
+    AF_FLOCKING_SCOPE( STAT_FlockingSchedule, Schedule );
 
-    if ( property_changed_event.GetPropertyName() == SettingsDataName )
+    ViewerLocations.clear();
+
+    for ( auto iterator = world->GetPlayerControllerIterator(); iterator; ++iterator )
     {
-        SetSettings( FlockSettingsData );
+        if ( const auto * player_controller = iterator->Get() )
+        {
+            FVector location;
+            FRotator rotation;
+            player_controller->GetPlayerViewPoint( location, rotation );
+            ViewerLocations.push_back( ToCoreVector( location ) );
+        }
     }
+
+    const auto counters = scheduler.Schedule( State, ViewerLocations, budget_microseconds );
+
+    AF_FLOCKING_COUNTER( STAT_FlockingBoids, Boids, State.Boids.size() );
+    AF_FLOCKING_COUNTER( STAT_FlockingLOD0Boids, LOD0Boids, counters.LODBoidsCounts[ 0 ] );
+    AF_FLOCKING_COUNTER( STAT_FlockingLOD1Boids, LOD1Boids, counters.LODBoidsCounts[ 1 ] );
+    AF_FLOCKING_COUNTER( STAT_FlockingLOD2Boids, LOD2Boids, counters.LODBoidsCounts[ 2 ] );
+    AF_FLOCKING_COUNTER( STAT_FlockingUpdatedBoids, UpdatedBoids, counters.UpdatedBoidsCount );
+    AF_FLOCKING_COUNTER( STAT_FlockingDeferredBoids, DeferredBoids, counters.DeferredBoidsCount );
 }
-#endif
 
-void UAFFlockingComponent::SetSettings( UAFFlockSettingsData * new_settings )
+void FAFFlockSimulationFrame::UpdateBoidsSteeringVelocity()
 {
-    if ( new_settings == nullptr )
-    {
-        return;
-    }
+    AF_FLOCKING_SCOPE( STAT_FlockingComponentUpdateSteeringVelocity, UpdateSteeringVelocity );
 
-    PrimaryComponentTick.SetTickFunctionEnable( true );
-    FlockTargetSettings = new_settings->Settings;
-    FlockInitialSettings = FlockSettings;
-    TransitionDuration = new_settings->TransitionDuration;
-    TransitionTimer = TransitionDuration;
-    FlockSettings.QueueCurve = new_settings->Settings.QueueCurve;
-    FlockSettings.bAllowSwapPositions = new_settings->Settings.bAllowSwapPositions;
-    FlockSettings.SwapPositionDistanceInterval = new_settings->Settings.SwapPositionDistanceInterval;
-    FlockSettings.SwapPositionDelayInterval = new_settings->Settings.SwapPositionDelayInterval;
-    FlockSettings.SwapPositionBoidCountInterval = new_settings->Settings.SwapPositionBoidCountInterval;
+    BuildNeighborSearchMicroseconds = 0.0;
+    ComputeSteeringMicroseconds = 0.0;
 
-    if ( HasBegunPlay() )
+    for ( auto step_index = 0; step_index < StepsCount; ++step_index )
     {
-        TrySetSwapBoidsPositionsTimer();
+        // The boids only move once per tick, so the later steps start from where the previous one leads them
+        if ( step_index > 0 )
+        {
+            AFFlockingCore::AdvanceFixedStep( State, StepDuration );
+        }
+
+        for ( auto & boid : State.Boids )
+        {
+            boid.PreviousSteeringVelocity = boid.SteeringVelocity;
+        }
+
+        ComputeSteeringStep();
     }
 }
 
-void UAFFlockingComponent::TickComponent( const float delta_time, const ELevelTick tick_type, FActorComponentTickFunction * this_tick_function )
+void FAFFlockSimulationFrame::ComputeSteeringStep()
 {
-    SCOPED_NAMED_EVENT( UAFFlockingComponent_TickComponent, FColor::Yellow );
-    SCOPE_CYCLE_COUNTER( STAT_FlockingComponentTick );
+    const auto options = GetSteeringOptions();
+    const auto start_cycles = FPlatformTime::Cycles64();
 
-    Super::TickComponent( delta_time, tick_type, this_tick_function );
+    {
+        AF_FLOCKING_SCOPE( STAT_FlockingComponentBuildSpatialHash, BuildNeighborSearch );
+        Simulation.BuildNeighborSearch( State, options );
+    }
 
-    TransitionTimer -= delta_time;
+    const auto compute_start_cycles = FPlatformTime::Cycles64();
+    const auto boids_count = static_cast< int32 >( State.BoidsToUpdate.size() );
+    const auto batch_size = FMath::Max( 1, Performance.ParallelSteeringMinBatchSize );
+    const auto batches_count = Performance.bUseParallelSteering
+                                   ? FMath::Max( 1, FMath::DivideAndRoundUp( boids_count, batch_size ) )
+                                   : 1;
 
-    if ( TransitionTimer <= 0.0f )
+    // Each batch has its own scratch and counters, which are summed afterwards in a deterministic order
+    BatchesScratches.resize( batches_count );
+
+    for ( auto & scratch : BatchesScratches )
     {
-        TransitionTimer = 0.0f;
+        scratch.Counters = AFFlockingCore::FSteeringCounters();
+    }
+
+    if ( batches_count > 1 )
+    {
+        AF_FLOCKING_SCOPE( STAT_FlockingComputeSteering, ComputeSteering );
+
+        ParallelFor( batches_count, [ this, batch_size, boids_count ]( const int32 batch_index ) {
+            TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL( FlockingComputeSteeringBatch, FlockingChannel );
+
+            const auto first_boid_index = batch_index * batch_size;
+            const auto last_boid_index = FMath::Min( first_boid_index + batch_size, boids_count );
+
+            Simulation.ComputeSteeringVelocities( State, first_boid_index, last_boid_index, BatchesScratches[ batch_index ] );
+        } );
     }
     else
     {
-        FlockSettings.LerpBetween( FlockInitialSettings, FlockTargetSettings, 1.0f - ( TransitionTimer / TransitionDuration ) );
+        AF_FLOCKING_SCOPE( STAT_FlockingComputeSteering, ComputeSteering );
+        Simulation.ComputeSteeringVelocities( State, 0, boids_count, BatchesScratches[ 0 ] );
     }
 
-    BoidsData.Reset( BoidsMovementComponents.Num() );
+    const auto end_cycles = FPlatformTime::Cycles64();
+    BuildNeighborSearchMicroseconds += FPlatformTime::ToMilliseconds64( compute_start_cycles - start_cycles ) * 1000.0;
+    ComputeSteeringMicroseconds += FPlatformTime::ToMilliseconds64( end_cycles - compute_start_cycles ) * 1000.0;
+
+    AFFlockingCore::FSteeringCounters counters;
 
-    for ( const auto * boid_movement_component : BoidsMovementComponents )
+    for ( const auto & scratch : BatchesScratches )
     {
-        BoidsData.Emplace( *boid_movement_component );
+        counters.Add( scratch.Counters );
     }
 
-    UpdateBoidsSteeringVelocity();
+    AF_FLOCKING_COUNTER( STAT_FlockingNeighborCandidates, NeighborCandidates, counters.NeighborCandidatesCount );
+    AF_FLOCKING_COUNTER( STAT_FlockingPairTests, PairTests, counters.PairTestsCount );
+    AF_FLOCKING_COUNTER( STAT_FlockingNeighbors, Neighbors, counters.NeighborsCount );
 
-    SCOPE_CYCLE_COUNTER( STAT_FlockingComponentRequestDirectMove );
-    for ( auto index = 0; index < BoidsData.Num(); ++index )
+    if ( Simulation.HasRebuiltNeighborLists() )
     {
-        BoidsMovementComponents[ index ]->RequestDirectMove( BoidsData[ index ].SteeringVelocity, true );
+        AF_FLOCKING_COUNTER( STAT_FlockingNeighborListsRebuilds, NeighborListsRebuilds, 1 );
+        SET_FLOAT_STAT( STAT_FlockingNeighborListsAverageLength, Simulation.GetNeighborLists().GetAverageLength() );
     }
 }
 
-void UAFFlockingComponent::UpdateBoidsSteeringVelocity()
+AFFlockingCore::FSteeringOptions FAFFlockSimulationFrame::GetSteeringOptions() const
 {
-    SCOPE_CYCLE_COUNTER( STAT_FlockingComponentUpdateSteeringVelocity );
+    AFFlockingCore::FSteeringOptions options;
+    options.bUseVectorizedKernel = Performance.bUseVectorizedSteering;
+    options.bStoreDebugForces = bStoreDebugForces;
+    options.bSeparateFromOtherFlocks = bSeparateFromOtherFlocks;
+    options.NeighborListSkinDistance = Performance.NeighborListSkinDistance;
+    return options;
+}
 
-    const auto owner = GetOwner();
-    const auto actor_forward_vector = owner->GetActorForwardVector();
-    const auto owner_velocity = owner->GetVelocity();
-    const auto owner_location = owner->GetActorLocation();
+void FAFFlockRecorder::Record( const FAFFlockSimulationFrame & frame, const FAFFlockingRecording & recording )
+{
+    if ( Recorder.GetMaxFramesCount() != FMath::Max( 0, recording.RecordedFramesCount ) )
+    {
+        Recorder.SetMaxFramesCount( recording.RecordedFramesCount );
+    }
 
-    for ( auto boid_index = 0; boid_index < BoidsData.Num(); ++boid_index )
+    if ( Recorder.GetMaxFramesCount() > 0 )
     {
-        auto & flock_data = BoidsData[ boid_index ];
-        const auto velocity = flock_data.Velocity;
+        AF_FLOCKING_SCOPE( STAT_FlockingRecordFrame, RecordFrame );
+        Recorder.Record( frame.State, frame.GetSteeringOptions() );
+    }
+}
 
-        FVector separation_force( 0.0f ),
-            alignment_force( 0.0f ),
-            cohesion_force( 0.0f );
+void FAFFlockRecorder::SaveOnSpike( const FAFFlockSimulationFrame & frame, const FAFFlockingRecording & recording, const FString & name )
+{
+    if ( recording.SaveOnSpikeMicroseconds <= 0.0f
+         || !Recorder.IsFull()
+         || frame.BuildNeighborSearchMicroseconds + frame.ComputeSteeringMicroseconds <= recording.SaveOnSpikeMicroseconds )
+    {
+        return;
+    }
 
-        auto separation_boids_count = 0,
-             alignment_boids_count = 0,
-             cohesion_boids_count = 0;
+    Save( FString::Printf( TEXT( "%s_%s.afrec" ), *name, *FDateTime::Now().ToString() ) );
+    Recorder.Clear();
+}
 
-        for ( auto other_boid_index = 0; other_boid_index < BoidsData.Num(); ++other_boid_index )
-        {
-            if ( other_boid_index == boid_index )
-            {
-                continue;
-            }
+bool FAFFlockRecorder::Save( const FString & file_name ) const
+{
+    if ( Recorder.GetFramesCount() == 0 )
+    {
+        return false;
+    }
 
-            const auto & other_flock_data = BoidsData[ other_boid_index ];
-            const auto to_other = other_flock_data.Center - flock_data.Center;
-            const auto distance = to_other.Size();
+    std::vector< uint8 > bytes;
+    Recorder.WriteTo( bytes );
 
-            if ( distance < FlockSettings.AlignmentRadius )
-            {
-                alignment_force += other_flock_data.Velocity;
-                alignment_boids_count++;
-            }
+    return FFileHelper::SaveArrayToFile( TArrayView< const uint8 >( bytes.data(), static_cast< int32 >( bytes.size() ) ), *( FPaths::ProfilingDir() / TEXT( "Flocking" ) / file_name ) );
+}
 
-            if ( distance < FlockSettings.CohesionRadius )
-            {
-                cohesion_force += other_flock_data.Center;
-                cohesion_boids_count++;
-            }
+namespace
+{
+    // Number of received states kept by a client. The base of a delta is the last state the client acknowledged, which is a few round trips old at most
+    constexpr int32 MaxReceivedStatesCount = 32;
 
-            if ( distance < FlockSettings.SeparationRadius )
-            {
-                separation_force += to_other * ( 1.0f - FMath::Clamp( distance / FlockSettings.SeparationRadius, 0.0f, 1.0f ) );
-                separation_boids_count++;
-            }
+    class FAFReplicatedFlockBaseState final : public INetDeltaBaseState
+    {
+    public:
+        FAFReplicatedFlockBaseState( const uint32 sequence, const TSharedPtr< const AFFlockingCore::FQuantizedFlock > & flock, const int32 updates_since_full_state ) :
+            Sequence( sequence ),
+            Flock( flock ),
+            UpdatesSinceFullState( updates_since_full_state )
+        {
         }
 
-        if ( alignment_boids_count > 0 )
+        bool IsStateEqual( INetDeltaBaseState * other_state ) override
         {
-            alignment_force /= alignment_boids_count;
+            return Sequence == static_cast< const FAFReplicatedFlockBaseState * >( other_state )->Sequence;
         }
 
-        if ( cohesion_boids_count > 0 )
+        uint32 Sequence;
+        TSharedPtr< const AFFlockingCore::FQuantizedFlock > Flock;
+        int32 UpdatesSinceFullState;
+    };
+}
+
+FAFReplicatedFlock::FAFReplicatedFlock() :
+    ActorBoidsCount( 0 ),
+    Sequence( 0 ),
+    FullStateInterval( 64 ),
+    SentBitsCount( 0 ),
+    NextReceivedStateIndex( 0 )
+{
+}
+
+bool FAFReplicatedFlock::NetDeltaSerialize( FNetDeltaSerializeInfo & delta_parms )
+{
+    if ( delta_parms.Writer != nullptr )
+    {
+        const auto * old_state = static_cast< const FAFReplicatedFlockBaseState * >( delta_parms.OldState );
+
+        if ( !Flock.IsValid() || ( old_state != nullptr && old_state->Sequence == Sequence ) )
         {
-            cohesion_force /= cohesion_boids_count;
-            cohesion_force -= flock_data.Center;
-            cohesion_force.Normalize();
-            cohesion_force *= flock_data.MaxVelocity;
+            return false;
         }
 
-        if ( separation_boids_count > 0 )
+        const auto send_full_state = old_state == nullptr || old_state->UpdatesSinceFullState + 1 >= FullStateInterval;
+        const auto * base = send_full_state ? nullptr : old_state->Flock.Get();
+        uint32 base_sequence = send_full_state ? 0 : old_state->Sequence;
+
+        *delta_parms.NewState = MakeShareable( new FAFReplicatedFlockBaseState( Sequence, Flock, send_full_state ? 0 : old_state->UpdatesSinceFullState + 1 ) );
+
+        Writer.Reset();
+        AFFlockingCore::EncodeQuantizedFlock( Writer, *Flock, base );
+
+        auto & archive = *delta_parms.Writer;
+        const auto start_bits_count = archive.GetNumBits();
+        auto sequence = Sequence;
+        auto actor_boids_count = static_cast< uint32 >( ActorBoidsCount );
+        auto bits_count = static_cast< uint32 >( Writer.GetBitsCount() );
+
+        archive << sequence;
+        archive << base_sequence;
+        archive.SerializeIntPacked( actor_boids_count );
+        archive.SerializeIntPacked( bits_count );
+        archive.SerializeBits( const_cast< uint8 * >( Writer.GetBytes().data() ), bits_count );
+
+        const auto written_bits_count = archive.GetNumBits() - start_bits_count;
+        SentBitsCount += written_bits_count;
+        AF_FLOCKING_COUNTER( STAT_FlockingReplicatedBytes, ReplicatedBytes, ( written_bits_count + 7 ) / 8 );
+        return true;
+    }
+
+    if ( delta_parms.Reader != nullptr )
+    {
+        auto & archive = *delta_parms.Reader;
+        uint32 sequence = 0;
+        uint32 base_sequence = 0;
+        uint32 actor_boids_count = 0;
+        uint32 bits_count = 0;
+
+        archive << sequence;
+        archive << base_sequence;
+        archive.SerializeIntPacked( actor_boids_count );
+        archive.SerializeIntPacked( bits_count );
+
+        if ( archive.IsError() || bits_count > archive.GetBitsLeft() )
         {
-            separation_force /= separation_boids_count;
-            separation_force *= -1.0f;
-            separation_force.Normalize();
-            separation_force *= flock_data.MaxVelocity;
+            archive.SetError();
+            return false;
         }
 
-        const auto pursuit_offset_multiplier = FlockSettings.QueueCurve != nullptr
-                                                   ? FlockSettings.QueueCurve->GetFloatValue( boid_index )
-                                                   : 1.0f;
-        const auto pursuit_target = owner_location - actor_forward_vector * FlockSettings.PursuitDistanceBehind * pursuit_offset_multiplier;
+        ReceivedBytes.SetNumUninitialized( ( bits_count + 7 ) / 8, false );
+        archive.SerializeBits( ReceivedBytes.GetData(), bits_count );
 
-        const auto seek_force = Pursuit( flock_data, pursuit_target, owner_velocity, FlockSettings.PursuitSlowdownRadius );
+        const AFFlockingCore::FQuantizedFlock * base = nullptr;
 
-        const auto draw_debug_line = [ world = GetWorld(), &flock_data ]( const FVector & end_offset, const FColor & color ) {
-            DrawDebugLine( world, flock_data.Center, flock_data.Center + end_offset, color, false, -1.0f, SDPG_World, 5.0f );
-        };
+        if ( base_sequence != 0 )
+        {
+            const auto * base_state = ReceivedStates.FindByPredicate( [ base_sequence ]( const FReceivedState & state ) {
+                return state.Sequence == base_sequence;
+            } );
+
+            // The state is dropped, and the next full state will resynchronize the client
+            if ( base_state == nullptr )
+            {
+                return true;
+            }
+
+            base = base_state->Flock.Get();
+        }
 
-        if ( Debug.bDrawPursuitForce )
+        auto flock = MakeShared< AFFlockingCore::FQuantizedFlock >();
+        AFFlockingCore::FBitsReader reader( ReceivedBytes.GetData(), bits_count );
+
+        if ( !AFFlockingCore::DecodeQuantizedFlock( reader, *flock, base ) )
         {
-            draw_debug_line( seek_force * FlockSettings.PursuitWeight, FColor::Green );
+            return true;
         }
-        if ( Debug.bDrawAlignmentForce )
+
+        const FReceivedState received_state { sequence, flock };
+
+        if ( ReceivedStates.Num() < MaxReceivedStatesCount )
         {
-            draw_debug_line( cohesion_force * FlockSettings.CohesionWeight, FColor::Yellow );
+            ReceivedStates.Add( received_state );
         }
-        if ( Debug.bDrawCohesionForce )
+        else
         {
-            draw_debug_line( alignment_force * FlockSettings.AlignmentWeight, FColor::Blue );
+            ReceivedStates[ NextReceivedStateIndex ] = received_state;
+            NextReceivedStateIndex = ( NextReceivedStateIndex + 1 ) % MaxReceivedStatesCount;
         }
-        if ( Debug.bDrawSeparationForce )
+
+        // The states can arrive out of order, and only the latest one is applied
+        if ( sequence > Sequence )
         {
-            draw_debug_line( separation_force * FlockSettings.SeparationWeight, FColor::Magenta );
+            Sequence = sequence;
+            Flock = flock;
+            ActorBoidsCount = static_cast< int32 >( actor_boids_count );
         }
-        if ( Debug.bDrawBoidSphere )
+
+        return true;
+    }
+
+    return false;
+}
+
+void FAFFlockSimulationFrame::DrawDebug( TArray< FBatchedLine > & lines, const FAFFlockingDebug & debug, const int32 flock_index ) const
+{
+    const auto boid_sphere_radius = 125.0f;
+    const auto & debug_forces = Simulation.GetDebugForces();
+    const auto & flock = State.Flocks[ flock_index ];
+    const auto stride = FMath::Max( 1, debug.DrawnBoidsStride );
+    const auto drawn_boids_count = debug.MaxDrawnBoidsCount > 0
+                                       ? FMath::Min( debug.MaxDrawnBoidsCount, FMath::DivideAndRoundUp( flock.BoidsCount, stride ) )
+                                       : FMath::DivideAndRoundUp( flock.BoidsCount, stride );
+    const auto segments_count = FMath::Clamp( debug.BoidSphereSegmentsCount, 3, 32 );
+
+    // The sphere is drawn as 3 circles, whose points are the same for all the boids
+    TArray< FVector2D, TInlineAllocator< 33 > > circle_points;
+
+    if ( debug.bDrawBoidSphere )
+    {
+        for ( auto segment_index = 0; segment_index <= segments_count; ++segment_index )
         {
-            DrawDebugSphere( GetWorld(), flock_data.Center, 125.0f, 32, FColor::Blue );
+            float sin, cos;
+            FMath::SinCos( &sin, &cos, 2.0f * PI * segment_index / segments_count );
+            circle_points.Emplace( cos * boid_sphere_radius, sin * boid_sphere_radius );
         }
+    }
 
-        auto result = velocity + seek_force * FlockSettings.PursuitWeight + cohesion_force * FlockSettings.CohesionWeight + alignment_force * FlockSettings.AlignmentWeight + separation_force * FlockSettings.SeparationWeight;
-        const auto direction = result.GetSafeNormal();
+    const auto boid_lines_count = debug.bDrawPursuitForce + debug.bDrawAlignmentForce + debug.bDrawCohesionForce + debug.bDrawSeparationForce + debug.bDrawObstacleAvoidanceForce + ( debug.bDrawBoidSphere ? 3 * segments_count : 0 );
+    lines.Reserve( lines.Num() + drawn_boids_count * boid_lines_count );
 
-        const auto dot = FVector::DotProduct( direction, actor_forward_vector );
+    for ( auto drawn_boid_index = 0; drawn_boid_index < drawn_boids_count; ++drawn_boid_index )
+    {
+        const auto boid_index = flock.FirstBoidIndex + drawn_boid_index * stride;
+        const auto & boid = State.Boids[ boid_index ];
+        const auto center = ToVector( boid.Center );
+        const auto & boid_debug_forces = debug_forces[ boid_index ];
+        // The forces of the boids skipped by the levels of detail or the budget this frame are the ones of an older frame
+        const auto has_current_forces = boid.FramesSinceUpdate == 0;
+
+        const auto add_force_line = [ &lines, &center ]( const AFFlockingCore::FVec3 & end_offset, const FLinearColor & color ) {
+            lines.Emplace( center, center + ToVector( end_offset ), color, 0.0f, 5.0f, SDPG_World );
+        };
 
-        if ( dot < 0.0f )
+        if ( has_current_forces && debug.bDrawPursuitForce )
+        {
+            add_force_line( boid_debug_forces.PursuitForce, FColor::Green );
+        }
+        if ( has_current_forces && debug.bDrawAlignmentForce )
+        {
+            add_force_line( boid_debug_forces.AlignmentForce, FColor::Yellow );
+        }
+        if ( has_current_forces && debug.bDrawCohesionForce )
+        {
+            add_force_line( boid_debug_forces.CohesionForce, FColor::Blue );
+        }
+        if ( has_current_forces && debug.bDrawSeparationForce )
         {
-            result += result * -FlockSettings.NonForwardVelocityBrakingFactor;
+            add_force_line( boid_debug_forces.SeparationForce, FColor::Magenta );
         }
+        if ( has_current_forces && debug.bDrawObstacleAvoidanceForce )
+        {
+            add_force_line( boid_debug_forces.ObstacleAvoidanceForce, FColor::Red );
+        }
+        if ( debug.bDrawBoidSphere )
+        {
+            for ( auto segment_index = 0; segment_index < segments_count; ++segment_index )
+            {
+                const auto & start = circle_points[ segment_index ];
+                const auto & end = circle_points[ segment_index + 1 ];
 
-        flock_data.SteeringVelocity = direction * flock_data.MaxVelocity;
+                lines.Emplace( center + FVector( start.X, start.Y, 0.0f ), center + FVector( end.X, end.Y, 0.0f ), FLinearColor::Blue, 0.0f, 0.0f, SDPG_World );
+                lines.Emplace( center + FVector( start.X, 0.0f, start.Y ), center + FVector( end.X, 0.0f, end.Y ), FLinearColor::Blue, 0.0f, 0.0f, SDPG_World );
+                lines.Emplace( center + FVector( 0.0f, start.X, start.Y ), center + FVector( 0.0f, end.X, end.Y ), FLinearColor::Blue, 0.0f, 0.0f, SDPG_World );
+            }
+        }
     }
 }
 
-void UAFFlockingComponent::TrySetSwapBoidsPositionsTimer()
+FAFFlockingApplySteeringTickFunction::FAFFlockingApplySteeringTickFunction() :
+    Target( nullptr )
 {
-    if ( FlockSettings.bAllowSwapPositions )
+}
+
+void FAFFlockingApplySteeringTickFunction::ExecuteTick( float /*delta_time*/, ELevelTick /*tick_type*/, ENamedThreads::Type /*current_thread*/, const FGraphEventRef & /*completion_graph_event*/ )
+{
+    if ( Target != nullptr && !Target->IsPendingKill() )
     {
-        const auto delay = FMath::FRandRange( FlockSettings.SwapPositionDelayInterval.Min, FlockSettings.SwapPositionDelayInterval.Max );
-        GetWorld()->GetTimerManager().SetTimer( SwapBoidPositionTimerHandle, this, &UAFFlockingComponent::RandomSwapBoidsPositions, delay );
+        Target->CompleteAsyncSteering();
     }
 }
 
-void UAFFlockingComponent::RandomSwapBoidsPositions()
+FString FAFFlockingApplySteeringTickFunction::DiagnosticMessage()
 {
-    const auto boids_count = BoidsMovementComponents.Num();
+    return Target != nullptr
+               ? Target->GetFullName() + TEXT( "[ApplySteering]" )
+               : TEXT( "<NULL>[ApplySteering]" );
+}
+
+UAFFlockingComponent::UAFFlockingComponent()
+{
+    PrimaryComponentTick.bCanEverTick = true;
+    PrimaryComponentTick.bStartWithTickEnabled = true;
+    ApplySteeringTickFunction.bCanEverTick = true;
+    ApplySteeringTickFunction.bStartWithTickEnabled = false;
+    ApplySteeringTickFunction.TickGroup = TG_PostUpdateWork;
+    LightweightBoidsInstances = nullptr;
+    TransitionDuration = 0.0f;
+    TransitionTimer = 0.0f;
+    AsyncFrameIndex = 0;
+    bHasPendingAsyncFrame = false;
+    NextBoidHandleId = 0;
+    BoidsOrderVersion = 0;
+    TicksSinceBoidsSort = 0;
+    ReplicatedBytesPerSecond = 0.0f;
+    AppliedReplicatedSequence = 0;
+    ReplicationMeasureStartTime = 0.0f;
+    ObstacleTraceCursor = 0;
+    SettledDuration = 0.0f;
+    SleepTimer = 0.0f;
+    AwakeTickInterval = 0.0f;
+    bIsSleeping = false;
+    ObstacleTraceDelegate.BindUObject( this, &UAFFlockingComponent::OnObstacleTraceDone );
+}
 
-    if ( boids_count == 2 )
+FAFBoidHandle UAFFlockingComponent::RegisterMovementComponent( UMovementComponent * movement_component )
+{
+    if ( movement_component == nullptr || movement_component->UpdatedComponent == nullptr )
     {
-        BoidsMovementComponents.Swap( 0, 1 );
+        return FAFBoidHandle();
     }
-    else if ( boids_count > 2 )
+
+    if ( const auto * character_movement_component = Cast< UCharacterMovementComponent >( movement_component ) )
     {
-        auto boids_to_swap_count = FMath::RandRange( FlockSettings.SwapPositionBoidCountInterval.Min, FlockSettings.SwapPositionBoidCountInterval.Max );
+        ensureMsgf( character_movement_component->IsFlying(), TEXT( "You should register flying actors to the flock" ) );
+    }
 
-        while ( boids_to_swap_count > 0 )
+    if ( const auto * existing_boid_handle = MovementComponentsHandles.Find( movement_component ) )
+    {
+        return *existing_boid_handle;
+    }
+
+    const FAFBoidHandle boid_handle( NextBoidHandleId++ );
+
+    AFFlockingCore::FBoid boid;
+    boid.Center = AFFlockingCore::FVec3( 0.0f );
+    boid.Velocity = AFFlockingCore::FVec3( 0.0f );
+    boid.MaxVelocity = movement_component->GetMaxSpeed();
+    boid.SteeringVelocity = AFFlockingCore::FVec3( 0.0f );
+    boid.PreviousSteeringVelocity = AFFlockingCore::FVec3( 0.0f );
+    boid.FramesSinceUpdate = AFFlockingCore::NeverUpdated;
+    boid.ObstacleAvoidance = AFFlockingCore::FVec3( 0.0f );
+
+    BoidsSlots.Add( boid_handle, BoidsMovementComponents.Add( movement_component ) );
+    BoidsHandles.Add( boid_handle );
+    BoidsData.Add( boid );
+    QueueSlots.Add();
+    MovementComponentsHandles.Add( movement_component, boid_handle );
+
+    if ( auto * boid_movement_component = Cast< UAFBoidMovementComponent >( movement_component ) )
+    {
+        if ( boid_movement_component->SetMovedByFlock( true ) )
         {
-            const auto first_boid_index = FMath::RandRange( 0, boids_count - 1 );
+            FlockMovedBoids.Add( boid_movement_component );
+        }
+    }
 
-            TArray< int > indices;
-            indices.Reserve( BoidsMovementComponents.Num() - 1 );
+    // The lightweight boids come after the new boid, so their position in the queue changed too
+    BakeQueueCurve( BoidsMovementComponents.Num() - 1 );
 
-            const auto first_index = FMath::Max( 0, first_boid_index - FlockSettings.SwapPositionDistanceInterval.Max );
-            const auto last_index = FMath::Min( BoidsMovementComponents.Num(), first_boid_index + FlockSettings.SwapPositionDistanceInterval.Max );
+    if ( auto * character = Cast< ACharacter >( movement_component->GetOwner() ) )
+    {
+        character->MovementModeChangedDelegate.AddUniqueDynamic( this, &UAFFlockingComponent::OnBoidMovementModeChanged );
+    }
 
-            for ( auto index = first_index; index < last_index; ++index )
-            {
-                if ( index == first_boid_index )
-                {
-                    continue;
-                }
+    // The flock replicates the movement of its boids
+    if ( Replication.bReplicateFlock && GetOwnerRole() == ROLE_Authority )
+    {
+        movement_component->GetOwner()->SetReplicateMovement( false );
+    }
 
-                if ( FMath::Abs( index - first_boid_index ) < FlockSettings.SwapPositionDistanceInterval.Min )
-                {
-                    continue;
-                }
+    WakeUp();
 
-                indices.Add( index );
-            }
+    return boid_handle;
+}
 
-            if ( indices.Num() >= 2 )
-            {
-                const auto random_index = FMath::RandRange( 0, indices.Num() - 1 );
-                const auto second_boid_index = indices[ random_index ];
+void UAFFlockingComponent::UnRegisterMovementComponent( UMovementComponent * movement_component )
+{
+    if ( const auto * boid_handle = MovementComponentsHandles.Find( movement_component ) )
+    {
+        UnRegisterBoid( *boid_handle );
+    }
+}
 
-                BoidsMovementComponents.Swap( first_boid_index, second_boid_index );
-            }
+void UAFFlockingComponent::UnRegisterBoid( const FAFBoidHandle boid_handle )
+{
+    // The handle of the boid is not found anymore when the async steering is applied, so the boid does not receive the velocity the task is computing for it
+    int32 slot;
+    if ( !BoidsSlots.RemoveAndCopyValue( boid_handle, slot ) )
+    {
+        return;
+    }
 
-            --boids_to_swap_count;
-        }
+    auto * movement_component = BoidsMovementComponents[ slot ];
+    MovementComponentsHandles.Remove( movement_component );
+
+    if ( auto * boid_movement_component = Cast< UAFBoidMovementComponent >( movement_component ) )
+    {
+        FlockMovedBoids.RemoveSingleSwap( boid_movement_component, false );
+        boid_movement_component->SetMovedByFlock( false );
     }
 
-    TrySetSwapBoidsPositionsTimer();
+    if ( auto * character = Cast< ACharacter >( movement_component->GetOwner() ) )
+    {
+        character->MovementModeChangedDelegate.RemoveDynamic( this, &UAFFlockingComponent::OnBoidMovementModeChanged );
+    }
+
+    BakeQueueCurve( RemoveBoidSlot( slot ) );
+    WakeUp();
+}
+
+void UAFFlockingComponent::RefreshBoidMaxVelocity( const FAFBoidHandle boid_handle )
+{
+    if ( const auto * slot = BoidsSlots.Find( boid_handle ) )
+    {
+        BoidsData[ *slot ].MaxVelocity = BoidsMovementComponents[ *slot ]->GetMaxSpeed();
+    }
+}
+
+void UAFFlockingComponent::SetLightweightBoidsCount( const int32 count )
+{
+    LightweightBoids.Count = FMath::Max( 0, count );
+
+    if ( HasBegunPlay() )
+    {
+        ResizeLightweightBoids();
+        WakeUp();
+    }
+}
+
+int32 UAFFlockingComponent::GetLightweightBoidsCount() const
+{
+    return LightweightBoidsData.Num();
+}
+
+void UAFFlockingComponent::WakeUp()
+{
+    SettledDuration = 0.0f;
+
+    if ( !bIsSleeping )
+    {
+        return;
+    }
+
+    LeaveSleep();
+
+    // The flocking subsystem simulates the flock again by itself
+    if ( !FlockingSubsystem.IsValid() )
+    {
+        SetComponentTickInterval( AwakeTickInterval );
+        PrimaryComponentTick.SetTickFunctionEnable( true );
+    }
+}
+
+void UAFFlockingComponent::SetSleepEnabled( const bool enable_sleep )
+{
+    Sleep.bEnableSleep = enable_sleep;
+
+    if ( !enable_sleep )
+    {
+        WakeUp();
+    }
+}
+
+bool UAFFlockingComponent::IsSleeping() const
+{
+    return bIsSleeping;
+}
+
+bool UAFFlockingComponent::SaveRecording( const FString & file_name ) const
+{
+    return Recorder.Save( file_name );
+}
+
+void UAFFlockingComponent::BeginPlay()
+{
+    Super::BeginPlay();
+
+    TraceName = FString::Printf( TEXT( "Flock %s" ), *GetOwner()->GetName() );
+
+    if ( Replication.bReplicateFlock )
+    {
+        SetIsReplicated( true );
+    }
+
+    if ( Performance.bUseFlockingSubsystem )
+    {
+        if ( auto * flocking_subsystem = GetWorld()->GetSubsystem< UAFFlockingSubsystem >() )
+        {
+            FlockingSubsystem = flocking_subsystem;
+            flocking_subsystem->RegisterFlock( this );
+            PrimaryComponentTick.SetTickFunctionEnable( false );
+        }
+    }
+
+#if WITH_EDITOR
+    ObjectPropertyChangedDelegateHandle = FCoreUObjectDelegates::OnObjectPropertyChanged.AddUObject( this, &UAFFlockingComponent::OnObjectPropertyChanged );
+#endif
+
+    SetSettings( FlockSettingsData );
+    ResizeLightweightBoids();
+}
+
+void UAFFlockingComponent::EndPlay( const EEndPlayReason::Type end_play_reason )
+{
+    DiscardAsyncSteering();
+    LeaveSleep();
+
+#if WITH_EDITOR
+    FCoreUObjectDelegates::OnObjectPropertyChanged.Remove( ObjectPropertyChangedDelegateHandle );
+#endif
+
+    if ( LightweightBoidsInstances != nullptr )
+    {
+        LightweightBoidsInstances->DestroyComponent();
+        LightweightBoidsInstances = nullptr;
+    }
+
+    LightweightBoidsData.Reset();
+
+    // The boids which stay in the world move on their own again
+    for ( auto * boid_movement_component : FlockMovedBoids )
+    {
+        if ( IsValid( boid_movement_component ) )
+        {
+            boid_movement_component->SetMovedByFlock( false );
+        }
+    }
+
+    FlockMovedBoids.Reset();
+
+    if ( auto * flocking_subsystem = FlockingSubsystem.Get() )
+    {
+        flocking_subsystem->UnRegisterFlock( this );
+        FlockingSubsystem = nullptr;
+    }
+
+    Super::EndPlay( end_play_reason );
+}
+
+void UAFFlockingComponent::OnUnregister()
+{
+    DiscardAsyncSteering();
+
+    Super::OnUnregister();
+}
+
+void UAFFlockingComponent::RegisterComponentTickFunctions( const bool register_tick_functions )
+{
+    Super::RegisterComponentTickFunctions( register_tick_functions );
+
+    if ( register_tick_functions )
+    {
+        if ( SetupActorComponentTickFunction( &ApplySteeringTickFunction ) )
+        {
+            ApplySteeringTickFunction.Target = this;
+            ApplySteeringTickFunction.AddPrerequisite( this, PrimaryComponentTick );
+        }
+    }
+    else if ( ApplySteeringTickFunction.IsTickFunctionRegistered() )
+    {
+        ApplySteeringTickFunction.UnRegisterTickFunction();
+    }
+}
+
+#if WITH_EDITOR
+void UAFFlockingComponent::PostEditChangeProperty( FPropertyChangedEvent & property_changed_event )
+{
+    Super::PostEditChangeProperty( property_changed_event );
+
+    static const FName SettingsDataName( TEXT( "FlockSettingsData" ) );
+
+    if ( property_changed_event.GetPropertyName() == SettingsDataName )
+    {
+        SetSettings( FlockSettingsData );
+    }
+}
+
+void UAFFlockingComponent::OnObjectPropertyChanged( UObject * object, FPropertyChangedEvent & /*property_changed_event*/ )
+{
+    if ( object != nullptr && object == FlockSettings.QueueCurve )
+    {
+        BakeQueueCurve( 0 );
+    }
+}
+#endif
+
+void UAFFlockingComponent::SetSettings( UAFFlockSettingsData * new_settings )
+{
+    if ( new_settings == nullptr )
+    {
+        return;
+    }
+
+    // Allows to correlate the cost of the flock with the change of its settings in the captured traces
+    TRACE_BOOKMARK( TEXT( "%s : %s" ), *TraceName, *new_settings->GetName() );
+
+    WakeUp();
+
+    // The flocking subsystem ticks the flocks it batches
+    PrimaryComponentTick.SetTickFunctionEnable( !FlockingSubsystem.IsValid() );
+    FlockTargetSettings = new_settings->Settings;
+    FlockInitialSettings = FlockSettings;
+    TransitionDuration = new_settings->TransitionDuration;
+    TransitionTimer = TransitionDuration;
+    FlockSettings.QueueCurve = new_settings->Settings.QueueCurve;
+    FlockSettings.bAllowSwapPositions = new_settings->Settings.bAllowSwapPositions;
+    FlockSettings.SwapPositionDistanceInterval = new_settings->Settings.SwapPositionDistanceInterval;
+    FlockSettings.SwapPositionDelayInterval = new_settings->Settings.SwapPositionDelayInterval;
+    FlockSettings.SwapPositionBoidCountInterval = new_settings->Settings.SwapPositionBoidCountInterval;
+    FlockSettings.ObstacleTraceDistance = new_settings->Settings.ObstacleTraceDistance;
+    FlockSettings.ObstacleTraceChannel = new_settings->Settings.ObstacleTraceChannel;
+    FlockSettings.MaxObstacleTracesPerTick = new_settings->Settings.MaxObstacleTracesPerTick;
+    FlockSettings.ObstacleMemoryHalfLife = new_settings->Settings.ObstacleMemoryHalfLife;
+
+    // The curve is not part of the transition, so the table is final as soon as the settings are set
+    BakeQueueCurve( 0 );
+
+    if ( HasBegunPlay() )
+    {
+        TrySetSwapBoidsPositionsTimer();
+    }
+}
+
+void UAFFlockingComponent::TickComponent( const float delta_time, const ELevelTick tick_type, FActorComponentTickFunction * this_tick_function )
+{
+    SCOPED_NAMED_EVENT( UAFFlockingComponent_TickComponent, FColor::Yellow );
+    AF_FLOCKING_SCOPE( STAT_FlockingComponentTick, ComponentTick );
+    AF_FLOCK_TRACE_SCOPE( this );
+
+    Super::TickComponent( delta_time, tick_type, this_tick_function );
+
+    UnRegisterInvalidBoids();
+
+    const auto use_fixed_timestep = Performance.FixedTimestepRate > 0.0f;
+    const auto step_duration = use_fixed_timestep ? 1.0f / Performance.FixedTimestepRate : delta_time;
+    const auto steps_count = use_fixed_timestep ? FixedTimestep.Advance( delta_time, step_duration, Performance.MaxSubstepsCount ) : 1;
+
+    // The transition and the obstacle traces advance once by all the due steps, while the steering is computed for each of them
+    UpdateSettingsTransition( steps_count * step_duration );
+
+    const auto use_async_steering = Performance.bUseAsyncSteering;
+    const auto apply_at_end_of_frame = use_async_steering && Performance.AsyncSteeringLatency == EAFAsyncSteeringLatency::SameFrame;
+
+    if ( ApplySteeringTickFunction.IsTickFunctionEnabled() != apply_at_end_of_frame )
+    {
+        ApplySteeringTickFunction.SetTickFunctionEnable( apply_at_end_of_frame );
+    }
+
+    if ( steps_count == 0 )
+    {
+        CompleteAsyncSteering();
+        RequestInterpolatedMoves( FixedTimestep.GetInterpolationRatio( step_duration ) );
+        UpdateLightweightBoids( delta_time );
+        MoveBoids( delta_time );
+        return;
+    }
+
+    // Gather in the frame the task does not use, while it may still be running
+    auto & frame = SimulationFrames[ 1 - AsyncFrameIndex ];
+    frame.BoidsHandles.Reset();
+    frame.BoidsOrder.Reset();
+
+    UpdateObstacleAvoidance( steps_count * step_duration, FlockSettings.MaxObstacleTracesPerTick );
+    UpdateBoidsOrder( Performance.BoidsSortInterval );
+    GatherSimulationFrame( frame );
+    frame.StepsCount = steps_count;
+    frame.StepDuration = step_duration;
+    frame.ScheduleBoidsUpdate( UpdateScheduler, GetWorld(), LOD.UpdateBudgetMicroseconds );
+    StoreBoidsUpdateFrames( frame.State, 0 );
+    Recorder.Record( frame, Recording );
+
+    if ( use_async_steering )
+    {
+        frame.BoidsHandles.Append( BoidsHandles );
+        frame.BoidsOrder.Append( BoidsOrder );
+    }
+
+    CompleteAsyncSteering();
+
+    if ( use_async_steering )
+    {
+        AsyncFrameIndex = 1 - AsyncFrameIndex;
+        DispatchAsyncSteering();
+    }
+    else
+    {
+        frame.UpdateBoidsSteeringVelocity();
+        ApplySimulationFrame( frame );
+    }
+
+    if ( use_fixed_timestep )
+    {
+        RequestInterpolatedMoves( FixedTimestep.GetInterpolationRatio( step_duration ) );
+    }
+    else
+    {
+        FixedTimestep.Reset();
+    }
+
+    UpdateLightweightBoids( delta_time );
+    MoveBoids( delta_time );
+    UpdateSleep( steps_count * step_duration );
+}
+
+void UAFFlockingComponent::GetLifetimeReplicatedProps( TArray< FLifetimeProperty > & out_lifetime_props ) const
+{
+    Super::GetLifetimeReplicatedProps( out_lifetime_props );
+
+    DOREPLIFETIME( UAFFlockingComponent, ReplicatedBoidsActors );
+    DOREPLIFETIME( UAFFlockingComponent, ReplicatedFlock );
+}
+
+void UAFFlockingComponent::PreReplication( IRepChangedPropertyTracker & changed_property_tracker )
+{
+    Super::PreReplication( changed_property_tracker );
+
+    if ( Replication.bReplicateFlock )
+    {
+        UpdateReplicatedFlock();
+    }
+}
+
+void UAFFlockingComponent::UpdateSettingsTransition( const float delta_time )
+{
+    TransitionTimer -= delta_time;
+
+    if ( TransitionTimer <= 0.0f )
+    {
+        TransitionTimer = 0.0f;
+    }
+    else
+    {
+        FlockSettings.LerpBetween( FlockInitialSettings, FlockTargetSettings, 1.0f - ( TransitionTimer / TransitionDuration ) );
+    }
+}
+
+void UAFFlockingComponent::GatherSimulationFrame( FAFFlockSimulationFrame & frame ) const
+{
+    frame.Debug = Debug;
+    frame.Performance = Performance;
+    frame.bStoreDebugForces = Debug.IsEnabled();
+    frame.State.Reset();
+
+    GatherFlock( frame.State );
+}
+
+void UAFFlockingComponent::UpdateBoidsOrder( const int32 sort_interval )
+{
+    if ( sort_interval <= 0 )
+    {
+        if ( BoidsOrder.Num() > 0 )
+        {
+            BoidsOrder.Reset();
+            ++BoidsOrderVersion;
+        }
+
+        return;
+    }
+
+    const auto boids_count = BoidsMovementComponents.Num();
+    const auto flock_boids_count = boids_count + LightweightBoidsData.Num();
+
+    // The order is a permutation of the slots, which must be sorted again as soon as boids are added or removed
+    if ( BoidsOrder.Num() == flock_boids_count && ++TicksSinceBoidsSort < sort_interval )
+    {
+        return;
+    }
+
+    AF_FLOCKING_SCOPE( STAT_FlockingSortBoids, SortBoids );
+
+    TicksSinceBoidsSort = 0;
+    BoidsSortCenters.resize( flock_boids_count );
+
+    for ( auto slot = 0; slot < boids_count; ++slot )
+    {
+        BoidsSortCenters[ slot ] = ToCoreVector( BoidsMovementComponents[ slot ]->UpdatedComponent->GetComponentLocation() );
+    }
+
+    for ( auto index = 0; index < LightweightBoidsData.Num(); ++index )
+    {
+        BoidsSortCenters[ boids_count + index ] = LightweightBoidsData[ index ].Center;
+    }
+
+    BoidsOrder.SetNumUninitialized( flock_boids_count, false );
+    AFFlockingCore::SortByMortonCode( BoidsOrder.GetData(), BoidsSortCenters.data(), flock_boids_count, BoidsSortKeys );
+    ++BoidsOrderVersion;
+}
+
+int32 UAFFlockingComponent::GetBoidSlot( const int32 index ) const
+{
+    return BoidsOrder.Num() > 0 ? BoidsOrder[ index ] : index;
+}
+
+void UAFFlockingComponent::GatherFlock( AFFlockingCore::FFlockState & state ) const
+{
+    AF_FLOCKING_SCOPE( STAT_FlockingGather, Gather );
+    AF_FLOCK_TRACE_SCOPE( this );
+
+    const auto * owner = GetOwner();
+    const auto boids_count = BoidsMovementComponents.Num();
+    const auto lightweight_boids_count = LightweightBoidsData.Num();
+    auto & flock = state.AddFlock( boids_count + lightweight_boids_count );
+
+    flock.Params = FlockSettings.GetParams();
+    flock.LOD = LOD.GetParams();
+    flock.OwnerLocation = ToCoreVector( owner->GetActorLocation() );
+    flock.OwnerForwardVector = ToCoreVector( owner->GetActorForwardVector() );
+    flock.OwnerVelocity = ToCoreVector( owner->GetVelocity() );
+    flock.BoidsOrderVersion = BoidsOrderVersion;
+
+    check( PursuitOffsetMultipliers.Num() == flock.BoidsCount );
+
+    if ( BoidsOrder.Num() > 0 )
+    {
+        check( BoidsOrder.Num() == flock.BoidsCount );
+
+        for ( auto index = 0; index < flock.BoidsCount; ++index )
+        {
+            const auto slot = BoidsOrder[ index ];
+            auto & boid = state.Boids[ flock.FirstBoidIndex + index ];
+
+            if ( slot < boids_count )
+            {
+                const auto * boid_movement_component = BoidsMovementComponents[ slot ];
+                boid = BoidsData[ slot ];
+                boid.Center = ToCoreVector( boid_movement_component->UpdatedComponent->GetComponentLocation() );
+                boid.Velocity = ToCoreVector( boid_movement_component->Velocity );
+            }
+            else
+            {
+                boid = LightweightBoidsData[ slot - boids_count ];
+            }
+
+            state.PursuitOffsetMultipliers[ flock.FirstBoidIndex + index ] = PursuitOffsetMultipliers[ slot ];
+        }
+
+        return;
+    }
+
+    // The cached state is copied as is, then only the location and the velocity, which change every frame, are read from the movement components
+    if ( boids_count > 0 )
+    {
+        FMemory::Memcpy( &state.Boids[ flock.FirstBoidIndex ], BoidsData.GetData(), boids_count * sizeof( AFFlockingCore::FBoid ) );
+    }
+
+    if ( lightweight_boids_count > 0 )
+    {
+        FMemory::Memcpy( &state.Boids[ flock.FirstBoidIndex + boids_count ], LightweightBoidsData.GetData(), lightweight_boids_count * sizeof( AFFlockingCore::FBoid ) );
+    }
+
+    for ( auto slot = 0; slot < boids_count; ++slot )
+    {
+        const auto * boid_movement_component = BoidsMovementComponents[ slot ];
+        auto & boid = state.Boids[ flock.FirstBoidIndex + slot ];
+
+        boid.Center = ToCoreVector( boid_movement_component->UpdatedComponent->GetComponentLocation() );
+        boid.Velocity = ToCoreVector( boid_movement_component->Velocity );
+    }
+
+    FMemory::Memcpy( &state.PursuitOffsetMultipliers[ flock.FirstBoidIndex ], PursuitOffsetMultipliers.GetData(), flock.BoidsCount * sizeof( float ) );
+}
+
+void UAFFlockingComponent::BakeQueueCurve( const int32 first_position )
+{
+    const auto boids_count = BoidsMovementComponents.Num();
+    const auto flock_boids_count = boids_count + LightweightBoidsData.Num();
+    const auto first_baked_position = FMath::Min( first_position, PursuitOffsetMultipliers.Num() );
+
+    PursuitOffsetMultipliers.SetNumUninitialized( flock_boids_count, false );
+
+    for ( auto position = first_baked_position; position < flock_boids_count; ++position )
+    {
+        // The lightweight boids are stored in their queue order
+        const auto index = position < boids_count ? QueueSlots.GetBoidIndex( position ) : position;
+        PursuitOffsetMultipliers[ index ] = FlockSettings.QueueCurve != nullptr ? FlockSettings.QueueCurve->GetFloatValue( position ) : 1.0f;
+    }
+}
+
+void UAFFlockingComponent::StoreBoidsUpdateFrames( const AFFlockingCore::FFlockState & state, const int32 flock_index )
+{
+    const auto & flock = state.Flocks[ flock_index ];
+    const auto boids_count = BoidsMovementComponents.Num();
+
+    for ( auto index = 0; index < flock.BoidsCount; ++index )
+    {
+        const auto slot = GetBoidSlot( index );
+        const auto frames_since_update = state.Boids[ flock.FirstBoidIndex + index ].FramesSinceUpdate;
+
+        if ( slot < boids_count )
+        {
+            BoidsData[ slot ].FramesSinceUpdate = frames_since_update;
+        }
+        else
+        {
+            LightweightBoidsData[ slot - boids_count ].FramesSinceUpdate = frames_since_update;
+        }
+    }
+}
+
+void UAFFlockingComponent::ApplySimulationFrame( const FAFFlockSimulationFrame & frame )
+{
+    UpdateScheduler.ReportUpdateDuration( static_cast< int32 >( frame.State.BoidsToUpdate.size() ), frame.BuildNeighborSearchMicroseconds, frame.ComputeSteeringMicroseconds );
+    Recorder.SaveOnSpike( frame, Recording, GetOwner()->GetName() );
+
+    // Async frames keep track of their own boids, as some may have been unregistered since the data was gathered
+    if ( !frame.Performance.bUseAsyncSteering )
+    {
+        ApplyFlockSteering( frame, 0 );
+        return;
+    }
+
+    if ( frame.Debug.IsEnabled() )
+    {
+        DrawFlockDebug( frame, frame.Debug, 0 );
+    }
+
+    AF_FLOCKING_SCOPE( STAT_FlockingComponentRequestDirectMove, ApplySteering );
+
+    const auto & boids = frame.State.Boids;
+    const auto boids_count = frame.BoidsHandles.Num();
+    const auto request_direct_move = frame.Performance.FixedTimestepRate <= 0.0f;
+
+    // Boids may have been registered, unregistered or moved to another slot since the frame was gathered, and the lightweight boids may have been resized
+    for ( auto index = 0; index < static_cast< int32 >( boids.size() ); ++index )
+    {
+        const auto frame_slot = frame.BoidsOrder.Num() > 0 ? frame.BoidsOrder[ index ] : index;
+        const auto & frame_boid = boids[ index ];
+
+        if ( frame_slot < boids_count )
+        {
+            if ( const auto * slot = BoidsSlots.Find( frame.BoidsHandles[ frame_slot ] ) )
+            {
+                ApplyBoidSteering( *slot, frame_boid, request_direct_move );
+            }
+        }
+        else if ( LightweightBoidsData.IsValidIndex( frame_slot - boids_count ) )
+        {
+            LightweightBoidsData[ frame_slot - boids_count ].SteeringVelocity = frame_boid.SteeringVelocity;
+        }
+    }
+}
+
+void UAFFlockingComponent::ApplyFlockSteering( const FAFFlockSimulationFrame & frame, const int32 flock_index )
+{
+    AF_FLOCK_TRACE_SCOPE( this );
+
+    if ( Debug.IsEnabled() )
+    {
+        DrawFlockDebug( frame, Debug, flock_index );
+    }
+
+    AF_FLOCKING_SCOPE( STAT_FlockingComponentRequestDirectMove, ApplySteering );
+
+    const auto & flock = frame.State.Flocks[ flock_index ];
+    const auto boids_count = BoidsMovementComponents.Num();
+    const auto request_direct_move = frame.Performance.FixedTimestepRate <= 0.0f;
+
+    for ( auto index = 0; index < flock.BoidsCount; ++index )
+    {
+        const auto slot = GetBoidSlot( index );
+        const auto & frame_boid = frame.State.Boids[ flock.FirstBoidIndex + index ];
+
+        if ( slot < boids_count )
+        {
+            ApplyBoidSteering( slot, frame_boid, request_direct_move );
+        }
+        else
+        {
+            LightweightBoidsData[ slot - boids_count ].SteeringVelocity = frame_boid.SteeringVelocity;
+        }
+    }
+}
+
+void UAFFlockingComponent::DrawFlockDebug( const FAFFlockSimulationFrame & frame, const FAFFlockingDebug & debug, const int32 flock_index )
+{
+    AF_FLOCKING_SCOPE( STAT_FlockingComponentDrawDebug, DrawDebug );
+
+    const auto * world = GetWorld();
+
+    // Same conditions as DrawDebugLine, but all the lines of the flock go to the line batcher at once
+    if ( world == nullptr || world->LineBatcher == nullptr || world->GetNetMode() == NM_DedicatedServer )
+    {
+        return;
+    }
+
+    DebugLines.Reset();
+    frame.DrawDebug( DebugLines, debug, flock_index );
+    world->LineBatcher->DrawLines( DebugLines );
+}
+
+void UAFFlockingComponent::ApplyBoidSteering( const int32 slot, const AFFlockingCore::FBoid & frame_boid, const bool request_direct_move )
+{
+    auto & boid = BoidsData[ slot ];
+    boid.PreviousSteeringVelocity = frame_boid.PreviousSteeringVelocity;
+    boid.SteeringVelocity = frame_boid.SteeringVelocity;
+
+    if ( request_direct_move )
+    {
+        RequestBoidMove( slot, ToVector( frame_boid.SteeringVelocity ) );
+    }
+}
+
+void UAFFlockingComponent::RequestBoidMove( const int32 slot, const FVector & velocity )
+{
+    auto * movement_component = BoidsMovementComponents[ slot ];
+
+    // The boid movement components only store the velocity, and move on their own tick or in MoveBoids
+    if ( auto * boid_movement_component = Cast< UAFBoidMovementComponent >( movement_component ) )
+    {
+        boid_movement_component->SetSteeringVelocity( velocity );
+        return;
+    }
+
+    auto * nav_movement_component = Cast< UNavMovementComponent >( movement_component );
+
+    // The simulated proxies of a replicated flock move with their velocity, and ignore the requested moves
+    if ( nav_movement_component == nullptr || movement_component->GetOwnerRole() == ROLE_SimulatedProxy )
+    {
+        movement_component->Velocity = velocity;
+    }
+    else
+    {
+        nav_movement_component->RequestDirectMove( velocity, true );
+    }
+}
+
+void UAFFlockingComponent::RequestInterpolatedMoves( const float ratio )
+{
+    AF_FLOCKING_SCOPE( STAT_FlockingComponentRequestDirectMove, ApplySteering );
+
+    for ( auto slot = 0; slot < BoidsMovementComponents.Num(); ++slot )
+    {
+        RequestBoidMove( slot, ToVector( AFFlockingCore::GetInterpolatedSteeringVelocity( BoidsData[ slot ], ratio ) ) );
+    }
+}
+
+void UAFFlockingComponent::UpdateLightweightBoids( const float delta_time )
+{
+    const auto boids_count = LightweightBoidsData.Num();
+
+    if ( boids_count == 0 )
+    {
+        return;
+    }
+
+    AF_FLOCKING_SCOPE( STAT_FlockingUpdateLightweightBoids, UpdateLightweightBoids );
+    AF_FLOCKING_COUNTER( STAT_FlockingLightweightBoids, LightweightBoids, boids_count );
+
+    AFFlockingCore::IntegrateBoids( LightweightBoidsData.GetData(), boids_count, delta_time, LightweightBoids.MaxAcceleration );
+
+    if ( LightweightBoidsInstances == nullptr )
+    {
+        return;
+    }
+
+    LightweightBoidsTransforms.SetNum( boids_count, false );
+
+    for ( auto index = 0; index < boids_count; ++index )
+    {
+        const auto & boid = LightweightBoidsData[ index ];
+        const auto velocity = ToVector( boid.Velocity );
+        auto & transform = LightweightBoidsTransforms[ index ];
+
+        transform.SetLocation( ToVector( boid.Center ) );
+        transform.SetScale3D( LightweightBoids.MeshScale );
+
+        // A boid which stopped keeps its last orientation
+        if ( !velocity.IsNearlyZero() )
+        {
+            transform.SetRotation( velocity.ToOrientationQuat() );
+        }
+    }
+
+    // A single render state update for all the instances
+    LightweightBoidsInstances->BatchUpdateInstancesTransforms( 0, LightweightBoidsTransforms, true, true, false );
+}
+
+void UAFFlockingComponent::MoveBoids( const float delta_time )
+{
+    if ( FlockMovedBoids.Num() == 0 )
+    {
+        return;
+    }
+
+    AF_FLOCKING_SCOPE( STAT_FlockingMoveBoids, MoveBoids );
+
+    auto sweeps_count = 0;
+
+    for ( auto * boid_movement_component : FlockMovedBoids )
+    {
+        sweeps_count += boid_movement_component->MoveBoid( delta_time ) ? 1 : 0;
+    }
+
+    AF_FLOCKING_COUNTER( STAT_FlockingBoidSweeps, BoidSweeps, sweeps_count );
+}
+
+void UAFFlockingComponent::UpdateSleep( const float simulated_duration )
+{
+    if ( !Sleep.bEnableSleep )
+    {
+        return;
+    }
+
+    if ( !IsSettled() )
+    {
+        WakeUp();
+        return;
+    }
+
+    SettledDuration += simulated_duration;
+
+    if ( !bIsSleeping && SettledDuration >= Sleep.SettleDuration )
+    {
+        FallAsleep();
+    }
+}
+
+bool UAFFlockingComponent::IsSettled() const
+{
+    const auto * owner = GetOwner();
+
+    if ( owner->GetVelocity().SizeSquared() > FMath::Square( Sleep.MaxOwnerVelocity ) )
+    {
+        return false;
+    }
+
+    // Same pursuit targets as the steering, indexed by slot like PursuitOffsetMultipliers
+    const auto owner_location = owner->GetActorLocation();
+    const auto pursuit_offset = owner->GetActorForwardVector() * FlockSettings.PursuitDistanceBehind;
+    const auto max_target_distance_squared = FMath::Square( Sleep.MaxTargetDistance );
+    const auto boids_count = BoidsMovementComponents.Num();
+
+    for ( auto slot = 0; slot < PursuitOffsetMultipliers.Num(); ++slot )
+    {
+        const auto boid_location = slot < boids_count ? BoidsMovementComponents[ slot ]->UpdatedComponent->GetComponentLocation() : ToVector( LightweightBoidsData[ slot - boids_count ].Center );
+
+        if ( FVector::DistSquared( boid_location, owner_location - pursuit_offset * PursuitOffsetMultipliers[ slot ] ) > max_target_distance_squared )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void UAFFlockingComponent::FallAsleep()
+{
+    // The tick which would apply the pending steering may not come
+    CompleteAsyncSteering();
+
+    bIsSleeping = true;
+    SleepTimer = 0.0f;
+    INC_DWORD_STAT( STAT_FlockingSleepingFlocks );
+
+    if ( auto * root_component = GetOwner()->GetRootComponent() )
+    {
+        OwnerTransformUpdatedDelegateHandle = root_component->TransformUpdated.AddUObject( this, &UAFFlockingComponent::OnOwnerTransformUpdated );
+    }
+
+    // The flocking subsystem skips the sleeping flocks by itself
+    if ( FlockingSubsystem.IsValid() )
+    {
+        return;
+    }
+
+    AwakeTickInterval = GetComponentTickInterval();
+
+    if ( Sleep.SleepTickInterval > 0.0f )
+    {
+        SetComponentTickInterval( Sleep.SleepTickInterval );
+    }
+    else
+    {
+        PrimaryComponentTick.SetTickFunctionEnable( false );
+    }
+}
+
+void UAFFlockingComponent::LeaveSleep()
+{
+    if ( !bIsSleeping )
+    {
+        return;
+    }
+
+    bIsSleeping = false;
+    DEC_DWORD_STAT( STAT_FlockingSleepingFlocks );
+
+    if ( auto * root_component = GetOwner()->GetRootComponent() )
+    {
+        root_component->TransformUpdated.Remove( OwnerTransformUpdatedDelegateHandle );
+    }
+
+    OwnerTransformUpdatedDelegateHandle.Reset();
+}
+
+bool UAFFlockingComponent::ShouldSimulate( const float simulated_duration )
+{
+    if ( !bIsSleeping )
+    {
+        return true;
+    }
+
+    if ( Sleep.SleepTickInterval <= 0.0f )
+    {
+        return false;
+    }
+
+    SleepTimer += simulated_duration;
+
+    if ( SleepTimer < Sleep.SleepTickInterval )
+    {
+        return false;
+    }
+
+    SleepTimer = 0.0f;
+    return true;
+}
+
+void UAFFlockingComponent::OnOwnerTransformUpdated( USceneComponent * /*updated_component*/, EUpdateTransformFlags /*update_transform_flags*/, ETeleportType /*teleport*/ )
+{
+    WakeUp();
+}
+
+namespace
+{
+    // Set in the user data of the obstacle traces of the lightweight boids, whose other bits are the index of the boid. The other traces hold the id of the boid handle
+    constexpr uint32 LightweightBoidTraceFlag = 1u << 31;
+}
+
+int32 UAFFlockingComponent::UpdateObstacleAvoidance( const float delta_time, const int32 max_traces_count )
+{
+    if ( FlockSettings.ObstacleAvoidanceWeight <= 0.0f )
+    {
+        return 0;
+    }
+
+    AF_FLOCKING_SCOPE( STAT_FlockingObstacleAvoidance, ObstacleAvoidance );
+
+    // The traces of a boid are far apart, so the obstacles they detected are remembered in between, with less and less effect
+    const auto decay = FMath::Pow( 0.5f, delta_time / FMath::Max( 0.01f, FlockSettings.ObstacleMemoryHalfLife ) );
+
+    for ( auto & boid : BoidsData )
+    {
+        boid.ObstacleAvoidance *= decay;
+    }
+
+    for ( auto & boid : LightweightBoidsData )
+    {
+        boid.ObstacleAvoidance *= decay;
+    }
+
+    auto * world = GetWorld();
+    const auto boids_count = BoidsMovementComponents.Num();
+    const auto flock_boids_count = boids_count + LightweightBoidsData.Num();
+    const auto visited_boids_count = FMath::Min3( max_traces_count, FlockSettings.MaxObstacleTracesPerTick, flock_boids_count );
+    auto traces_count = 0;
+
+    FCollisionQueryParams query_params( SCENE_QUERY_STAT( FlockingObstacleTrace ) );
+
+    for ( auto visited_boid_index = 0; visited_boid_index < visited_boids_count; ++visited_boid_index )
+    {
+        const auto boid_index = ObstacleTraceCursor % flock_boids_count;
+        ObstacleTraceCursor = boid_index + 1;
+
+        FVector start;
+        FVector velocity;
+        uint32 user_data;
+
+        query_params.ClearIgnoredActors();
+        query_params.AddIgnoredActor( GetOwner() );
+
+        if ( boid_index < boids_count )
+        {
+            const auto * movement_component = BoidsMovementComponents[ boid_index ];
+            start = movement_component->UpdatedComponent->GetComponentLocation();
+            velocity = movement_component->Velocity;
+            user_data = static_cast< uint32 >( BoidsHandles[ boid_index ].GetId() );
+            query_params.AddIgnoredActor( movement_component->GetOwner() );
+        }
+        else
+        {
+            const auto & boid = LightweightBoidsData[ boid_index - boids_count ];
+            start = ToVector( boid.Center );
+            velocity = ToVector( boid.Velocity );
+            user_data = static_cast< uint32 >( boid_index - boids_count ) | LightweightBoidTraceFlag;
+        }
+
+        const auto direction = velocity.GetSafeNormal();
+
+        // A boid which does not move does not run into anything
+        if ( direction.IsZero() )
+        {
+            continue;
+        }
+
+        world->AsyncLineTraceByChannel( EAsyncTraceType::Single, start, start + direction * FlockSettings.ObstacleTraceDistance, FlockSettings.ObstacleTraceChannel, query_params, FCollisionResponseParams::DefaultResponseParam, &ObstacleTraceDelegate, user_data );
+        ++traces_count;
+    }
+
+    AF_FLOCKING_COUNTER( STAT_FlockingObstacleTraces, ObstacleTraces, traces_count );
+    return traces_count;
+}
+
+void UAFFlockingComponent::OnObstacleTraceDone( const FTraceHandle & /*trace_handle*/, FTraceDatum & trace_datum )
+{
+    if ( trace_datum.OutHits.Num() == 0 || !trace_datum.OutHits[ 0 ].bBlockingHit )
+    {
+        return;
+    }
+
+    AFFlockingCore::FBoid * boid = nullptr;
+
+    // The boid may have been unregistered, or moved to another slot, since the trace started
+    if ( ( trace_datum.UserData & LightweightBoidTraceFlag ) != 0 )
+    {
+        const auto index = static_cast< int32 >( trace_datum.UserData & ~LightweightBoidTraceFlag );
+
+        if ( LightweightBoidsData.IsValidIndex( index ) )
+        {
+            boid = &LightweightBoidsData[ index ];
+        }
+    }
+    else if ( const auto * slot = BoidsSlots.Find( FAFBoidHandle( static_cast< int32 >( trace_datum.UserData ) ) ) )
+    {
+        boid = &BoidsData[ *slot ];
+    }
+
+    if ( boid == nullptr )
+    {
+        return;
+    }
+
+    // The closer the obstacle, the stronger the avoidance. The strongest of the obstacles remembered by the boid wins
+    const auto & hit = trace_datum.OutHits[ 0 ];
+    const auto obstacle_avoidance = ToCoreVector( hit.ImpactNormal * ( 1.0f - hit.Time ) );
+
+    if ( obstacle_avoidance.SizeSquared() > boid->ObstacleAvoidance.SizeSquared() )
+    {
+        boid->ObstacleAvoidance = obstacle_avoidance;
+    }
+}
+
+void UAFFlockingComponent::ResizeLightweightBoids()
+{
+    const auto previous_count = LightweightBoidsData.Num();
+    const auto new_count = LightweightBoids.Count;
+
+    if ( new_count == previous_count )
+    {
+        return;
+    }
+
+    if ( LightweightBoidsInstances == nullptr && LightweightBoids.Mesh != nullptr )
+    {
+        // The instances are written in world space, so the component stays at the origin instead of following the owner
+        LightweightBoidsInstances = NewObject< UInstancedStaticMeshComponent >( GetOwner() );
+        LightweightBoidsInstances->SetStaticMesh( LightweightBoids.Mesh );
+        LightweightBoidsInstances->SetMobility( EComponentMobility::Movable );
+        LightweightBoidsInstances->SetCollisionEnabled( ECollisionEnabled::NoCollision );
+        LightweightBoidsInstances->SetAbsolute( true, true, true );
+        LightweightBoidsInstances->RegisterComponent();
+    }
+
+    if ( new_count < previous_count )
+    {
+        LightweightBoidsData.SetNum( new_count, false );
+        LightweightBoidsTransforms.SetNum( FMath::Min( new_count, LightweightBoidsTransforms.Num() ), false );
+
+        if ( LightweightBoidsInstances != nullptr )
+        {
+            // Removing the last instances does not move the other ones
+            for ( auto instance_index = previous_count - 1; instance_index >= new_count; --instance_index )
+            {
+                LightweightBoidsInstances->RemoveInstance( instance_index );
+            }
+        }
+
+        BakeQueueCurve( BoidsMovementComponents.Num() + new_count );
+        return;
+    }
+
+    const auto owner_location = GetOwner()->GetActorLocation();
+
+    LightweightBoidsData.Reserve( new_count );
+
+    for ( auto index = previous_count; index < new_count; ++index )
+    {
+        AFFlockingCore::FBoid boid;
+        boid.Center = ToCoreVector( owner_location + FMath::VRand() * FMath::FRandRange( 0.0f, LightweightBoids.SpawnRadius ) );
+        boid.Velocity = AFFlockingCore::FVec3( 0.0f );
+        boid.MaxVelocity = LightweightBoids.MaxVelocity;
+        boid.SteeringVelocity = AFFlockingCore::FVec3( 0.0f );
+        boid.PreviousSteeringVelocity = AFFlockingCore::FVec3( 0.0f );
+        boid.FramesSinceUpdate = AFFlockingCore::NeverUpdated;
+        boid.ObstacleAvoidance = AFFlockingCore::FVec3( 0.0f );
+        LightweightBoidsData.Add( boid );
+
+        if ( LightweightBoidsInstances != nullptr )
+        {
+            LightweightBoidsInstances->AddInstanceWorldSpace( FTransform( FQuat::Identity, ToVector( boid.Center ), LightweightBoids.MeshScale ) );
+        }
+    }
+
+    BakeQueueCurve( BoidsMovementComponents.Num() + previous_count );
+}
+
+void UAFFlockingComponent::DispatchAsyncSteering()
+{
+    check( !bHasPendingAsyncFrame );
+
+    auto & frame = SimulationFrames[ AsyncFrameIndex ];
+    bHasPendingAsyncFrame = true;
+
+    AsyncSteeringTask = FFunctionGraphTask::CreateAndDispatchWhenReady(
+        [ &frame ]() {
+            frame.UpdateBoidsSteeringVelocity();
+        },
+        GET_STATID( STAT_FlockingComponentAsyncSteeringTask ),
+        nullptr,
+        ENamedThreads::AnyHiPriThreadHiPriTask );
+}
+
+void UAFFlockingComponent::WaitForAsyncSteering()
+{
+    if ( AsyncSteeringTask.IsValid() )
+    {
+        if ( !AsyncSteeringTask->IsComplete() )
+        {
+            AF_FLOCKING_SCOPE( STAT_FlockingComponentAsyncSteeringWait, AsyncSteeringWait );
+            FTaskGraphInterface::Get().WaitUntilTaskCompletes( AsyncSteeringTask, ENamedThreads::GameThread_Local );
+        }
+
+        AsyncSteeringTask = nullptr;
+    }
+}
+
+void UAFFlockingComponent::CompleteAsyncSteering()
+{
+    if ( !bHasPendingAsyncFrame )
+    {
+        return;
+    }
+
+    WaitForAsyncSteering();
+
+    bHasPendingAsyncFrame = false;
+    ApplySimulationFrame( SimulationFrames[ AsyncFrameIndex ] );
+}
+
+void UAFFlockingComponent::DiscardAsyncSteering()
+{
+    WaitForAsyncSteering();
+
+    bHasPendingAsyncFrame = false;
+    SimulationFrames[ AsyncFrameIndex ].BoidsHandles.Reset();
+    SimulationFrames[ AsyncFrameIndex ].BoidsOrder.Reset();
+}
+
+void UAFFlockingComponent::TrySetSwapBoidsPositionsTimer()
+{
+    if ( FlockSettings.bAllowSwapPositions )
+    {
+        const auto delay = FMath::FRandRange( FlockSettings.SwapPositionDelayInterval.Min, FlockSettings.SwapPositionDelayInterval.Max );
+        GetWorld()->GetTimerManager().SetTimer( SwapBoidPositionTimerHandle, this, &UAFFlockingComponent::RandomSwapBoidsPositions, delay );
+    }
+}
+
+void UAFFlockingComponent::RandomSwapBoidsPositions()
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL( FlockingSwapBoids, FlockingChannel );
+
+    const auto boids_count = BoidsMovementComponents.Num();
+    auto swaps_count = 0;
+
+    if ( boids_count >= 2 )
+    {
+        if ( SwapPositions.Num() != boids_count )
+        {
+            SwapPositions.SetNumUninitialized( boids_count );
+            SwapPositionsIndices.SetNumUninitialized( boids_count );
+
+            for ( auto position = 0; position < boids_count; ++position )
+            {
+                SwapPositions[ position ] = position;
+                SwapPositionsIndices[ position ] = position;
+            }
+        }
+
+        // Each position is swapped at most once, so a swap never undoes a previous one. It is a partial Fisher-Yates shuffle, whose first positions are the swapped ones
+        auto swapped_positions_count = 0;
+        const auto mark_swapped = [ this, &swapped_positions_count ]( const int32 position ) {
+            const auto index = SwapPositionsIndices[ position ];
+            const auto other_position = SwapPositions[ swapped_positions_count ];
+
+            Swap( SwapPositions[ index ], SwapPositions[ swapped_positions_count ] );
+            SwapPositionsIndices[ other_position ] = index;
+            SwapPositionsIndices[ position ] = swapped_positions_count;
+            ++swapped_positions_count;
+        };
+
+        // Each swap marks at least one position, so the first position of each swap is always picked among the remaining ones
+        auto boids_to_swap_count = FMath::Min( FMath::RandRange( FlockSettings.SwapPositionBoidCountInterval.Min, FlockSettings.SwapPositionBoidCountInterval.Max ), boids_count / 2 );
+
+        while ( boids_to_swap_count > 0 )
+        {
+            const auto first_position = SwapPositions[ FMath::RandRange( swapped_positions_count, boids_count - 1 ) ];
+            mark_swapped( first_position );
+
+            const auto second_position = QueueSlots.GetPositionAround( first_position, FlockSettings.SwapPositionDistanceInterval.Min, FlockSettings.SwapPositionDistanceInterval.Max, FMath::FRand() );
+
+            if ( second_position != INDEX_NONE && SwapPositionsIndices[ second_position ] >= swapped_positions_count )
+            {
+                mark_swapped( second_position );
+                SwapQueuePositions( first_position, second_position );
+                ++swaps_count;
+            }
+
+            --boids_to_swap_count;
+        }
+    }
+
+    AF_FLOCKING_COUNTER( STAT_FlockingSwaps, Swaps, swaps_count );
+
+    // The swapped boids have somewhere else to go
+    if ( swaps_count > 0 )
+    {
+        WakeUp();
+    }
+
+    TrySetSwapBoidsPositionsTimer();
+}
+
+void UAFFlockingComponent::SwapQueuePositions( const int32 first_position, const int32 second_position )
+{
+    Swap( PursuitOffsetMultipliers[ QueueSlots.GetBoidIndex( first_position ) ], PursuitOffsetMultipliers[ QueueSlots.GetBoidIndex( second_position ) ] );
+    QueueSlots.SwapPositions( first_position, second_position );
+}
+
+void UAFFlockingComponent::ReassignQueueByProximity()
+{
+    UnRegisterInvalidBoids();
+
+    const auto boids_count = BoidsMovementComponents.Num();
+    const auto distance_behind = FlockSettings.PursuitDistanceBehind;
+
+    // All the positions share the same target
+    if ( boids_count < 2 || FMath::IsNearlyZero( distance_behind ) )
+    {
+        return;
+    }
+
+    AF_FLOCKING_SCOPE( STAT_FlockingReassignQueue, ReassignQueue );
+
+    const auto * owner = GetOwner();
+    const auto owner_location = owner->GetActorLocation();
+    const auto owner_forward_vector = owner->GetActorForwardVector();
+
+    QueueBoidsTargets.resize( boids_count );
+    QueuePositionsMultipliers.resize( boids_count );
+
+    // The target of a position is PursuitDistanceBehind * its multiplier behind the owner, so the boids are compared with the multipliers
+    for ( auto slot = 0; slot < boids_count; ++slot )
+    {
+        const auto boid_location = BoidsMovementComponents[ slot ]->UpdatedComponent->GetComponentLocation();
+        QueueBoidsTargets[ slot ] = FVector::DotProduct( owner_location - boid_location, owner_forward_vector ) / distance_behind;
+    }
+
+    for ( auto position = 0; position < boids_count; ++position )
+    {
+        QueuePositionsMultipliers[ position ] = PursuitOffsetMultipliers[ QueueSlots.GetBoidIndex( position ) ];
+    }
+
+    QueueSlots.AssignPositionsByProximity( QueueBoidsTargets.data(), QueuePositionsMultipliers.data() );
+
+    for ( auto position = 0; position < boids_count; ++position )
+    {
+        PursuitOffsetMultipliers[ QueueSlots.GetBoidIndex( position ) ] = QueuePositionsMultipliers[ position ];
+    }
+
+    WakeUp();
+}
+
+int32 UAFFlockingComponent::RemoveBoidSlot( const int32 slot )
+{
+    const auto last_slot = BoidsMovementComponents.Num() - 1;
+
+    // The last boid takes the slot, so the other boids keep theirs, with their multiplier.
+    // The boids queued after the removed one move up one position, and the caller bakes their multipliers again
+    BoidsMovementComponents.RemoveAtSwap( slot, 1, false );
+    BoidsHandles.RemoveAtSwap( slot, 1, false );
+    BoidsData.RemoveAtSwap( slot, 1, false );
+    PursuitOffsetMultipliers[ slot ] = PursuitOffsetMultipliers[ last_slot ];
+
+    if ( BoidsHandles.IsValidIndex( slot ) )
+    {
+        BoidsSlots[ BoidsHandles[ slot ] ] = slot;
+    }
+
+    return QueueSlots.Remove( slot );
+}
+
+void UAFFlockingComponent::UnRegisterInvalidBoids()
+{
+    // Unregistering a boid moves the last one to its slot, which was already checked
+    for ( auto slot = BoidsMovementComponents.Num() - 1; slot >= 0; --slot )
+    {
+        const auto * movement_component = BoidsMovementComponents[ slot ];
+
+        if ( !IsValid( movement_component ) || movement_component->UpdatedComponent == nullptr )
+        {
+            UnRegisterBoid( BoidsHandles[ slot ] );
+        }
+    }
+}
+
+void UAFFlockingComponent::UpdateReplicatedFlock()
+{
+    AF_FLOCKING_SCOPE( STAT_FlockingReplication, Replication );
+
+    // Also called while the flock sleeps and does not tick
+    UnRegisterInvalidBoids();
+
+    const auto boids_count = BoidsMovementComponents.Num();
+    const auto lightweight_boids_count = LightweightBoidsData.Num();
+
+    // Only the changes of the array are sent, when boids are registered or unregistered
+    ReplicatedBoidsActors.SetNum( boids_count );
+
+    for ( auto slot = 0; slot < boids_count; ++slot )
+    {
+        ReplicatedBoidsActors[ slot ] = BoidsMovementComponents[ slot ]->GetOwner();
+    }
+
+    auto flock = MakeShared< AFFlockingCore::FQuantizedFlock >();
+    flock->Reset( ToCoreVector( GetOwner()->GetActorLocation() ), Replication.PositionPrecision, Replication.VelocityPrecision, boids_count + lightweight_boids_count );
+
+    for ( auto slot = 0; slot < boids_count; ++slot )
+    {
+        const auto * movement_component = BoidsMovementComponents[ slot ];
+        flock->SetBoid( slot, ToCoreVector( movement_component->UpdatedComponent->GetComponentLocation() ), ToCoreVector( movement_component->Velocity ) );
+    }
+
+    for ( auto index = 0; index < lightweight_boids_count; ++index )
+    {
+        const auto & boid = LightweightBoidsData[ index ];
+        flock->SetBoid( boids_count + index, boid.Center, boid.Velocity );
+    }
+
+    // The connections only send a state with a new sequence
+    if ( !ReplicatedFlock.Flock.IsValid() || *ReplicatedFlock.Flock != *flock || ReplicatedFlock.ActorBoidsCount != boids_count )
+    {
+        ReplicatedFlock.Flock = flock;
+        ReplicatedFlock.ActorBoidsCount = boids_count;
+        ++ReplicatedFlock.Sequence;
+    }
+
+    ReplicatedFlock.FullStateInterval = Replication.FullStateInterval;
+
+    // The bits are written after this function, for each connection, so the measure covers the previous updates
+    const auto time = GetWorld()->GetTimeSeconds();
+    const auto elapsed_time = time - ReplicationMeasureStartTime;
+
+    if ( elapsed_time >= 1.0f )
+    {
+        ReplicatedBytesPerSecond = static_cast< float >( ReplicatedFlock.SentBitsCount ) / 8.0f / elapsed_time;
+        ReplicatedFlock.SentBitsCount = 0;
+        ReplicationMeasureStartTime = time;
+    }
+}
+
+void UAFFlockingComponent::OnBoidMovementModeChanged( ACharacter * character, EMovementMode /*previous_movement_mode*/, uint8 /*previous_custom_mode*/ )
+{
+    if ( const auto * boid_handle = MovementComponentsHandles.Find( character->GetCharacterMovement() ) )
+    {
+        RefreshBoidMaxVelocity( *boid_handle );
+    }
+}
+
+namespace
+{
+    // The movement component the client registers for a replicated boid actor : its boid movement component if it has one, its character movement component otherwise
+    UMovementComponent * FindBoidMovementComponent( const AActor * actor )
+    {
+        if ( actor == nullptr )
+        {
+            return nullptr;
+        }
+
+        if ( auto * boid_movement_component = actor->FindComponentByClass< UAFBoidMovementComponent >() )
+        {
+            return boid_movement_component;
+        }
+
+        return actor->FindComponentByClass< UMovementComponent >();
+    }
+}
+
+void UAFFlockingComponent::OnRep_ReplicatedBoidsActors()
+{
+    TSet< const UMovementComponent * > replicated_movement_components;
+    replicated_movement_components.Reserve( ReplicatedBoidsActors.Num() );
+
+    // The actors which are not replicated to this client yet are null
+    for ( const auto * actor : ReplicatedBoidsActors )
+    {
+        if ( auto * movement_component = FindBoidMovementComponent( actor ) )
+        {
+            RegisterMovementComponent( movement_component );
+            replicated_movement_components.Add( movement_component );
+        }
+    }
+
+    // Unregistering moves the last boid to the slot, which was already checked
+    for ( auto slot = BoidsMovementComponents.Num() - 1; slot >= 0; --slot )
+    {
+        if ( !replicated_movement_components.Contains( BoidsMovementComponents[ slot ] ) )
+        {
+            UnRegisterMovementComponent( BoidsMovementComponents[ slot ] );
+        }
+    }
+}
+
+void UAFFlockingComponent::OnRep_ReplicatedFlock()
+{
+    const auto * flock = ReplicatedFlock.Flock.Get();
+
+    if ( flock == nullptr || ReplicatedFlock.Sequence == AppliedReplicatedSequence )
+    {
+        return;
+    }
+
+    AF_FLOCKING_SCOPE( STAT_FlockingReplication, Replication );
+
+    AppliedReplicatedSequence = ReplicatedFlock.Sequence;
+    WakeUp();
+
+    const auto boids_count = static_cast< int32 >( flock->Boids.size() );
+    const auto actor_boids_count = FMath::Min( ReplicatedFlock.ActorBoidsCount, boids_count );
+
+    for ( auto index = 0; index < FMath::Min( actor_boids_count, ReplicatedBoidsActors.Num() ); ++index )
+    {
+        auto * movement_component = FindBoidMovementComponent( ReplicatedBoidsActors[ index ] );
+
+        if ( movement_component == nullptr || movement_component->UpdatedComponent == nullptr )
+        {
+            continue;
+        }
+
+        auto * updated_component = movement_component->UpdatedComponent;
+        const auto old_location = updated_component->GetComponentLocation();
+        const auto rotation = updated_component->GetComponentQuat();
+        const auto new_location = ToVector( flock->GetBoidLocation( index ) );
+
+        updated_component->SetWorldLocation( new_location, false, nullptr, ETeleportType::TeleportPhysics );
+        movement_component->Velocity = ToVector( flock->GetBoidVelocity( index ) );
+
+        // Like the replicated movement of the characters : the mesh of the simulated proxies smoothly catches up with the corrected location. The other boids are teleported
+        if ( auto * character_movement_component = Cast< UCharacterMovementComponent >( movement_component ) )
+        {
+            character_movement_component->SmoothCorrection( old_location, rotation, new_location, rotation );
+        }
+    }
+
+    if ( LightweightBoids.Count != boids_count - actor_boids_count )
+    {
+        LightweightBoids.Count = boids_count - actor_boids_count;
+        ResizeLightweightBoids();
+    }
+
+    for ( auto index = 0; index < LightweightBoidsData.Num(); ++index )
+    {
+        auto & boid = LightweightBoidsData[ index ];
+        boid.Center = flock->GetBoidLocation( actor_boids_count + index );
+        boid.Velocity = flock->GetBoidVelocity( actor_boids_count + index );
+    }
 }
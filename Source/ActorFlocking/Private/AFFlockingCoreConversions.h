@@ -0,0 +1,15 @@
+#pragma once
+
+#include "FlockingCore/AFCoreMath.h"
+
+#include <CoreMinimal.h>
+
+FORCEINLINE AFFlockingCore::FVec3 ToCoreVector( const FVector & vector )
+{
+    return AFFlockingCore::FVec3( vector.X, vector.Y, vector.Z );
+}
+
+FORCEINLINE FVector ToVector( const AFFlockingCore::FVec3 & vector )
+{
+    return FVector( vector.X, vector.Y, vector.Z );
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <CoreMinimal.h>
+#include <ProfilingDebugging/CpuProfilerTrace.h>
+#include <ProfilingDebugging/CsvProfiler.h>
+#include <ProfilingDebugging/MiscTrace.h>
+#include <Stats/Stats.h>
+#include <Trace/Trace.h>
+
+DECLARE_STATS_GROUP( TEXT( "Flocking" ), STATGROUP_Flocking, STATCAT_Advanced );
+
+// Durations of the phases, and counters. Capture them with -csvCategories=Flocking,FlockingCounters
+CSV_DECLARE_CATEGORY_EXTERN( Flocking );
+CSV_DECLARE_CATEGORY_EXTERN( FlockingCounters );
+
+// Phases and per flock markers in Unreal Insights. Enable it with -trace=cpu,flocking
+UE_TRACE_CHANNEL_EXTERN( FlockingChannel );
+
+// Times a phase in the stats, in the CSV profiler and in the flocking trace channel
+#define AF_FLOCKING_SCOPE( Stat, Name )        \
+    SCOPE_CYCLE_COUNTER( Stat );               \
+    CSV_SCOPED_TIMING_STAT( Flocking, Name ); \
+    TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL( Flocking##Name, FlockingChannel )
+
+// Adds value to a counter of the stats and of the CSV profiler
+#define AF_FLOCKING_COUNTER( Stat, Name, Value ) \
+    INC_DWORD_STAT_BY( Stat, Value );            \
+    CSV_CUSTOM_STAT( FlockingCounters, Name, static_cast< int32 >( Value ), ECsvCustomStatOp::Accumulate )
+
+// Groups the work done for one flock in the flocking trace channel, under the name of the owner of the flock
+#define AF_FLOCK_TRACE_SCOPE( FlockingComponent ) TRACE_CPUPROFILER_EVENT_SCOPE_TEXT_ON_CHANNEL( *( FlockingComponent )->TraceName, FlockingChannel )
+
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Tick" ), STAT_FlockingComponentTick, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Subsystem Tick" ), STAT_FlockingSubsystemTick, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking RequestDirectMove" ), STAT_FlockingComponentRequestDirectMove, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Update Steering Velocity" ), STAT_FlockingComponentUpdateSteeringVelocity, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Gather" ), STAT_FlockingGather, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Schedule" ), STAT_FlockingSchedule, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Build Spatial Hash" ), STAT_FlockingComponentBuildSpatialHash, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Compute Steering" ), STAT_FlockingComputeSteering, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Async Steering Task" ), STAT_FlockingComponentAsyncSteeringTask, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Async Steering Wait" ), STAT_FlockingComponentAsyncSteeringWait, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Draw Debug" ), STAT_FlockingComponentDrawDebug, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Update Lightweight Boids" ), STAT_FlockingUpdateLightweightBoids, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Sort Boids" ), STAT_FlockingSortBoids, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Reassign Queue" ), STAT_FlockingReassignQueue, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Record Frame" ), STAT_FlockingRecordFrame, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Replication" ), STAT_FlockingReplication, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Obstacle Avoidance" ), STAT_FlockingObstacleAvoidance, STATGROUP_Flocking, );
+DECLARE_CYCLE_STAT_EXTERN( TEXT( "Flocking Move Boids" ), STAT_FlockingMoveBoids, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking Batched Flocks" ), STAT_FlockingBatchedFlocks, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking Boids" ), STAT_FlockingBoids, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking Lightweight Boids" ), STAT_FlockingLightweightBoids, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking Neighbor Candidates" ), STAT_FlockingNeighborCandidates, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking Pair Tests" ), STAT_FlockingPairTests, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking Neighbors Found" ), STAT_FlockingNeighbors, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking Neighbor Lists Rebuilds" ), STAT_FlockingNeighborListsRebuilds, STATGROUP_Flocking, );
+// Not a counter : it keeps the value of the last rebuild
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN( TEXT( "Flocking Neighbor Lists Average Length" ), STAT_FlockingNeighborListsAverageLength, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking LOD0 Boids" ), STAT_FlockingLOD0Boids, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking LOD1 Boids" ), STAT_FlockingLOD1Boids, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking LOD2 Boids" ), STAT_FlockingLOD2Boids, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking Updated Boids" ), STAT_FlockingUpdatedBoids, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking Deferred Boids" ), STAT_FlockingDeferredBoids, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking Replicated Bytes" ), STAT_FlockingReplicatedBytes, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking Swaps" ), STAT_FlockingSwaps, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking Obstacle Traces" ), STAT_FlockingObstacleTraces, STATGROUP_Flocking, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN( TEXT( "Flocking Boid Sweeps" ), STAT_FlockingBoidSweeps, STATGROUP_Flocking, );
+// Not a counter : the flocks are counted when they fall asleep, and until they wake up
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN( TEXT( "Flocking Sleeping Flocks" ), STAT_FlockingSleepingFlocks, STATGROUP_Flocking, );
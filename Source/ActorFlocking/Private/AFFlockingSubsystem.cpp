@@ -0,0 +1,192 @@
+#include "AFFlockingSubsystem.h"
+
+#include "AFFlockingStats.h"
+
+#include <Engine/World.h>
+
+FAFFlockingSubsystemTickFunction::FAFFlockingSubsystemTickFunction() :
+    Target( nullptr )
+{
+}
+
+void FAFFlockingSubsystemTickFunction::ExecuteTick( const float delta_time, ELevelTick /*tick_type*/, ENamedThreads::Type /*current_thread*/, const FGraphEventRef & /*completion_graph_event*/ )
+{
+    if ( Target != nullptr && !Target->IsPendingKill() )
+    {
+        Target->Tick( delta_time );
+    }
+}
+
+FString FAFFlockingSubsystemTickFunction::DiagnosticMessage()
+{
+    return Target != nullptr
+               ? Target->GetFullName() + TEXT( "[Tick]" )
+               : TEXT( "<NULL>[Tick]" );
+}
+
+UAFFlockingSubsystem::UAFFlockingSubsystem()
+{
+    bUseVectorizedSteering = true;
+    bUseParallelSteering = false;
+    ParallelSteeringMinBatchSize = 64;
+    NeighborListSkinDistance = 0.0f;
+    BoidsSortInterval = 0;
+    FixedTimestepRate = 0.0f;
+    MaxSubstepsCount = 4;
+    bUseCrossFlockSeparation = false;
+    UpdateBudgetMicroseconds = 0.0f;
+    MaxObstacleTracesPerTick = 128;
+    FirstObstacleTracesFlockIndex = 0;
+    TickFunction.bCanEverTick = true;
+    TickFunction.bStartWithTickEnabled = true;
+    TickFunction.TickGroup = TG_PrePhysics;
+}
+
+void UAFFlockingSubsystem::Deinitialize()
+{
+    if ( TickFunction.IsTickFunctionRegistered() )
+    {
+        TickFunction.UnRegisterTickFunction();
+    }
+
+    FlockingComponents.Reset();
+    SimulatedFlockingComponents.Reset();
+
+    Super::Deinitialize();
+}
+
+void UAFFlockingSubsystem::RegisterFlock( UAFFlockingComponent * flocking_component )
+{
+    if ( flocking_component == nullptr )
+    {
+        return;
+    }
+
+    FlockingComponents.AddUnique( flocking_component );
+
+    // The world is only guaranteed to have its persistent level once the flocks begin to play
+    if ( !TickFunction.IsTickFunctionRegistered() )
+    {
+        TickFunction.Target = this;
+        TickFunction.RegisterTickFunction( GetWorld()->PersistentLevel );
+    }
+}
+
+void UAFFlockingSubsystem::UnRegisterFlock( UAFFlockingComponent * flocking_component )
+{
+    FlockingComponents.Remove( flocking_component );
+}
+
+bool UAFFlockingSubsystem::SaveRecording( const FString & file_name ) const
+{
+    return Recorder.Save( file_name );
+}
+
+void UAFFlockingSubsystem::Tick( const float delta_time )
+{
+    SCOPED_NAMED_EVENT( UAFFlockingSubsystem_Tick, FColor::Yellow );
+    AF_FLOCKING_SCOPE( STAT_FlockingSubsystemTick, SubsystemTick );
+
+    // Components destroyed without ending play are nulled by the garbage collector
+    FlockingComponents.Remove( nullptr );
+
+    const auto use_fixed_timestep = FixedTimestepRate > 0.0f;
+    const auto step_duration = use_fixed_timestep ? 1.0f / FixedTimestepRate : delta_time;
+    const auto steps_count = use_fixed_timestep ? FixedTimestep.Advance( delta_time, step_duration, MaxSubstepsCount ) : 1;
+    const auto simulated_duration = steps_count * step_duration;
+
+    if ( !use_fixed_timestep )
+    {
+        FixedTimestep.Reset();
+    }
+
+    // The sleeping flocks are left out, except for their periodic update, which only counts the time of the steering steps
+    SimulatedFlockingComponents.Reset();
+
+    for ( auto * flocking_component : FlockingComponents )
+    {
+        if ( flocking_component->ShouldSimulate( simulated_duration ) )
+        {
+            SimulatedFlockingComponents.Add( flocking_component );
+        }
+    }
+
+    if ( steps_count > 0 )
+    {
+        SimulateFlocks( steps_count, step_duration );
+    }
+
+    for ( auto * flocking_component : SimulatedFlockingComponents )
+    {
+        AF_FLOCK_TRACE_SCOPE( flocking_component );
+
+        if ( use_fixed_timestep )
+        {
+            flocking_component->RequestInterpolatedMoves( FixedTimestep.GetInterpolationRatio( step_duration ) );
+        }
+
+        flocking_component->UpdateLightweightBoids( delta_time );
+        flocking_component->MoveBoids( delta_time );
+
+        // The flock only settles or moves away from its targets through the steering steps
+        if ( steps_count > 0 )
+        {
+            flocking_component->UpdateSleep( simulated_duration );
+        }
+    }
+
+    AF_FLOCKING_COUNTER( STAT_FlockingBatchedFlocks, BatchedFlocks, FlockingComponents.Num() );
+}
+
+void UAFFlockingSubsystem::SimulateFlocks( const int32 steps_count, const float step_duration )
+{
+    auto & frame = SimulationFrame;
+    const auto delta_time = steps_count * step_duration;
+
+    frame.Performance.bUseVectorizedSteering = bUseVectorizedSteering;
+    frame.Performance.bUseParallelSteering = bUseParallelSteering;
+    frame.Performance.ParallelSteeringMinBatchSize = ParallelSteeringMinBatchSize;
+    frame.Performance.NeighborListSkinDistance = NeighborListSkinDistance;
+    frame.Performance.FixedTimestepRate = FixedTimestepRate;
+    frame.bSeparateFromOtherFlocks = bUseCrossFlockSeparation;
+    frame.bStoreDebugForces = false;
+    frame.StepsCount = steps_count;
+    frame.StepDuration = step_duration;
+    frame.State.Reset();
+
+    const auto flocks_count = SimulatedFlockingComponents.Num();
+    auto remaining_obstacle_traces_count = MaxObstacleTracesPerTick;
+    FirstObstacleTracesFlockIndex = flocks_count > 0 ? ( FirstObstacleTracesFlockIndex + 1 ) % flocks_count : 0;
+
+    for ( auto index = 0; index < flocks_count; ++index )
+    {
+        auto * flocking_component = SimulatedFlockingComponents[ ( FirstObstacleTracesFlockIndex + index ) % flocks_count ];
+        flocking_component->UnRegisterInvalidBoids();
+        remaining_obstacle_traces_count -= flocking_component->UpdateObstacleAvoidance( delta_time, remaining_obstacle_traces_count );
+    }
+
+    for ( auto * flocking_component : SimulatedFlockingComponents )
+    {
+        flocking_component->UpdateSettingsTransition( delta_time );
+        flocking_component->UpdateBoidsOrder( BoidsSortInterval );
+        flocking_component->GatherFlock( frame.State );
+        frame.bStoreDebugForces |= flocking_component->Debug.IsEnabled();
+    }
+
+    frame.ScheduleBoidsUpdate( UpdateScheduler, GetWorld(), UpdateBudgetMicroseconds );
+
+    for ( auto flock_index = 0; flock_index < SimulatedFlockingComponents.Num(); ++flock_index )
+    {
+        SimulatedFlockingComponents[ flock_index ]->StoreBoidsUpdateFrames( frame.State, flock_index );
+    }
+
+    Recorder.Record( frame, Recording );
+    frame.UpdateBoidsSteeringVelocity();
+    UpdateScheduler.ReportUpdateDuration( static_cast< int32 >( frame.State.BoidsToUpdate.size() ), frame.BuildNeighborSearchMicroseconds, frame.ComputeSteeringMicroseconds );
+    Recorder.SaveOnSpike( frame, Recording, TEXT( "FlockingSubsystem" ) );
+
+    for ( auto flock_index = 0; flock_index < SimulatedFlockingComponents.Num(); ++flock_index )
+    {
+        SimulatedFlockingComponents[ flock_index ]->ApplyFlockSteering( frame, flock_index );
+    }
+}
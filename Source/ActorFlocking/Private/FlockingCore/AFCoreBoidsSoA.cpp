@@ -0,0 +1,166 @@
+#include "FlockingCore/AFCoreBoidsSoA.h"
+
+#include "FlockingCore/AFCoreSimd.h"
+#include "FlockingCore/AFCoreSpatialHashGrid.h"
+
+#include <cmath>
+
+namespace AFFlockingCore
+{
+    void FBoidsSoA::Build( const FFlockState & state, const FSpatialHashGrid & spatial_hash )
+    {
+        const auto & boids = state.Boids;
+        const auto boids_count = static_cast< int32_t >( boids.size() );
+
+        // The kernel can start a load on the last boid of the array, so leave a full SIMD register of padding after the aligned size
+        const auto padded_count = ( ( boids_count + SimdWidth - 1 ) / SimdWidth ) * SimdWidth + SimdWidth;
+
+        for ( auto * stream : { &CenterX, &CenterY, &CenterZ, &VelocityX, &VelocityY, &VelocityZ, &FlockIndices } )
+        {
+            stream->assign( padded_count, 0.0f );
+        }
+
+        SortedPositions.resize( boids_count );
+
+        const auto & sorted_boid_indices = spatial_hash.GetSortedBoidIndices();
+
+        for ( auto sorted_index = 0; sorted_index < static_cast< int32_t >( sorted_boid_indices.size() ); ++sorted_index )
+        {
+            const auto boid_index = sorted_boid_indices[ sorted_index ];
+            const auto & boid = boids[ boid_index ];
+
+            CenterX[ sorted_index ] = boid.Center.X;
+            CenterY[ sorted_index ] = boid.Center.Y;
+            CenterZ[ sorted_index ] = boid.Center.Z;
+            VelocityX[ sorted_index ] = boid.Velocity.X;
+            VelocityY[ sorted_index ] = boid.Velocity.Y;
+            VelocityZ[ sorted_index ] = boid.Velocity.Z;
+            FlockIndices[ sorted_index ] = static_cast< float >( state.BoidFlockIndices[ boid_index ] );
+            SortedPositions[ boid_index ] = sorted_index;
+        }
+    }
+
+    template < uint32_t _FEATURES_ >
+    int32_t FBoidsSoA::AccumulateNeighborForces( FNeighborForces & forces, int64_t & neighbor_candidates_count, const int32_t boid_index, const FSpatialHashGrid & spatial_hash, const FNeighborRadii & radii, const bool separate_from_other_flocks ) const
+    {
+        using namespace Simd;
+
+        const auto sorted_index = SortedPositions[ boid_index ];
+        const FVec3 center( CenterX[ sorted_index ], CenterY[ sorted_index ], CenterZ[ sorted_index ] );
+
+        const auto center_x = Set1( center.X );
+        const auto center_y = Set1( center.Y );
+        const auto center_z = Set1( center.Z );
+        const auto alignment_radius_squared = Set1( Square( radii.AlignmentRadius ) );
+        const auto cohesion_radius_squared = Set1( Square( radii.CohesionRadius ) );
+        const auto separation_radius_squared = Set1( Square( radii.SeparationRadius ) );
+        const auto inverse_separation_radius = Set1( radii.SeparationRadius > 0.0f ? 1.0f / radii.SeparationRadius : 0.0f );
+        const auto self_lane_index = Set1( static_cast< float >( sorted_index ) );
+        const auto self_flock_index = Set1( FlockIndices[ sorted_index ] );
+        const auto lane_offsets = Set( 0.0f, 1.0f, 2.0f, 3.0f );
+        const auto zero = Zero();
+        const auto one = Set1( 1.0f );
+
+        auto alignment_x = zero, alignment_y = zero, alignment_z = zero, alignment_count = zero;
+        auto cohesion_x = zero, cohesion_y = zero, cohesion_z = zero, cohesion_count = zero;
+        auto separation_x = zero, separation_y = zero, separation_z = zero, separation_count = zero;
+        auto pair_tests_count = 0;
+
+        spatial_hash.ForEachBucketAround( center, [ & ]( const int32_t first, const int32_t last ) {
+            const auto last_lane_index = Set1( static_cast< float >( last ) );
+            neighbor_candidates_count += last - first;
+
+            for ( auto index = first; index < last; index += SimdWidth )
+            {
+                const auto other_x = Load( &CenterX[ index ] );
+                const auto other_y = Load( &CenterY[ index ] );
+                const auto other_z = Load( &CenterZ[ index ] );
+
+                const auto to_other_x = Subtract( other_x, center_x );
+                const auto to_other_y = Subtract( other_y, center_y );
+                const auto to_other_z = Subtract( other_z, center_z );
+
+                const auto distance_squared = MultiplyAdd( to_other_z, to_other_z, MultiplyAdd( to_other_y, to_other_y, Multiply( to_other_x, to_other_x ) ) );
+
+                // Lanes past the end of the bucket and the lane of the boid itself must not contribute
+                const auto lane_index = Add( Set1( static_cast< float >( index ) ), lane_offsets );
+                const auto valid_lanes = And( CompareLess( lane_index, last_lane_index ), CompareNotEqual( lane_index, self_lane_index ) );
+                const auto same_flock_lanes = And( valid_lanes, CompareEqual( Load( &FlockIndices[ index ] ), self_flock_index ) );
+
+                const auto alignment_lanes = And( same_flock_lanes, CompareLess( distance_squared, alignment_radius_squared ) );
+                const auto cohesion_lanes = And( same_flock_lanes, CompareLess( distance_squared, cohesion_radius_squared ) );
+                const auto separation_lanes = And( separate_from_other_flocks ? valid_lanes : same_flock_lanes, CompareLess( distance_squared, separation_radius_squared ) );
+
+                if ( ( _FEATURES_ & ESteeringFeatures::Alignment ) != 0 && AnyLane( alignment_lanes ) )
+                {
+                    alignment_x = Add( alignment_x, And( alignment_lanes, Load( &VelocityX[ index ] ) ) );
+                    alignment_y = Add( alignment_y, And( alignment_lanes, Load( &VelocityY[ index ] ) ) );
+                    alignment_z = Add( alignment_z, And( alignment_lanes, Load( &VelocityZ[ index ] ) ) );
+                    alignment_count = Add( alignment_count, And( alignment_lanes, one ) );
+                }
+
+                if ( ( _FEATURES_ & ESteeringFeatures::Cohesion ) != 0 && AnyLane( cohesion_lanes ) )
+                {
+                    cohesion_x = Add( cohesion_x, And( cohesion_lanes, other_x ) );
+                    cohesion_y = Add( cohesion_y, And( cohesion_lanes, other_y ) );
+                    cohesion_z = Add( cohesion_z, And( cohesion_lanes, other_z ) );
+                    cohesion_count = Add( cohesion_count, And( cohesion_lanes, one ) );
+                }
+
+                if ( ( _FEATURES_ & ESteeringFeatures::Separation ) != 0 && AnyLane( separation_lanes ) )
+                {
+                    const auto distance = Sqrt( distance_squared );
+                    const auto falloff = Subtract( one, Min( Multiply( distance, inverse_separation_radius ), one ) );
+                    const auto weight = And( separation_lanes, falloff );
+
+                    separation_x = MultiplyAdd( to_other_x, weight, separation_x );
+                    separation_y = MultiplyAdd( to_other_y, weight, separation_y );
+                    separation_z = MultiplyAdd( to_other_z, weight, separation_z );
+                    separation_count = Add( separation_count, And( separation_lanes, one ) );
+                }
+
+                pair_tests_count += SimdWidth;
+            }
+        } );
+
+        if ( ( _FEATURES_ & ESteeringFeatures::Alignment ) != 0 )
+        {
+            forces.AlignmentForce += FVec3( HorizontalSum( alignment_x ), HorizontalSum( alignment_y ), HorizontalSum( alignment_z ) );
+            forces.AlignmentBoidsCount += static_cast< int32_t >( std::lround( HorizontalSum( alignment_count ) ) );
+        }
+
+        if ( ( _FEATURES_ & ESteeringFeatures::Cohesion ) != 0 )
+        {
+            forces.CohesionForce += FVec3( HorizontalSum( cohesion_x ), HorizontalSum( cohesion_y ), HorizontalSum( cohesion_z ) );
+            forces.CohesionBoidsCount += static_cast< int32_t >( std::lround( HorizontalSum( cohesion_count ) ) );
+        }
+
+        if ( ( _FEATURES_ & ESteeringFeatures::Separation ) != 0 )
+        {
+            forces.SeparationForce += FVec3( HorizontalSum( separation_x ), HorizontalSum( separation_y ), HorizontalSum( separation_z ) );
+            forces.SeparationBoidsCount += static_cast< int32_t >( std::lround( HorizontalSum( separation_count ) ) );
+        }
+
+        return pair_tests_count;
+    }
+
+#define AF_CORE_INSTANTIATE_SOA_NEIGHBOR_FORCES( _FEATURES_ ) \
+    template int32_t FBoidsSoA::AccumulateNeighborForces< _FEATURES_ >( FNeighborForces &, int64_t &, int32_t, const FSpatialHashGrid &, const FNeighborRadii &, bool ) const;
+
+    AF_CORE_INSTANTIATE_SOA_NEIGHBOR_FORCES( 0u )
+    AF_CORE_INSTANTIATE_SOA_NEIGHBOR_FORCES( 1u )
+    AF_CORE_INSTANTIATE_SOA_NEIGHBOR_FORCES( 2u )
+    AF_CORE_INSTANTIATE_SOA_NEIGHBOR_FORCES( 3u )
+    AF_CORE_INSTANTIATE_SOA_NEIGHBOR_FORCES( 4u )
+    AF_CORE_INSTANTIATE_SOA_NEIGHBOR_FORCES( 5u )
+    AF_CORE_INSTANTIATE_SOA_NEIGHBOR_FORCES( 6u )
+    AF_CORE_INSTANTIATE_SOA_NEIGHBOR_FORCES( 7u )
+
+#undef AF_CORE_INSTANTIATE_SOA_NEIGHBOR_FORCES
+
+    size_t FBoidsSoA::GetAllocatedSize() const
+    {
+        return ( CenterX.capacity() + CenterY.capacity() + CenterZ.capacity() + VelocityX.capacity() + VelocityY.capacity() + VelocityZ.capacity() + FlockIndices.capacity() ) * sizeof( float )
+               + SortedPositions.capacity() * sizeof( int32_t );
+    }
+}
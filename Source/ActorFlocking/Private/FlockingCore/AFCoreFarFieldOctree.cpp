@@ -0,0 +1,282 @@
+#include "FlockingCore/AFCoreFarFieldOctree.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace AFFlockingCore
+{
+    namespace
+    {
+        constexpr int32_t FarFieldLeafMaxBoidsCount = 8;
+        // Stops the subdivision of boids sharing the same location
+        constexpr int32_t FarFieldMaxDepth = 20;
+        // Each level pushes at most 8 children, and only the last pushed node gets subdivided before the others are popped
+        constexpr int32_t FarFieldStackSize = 8 * FarFieldMaxDepth + 1;
+
+        enum class ESphereOverlap
+        {
+            Outside,
+            Inside,
+            Straddle
+        };
+
+        // Squared distances from a location to the closest and to the farthest points of a box
+        struct FBoxDistances
+        {
+            float ClosestSquared;
+            float FarthestSquared;
+        };
+
+        void AddAxisDistances( FBoxDistances & distances, const float minimum, const float maximum )
+        {
+            const auto minimum_squared = Square( minimum );
+            const auto maximum_squared = Square( maximum );
+
+            if ( minimum > 0.0f )
+            {
+                distances.ClosestSquared += minimum_squared;
+            }
+            else if ( maximum < 0.0f )
+            {
+                distances.ClosestSquared += maximum_squared;
+            }
+
+            distances.FarthestSquared += std::max( minimum_squared, maximum_squared );
+        }
+
+        FBoxDistances GetBoxDistances( const FVec3 & minimum, const FVec3 & maximum, const FVec3 & location )
+        {
+            FBoxDistances distances { 0.0f, 0.0f };
+            AddAxisDistances( distances, minimum.X - location.X, maximum.X - location.X );
+            AddAxisDistances( distances, minimum.Y - location.Y, maximum.Y - location.Y );
+            AddAxisDistances( distances, minimum.Z - location.Z, maximum.Z - location.Z );
+            return distances;
+        }
+
+        ESphereOverlap GetSphereOverlap( const FBoxDistances & distances, const float radius_squared )
+        {
+            // Same strict comparison as the kernels : a boid contributes when its distance is smaller than the radius
+            if ( distances.ClosestSquared >= radius_squared )
+            {
+                return ESphereOverlap::Outside;
+            }
+
+            return distances.FarthestSquared < radius_squared ? ESphereOverlap::Inside : ESphereOverlap::Straddle;
+        }
+    }
+
+    FFarFieldOctree::FFarFieldOctree() :
+        FirstBoidIndex( 0 )
+    {
+    }
+
+    void FFarFieldOctree::Build( const FFlockState & state, const int32_t first_boid_index, const int32_t boids_count )
+    {
+        FirstBoidIndex = first_boid_index;
+        Nodes.clear();
+        SortedBoidIndices.resize( boids_count );
+        SortedPositions.resize( boids_count );
+        OctantScratch.resize( boids_count );
+        PartitionScratch.resize( boids_count );
+
+        for ( auto index = 0; index < boids_count; ++index )
+        {
+            SortedBoidIndices[ index ] = first_boid_index + index;
+        }
+
+        if ( boids_count == 0 )
+        {
+            return;
+        }
+
+        Nodes.emplace_back();
+        BuildNode( state, 0, 0, boids_count, 0 );
+
+        SortedCenters.resize( boids_count );
+        SortedVelocities.resize( boids_count );
+
+        for ( auto sorted_index = 0; sorted_index < boids_count; ++sorted_index )
+        {
+            const auto boid_index = SortedBoidIndices[ sorted_index ];
+            SortedPositions[ boid_index - first_boid_index ] = sorted_index;
+            SortedCenters[ sorted_index ] = state.Boids[ boid_index ].Center;
+            SortedVelocities[ sorted_index ] = state.Boids[ boid_index ].Velocity;
+        }
+    }
+
+    void FFarFieldOctree::BuildNode( const FFlockState & state, const int32_t node_index, const int32_t first, const int32_t last, const int32_t depth )
+    {
+        const auto & boids = state.Boids;
+        const auto & first_boid = boids[ SortedBoidIndices[ first ] ];
+        auto minimum = first_boid.Center;
+        auto maximum = first_boid.Center;
+        FVec3 centers_sum( 0.0f );
+        FVec3 velocities_sum( 0.0f );
+
+        for ( auto sorted_index = first; sorted_index < last; ++sorted_index )
+        {
+            const auto & boid = boids[ SortedBoidIndices[ sorted_index ] ];
+            minimum = FVec3( std::min( minimum.X, boid.Center.X ), std::min( minimum.Y, boid.Center.Y ), std::min( minimum.Z, boid.Center.Z ) );
+            maximum = FVec3( std::max( maximum.X, boid.Center.X ), std::max( maximum.Y, boid.Center.Y ), std::max( maximum.Z, boid.Center.Z ) );
+            centers_sum += boid.Center;
+            velocities_sum += boid.Velocity;
+        }
+
+        {
+            auto & node = Nodes[ node_index ];
+            node.Minimum = minimum;
+            node.Maximum = maximum;
+            node.CentersSum = centers_sum;
+            node.VelocitiesSum = velocities_sum;
+            node.First = first;
+            node.Last = last;
+            node.FirstChild = 0;
+            node.ChildrenCount = 0;
+        }
+
+        if ( last - first <= FarFieldLeafMaxBoidsCount || depth >= FarFieldMaxDepth )
+        {
+            return;
+        }
+
+        // Stable counting sort of the boids by octant around the middle of the bounds
+        const auto middle = ( minimum + maximum ) * 0.5f;
+        int32_t octant_starts[ 9 ] = {};
+
+        for ( auto sorted_index = first; sorted_index < last; ++sorted_index )
+        {
+            const auto & center = boids[ SortedBoidIndices[ sorted_index ] ].Center;
+            const auto octant = ( center.X > middle.X ? 1 : 0 ) | ( center.Y > middle.Y ? 2 : 0 ) | ( center.Z > middle.Z ? 4 : 0 );
+            OctantScratch[ sorted_index ] = octant;
+            ++octant_starts[ octant + 1 ];
+        }
+
+        for ( auto octant = 1; octant < 9; ++octant )
+        {
+            octant_starts[ octant ] += octant_starts[ octant - 1 ];
+        }
+
+        // The range of the node is copied to the same range of the scratch, so the children never allocate
+        std::copy( SortedBoidIndices.begin() + first, SortedBoidIndices.begin() + last, PartitionScratch.begin() + first );
+        int32_t octant_ends[ 8 ];
+        std::copy( octant_starts, octant_starts + 8, octant_ends );
+
+        for ( auto sorted_index = first; sorted_index < last; ++sorted_index )
+        {
+            SortedBoidIndices[ first + octant_ends[ OctantScratch[ sorted_index ] ]++ ] = PartitionScratch[ sorted_index ];
+        }
+
+        auto children_count = 0;
+
+        for ( auto octant = 0; octant < 8; ++octant )
+        {
+            children_count += octant_starts[ octant + 1 ] > octant_starts[ octant ] ? 1 : 0;
+        }
+
+        // The children are allocated before being built, so they are contiguous
+        const auto first_child = static_cast< int32_t >( Nodes.size() );
+        Nodes.resize( Nodes.size() + children_count );
+        Nodes[ node_index ].FirstChild = first_child;
+        Nodes[ node_index ].ChildrenCount = children_count;
+
+        auto child_index = first_child;
+
+        for ( auto octant = 0; octant < 8; ++octant )
+        {
+            if ( octant_starts[ octant + 1 ] > octant_starts[ octant ] )
+            {
+                BuildNode( state, child_index++, first + octant_starts[ octant ], first + octant_starts[ octant + 1 ], depth + 1 );
+            }
+        }
+    }
+
+    int32_t FFarFieldOctree::AccumulateAlignmentAndCohesion( FNeighborForces & forces, const int32_t boid_index, const FFlockState & state, const FNeighborRadii & radii ) const
+    {
+        if ( Nodes.empty() )
+        {
+            return 0;
+        }
+
+        const auto & boid = state.Boids[ boid_index ];
+        const auto location = boid.Center;
+        const auto self_position = SortedPositions[ boid_index - FirstBoidIndex ];
+        const auto alignment_radius_squared = Square( radii.AlignmentRadius );
+        const auto cohesion_radius_squared = Square( radii.CohesionRadius );
+
+        auto tests_count = 0;
+
+        // Adds a whole node to the alignment or cohesion, without the boid of the query
+        const auto add_node = [ & ]( const FNode & node, const bool add_alignment, const bool add_cohesion ) {
+            const auto count = node.Last - node.First;
+            const auto contains_self = self_position >= node.First && self_position < node.Last;
+
+            if ( add_alignment )
+            {
+                forces.AlignmentForce += contains_self ? node.VelocitiesSum - boid.Velocity : node.VelocitiesSum;
+                forces.AlignmentBoidsCount += contains_self ? count - 1 : count;
+            }
+
+            if ( add_cohesion )
+            {
+                forces.CohesionForce += contains_self ? node.CentersSum - boid.Center : node.CentersSum;
+                forces.CohesionBoidsCount += contains_self ? count - 1 : count;
+            }
+        };
+
+        int32_t stack[ FarFieldStackSize ];
+        auto stack_size = 0;
+        stack[ stack_size++ ] = 0;
+
+        while ( stack_size > 0 )
+        {
+            const auto & node = Nodes[ stack[ --stack_size ] ];
+            const auto distances = GetBoxDistances( node.Minimum, node.Maximum, location );
+            const auto alignment_overlap = GetSphereOverlap( distances, alignment_radius_squared );
+            const auto cohesion_overlap = GetSphereOverlap( distances, cohesion_radius_squared );
+
+            ++tests_count;
+
+            if ( alignment_overlap != ESphereOverlap::Straddle && cohesion_overlap != ESphereOverlap::Straddle )
+            {
+                add_node( node, alignment_overlap == ESphereOverlap::Inside, cohesion_overlap == ESphereOverlap::Inside );
+                continue;
+            }
+
+            if ( node.ChildrenCount == 0 )
+            {
+                // Without branches, as whether each boid is within a radius is unpredictable. No boid of a leaf outside a radius is closer than the radius
+                const auto leaf_alignment_radius_squared = alignment_overlap == ESphereOverlap::Outside ? 0.0f : alignment_radius_squared;
+                const auto leaf_cohesion_radius_squared = cohesion_overlap == ESphereOverlap::Outside ? 0.0f : cohesion_radius_squared;
+
+                for ( auto sorted_index = node.First; sorted_index < node.Last; ++sorted_index )
+                {
+                    const auto & other_center = SortedCenters[ sorted_index ];
+                    const auto distance_squared = ( other_center - location ).SizeSquared();
+                    const auto is_other = sorted_index != self_position;
+                    const auto in_alignment = is_other && distance_squared < leaf_alignment_radius_squared;
+                    const auto in_cohesion = is_other && distance_squared < leaf_cohesion_radius_squared;
+
+                    forces.AlignmentForce += SortedVelocities[ sorted_index ] * ( in_alignment ? 1.0f : 0.0f );
+                    forces.AlignmentBoidsCount += in_alignment ? 1 : 0;
+                    forces.CohesionForce += other_center * ( in_cohesion ? 1.0f : 0.0f );
+                    forces.CohesionBoidsCount += in_cohesion ? 1 : 0;
+                }
+
+                tests_count += node.Last - node.First;
+                continue;
+            }
+
+            for ( auto child_index = node.FirstChild; child_index < node.FirstChild + node.ChildrenCount; ++child_index )
+            {
+                stack[ stack_size++ ] = child_index;
+            }
+        }
+
+        return tests_count;
+    }
+
+    size_t FFarFieldOctree::GetAllocatedSize() const
+    {
+        return Nodes.capacity() * sizeof( FNode ) + ( SortedBoidIndices.capacity() + SortedPositions.capacity() + OctantScratch.capacity() ) * sizeof( int32_t );
+    }
+}
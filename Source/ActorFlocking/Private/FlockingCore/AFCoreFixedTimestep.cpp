@@ -0,0 +1,40 @@
+#include "FlockingCore/AFCoreFixedTimestep.h"
+
+#include <algorithm>
+
+namespace AFFlockingCore
+{
+    FFixedTimestep::FFixedTimestep() :
+        Accumulator( 0.0f )
+    {
+    }
+
+    int32_t FFixedTimestep::Advance( const float delta_time, const float step_duration, const int32_t max_steps_count )
+    {
+        Accumulator += std::max( 0.0f, delta_time );
+
+        auto steps_count = static_cast< int32_t >( Accumulator / step_duration );
+
+        if ( steps_count > max_steps_count )
+        {
+            steps_count = std::max( 1, max_steps_count );
+            Accumulator = 0.0f;
+        }
+        else
+        {
+            Accumulator -= static_cast< float >( steps_count ) * step_duration;
+        }
+
+        return steps_count;
+    }
+
+    float FFixedTimestep::GetInterpolationRatio( const float step_duration ) const
+    {
+        return Clamp( Accumulator / step_duration, 0.0f, 1.0f );
+    }
+
+    void FFixedTimestep::Reset()
+    {
+        Accumulator = 0.0f;
+    }
+}
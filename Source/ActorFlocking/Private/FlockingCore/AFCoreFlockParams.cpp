@@ -0,0 +1,47 @@
+#include "FlockingCore/AFCoreFlockParams.h"
+
+#include "FlockingCore/AFCoreMath.h"
+
+namespace AFFlockingCore
+{
+    FFlockParams::FFlockParams() :
+        PursuitWeight( 1.0f ),
+        PursuitSlowdownRadius( 500.0f ),
+        PursuitDistanceBehind( 500.0f ),
+        NonForwardVelocityBrakingFactor( 1.0f ),
+        AlignmentWeight( 1.0f ),
+        AlignmentRadius( 300.0f ),
+        CohesionWeight( 1.0f ),
+        CohesionRadius( 500.0f ),
+        SeparationWeight( 1.0f ),
+        SeparationRadius( 300.0f ),
+        MaxNeighborsCount( 0 ),
+        bUseFarFieldOctree( false ),
+        ObstacleAvoidanceWeight( 0.0f )
+    {
+    }
+
+    FLODParams::FLODParams() :
+        bEnabled( false ),
+        MinDistances { 0.0f, 2500.0f, 6000.0f },
+        UpdateIntervals { 1, 2, 4 }
+    {
+    }
+
+    void FFlockParams::LerpBetween( const FFlockParams & start, const FFlockParams & end, const float ratio )
+    {
+        PursuitWeight = Lerp( start.PursuitWeight, end.PursuitWeight, ratio );
+        PursuitSlowdownRadius = Lerp( start.PursuitSlowdownRadius, end.PursuitSlowdownRadius, ratio );
+        PursuitDistanceBehind = Lerp( start.PursuitDistanceBehind, end.PursuitDistanceBehind, ratio );
+        NonForwardVelocityBrakingFactor = Lerp( start.NonForwardVelocityBrakingFactor, end.NonForwardVelocityBrakingFactor, ratio );
+        AlignmentWeight = Lerp( start.AlignmentWeight, end.AlignmentWeight, ratio );
+        AlignmentRadius = Lerp( start.AlignmentRadius, end.AlignmentRadius, ratio );
+        CohesionWeight = Lerp( start.CohesionWeight, end.CohesionWeight, ratio );
+        CohesionRadius = Lerp( start.CohesionRadius, end.CohesionRadius, ratio );
+        SeparationWeight = Lerp( start.SeparationWeight, end.SeparationWeight, ratio );
+        SeparationRadius = Lerp( start.SeparationRadius, end.SeparationRadius, ratio );
+        MaxNeighborsCount = ratio < 0.5f ? start.MaxNeighborsCount : end.MaxNeighborsCount;
+        bUseFarFieldOctree = ratio < 0.5f ? start.bUseFarFieldOctree : end.bUseFarFieldOctree;
+        ObstacleAvoidanceWeight = Lerp( start.ObstacleAvoidanceWeight, end.ObstacleAvoidanceWeight, ratio );
+    }
+}
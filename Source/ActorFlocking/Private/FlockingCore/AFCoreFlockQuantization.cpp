@@ -0,0 +1,306 @@
+#include "FlockingCore/AFCoreFlockQuantization.h"
+
+#include <cstring>
+
+namespace AFFlockingCore
+{
+    namespace
+    {
+        constexpr int32_t MaxQuantizedComponent = ( 1 << ( QuantizedComponentBitsCount - 1 ) ) - 1;
+        // The difference of two components needs one more bit than a component
+        constexpr int32_t LargeDeltaBitsCount = QuantizedComponentBitsCount + 1;
+        // Boids counts are written on this many bits
+        constexpr int32_t BoidsCountBitsCount = 24;
+
+        int32_t Quantize( const float value, const float precision )
+        {
+            const auto steps = std::round( value / precision );
+            return static_cast< int32_t >( Clamp( steps, static_cast< float >( -MaxQuantizedComponent ), static_cast< float >( MaxQuantizedComponent ) ) );
+        }
+
+        // Maps the small negative and positive values to small unsigned values : 0, -1, 1, -2, 2...
+        uint32_t ZigZagEncode( const int32_t value )
+        {
+            return ( static_cast< uint32_t >( value ) << 1u ) ^ static_cast< uint32_t >( value >> 31 );
+        }
+
+        int32_t ZigZagDecode( const uint32_t value )
+        {
+            return static_cast< int32_t >( value >> 1u ) ^ -static_cast< int32_t >( value & 1u );
+        }
+
+        /* Prefix code of a difference :
+         * 0 : no difference
+         * 10 + 5 bits, 110 + 10 bits, 111 + 21 bits : zigzag encoded difference */
+        void WriteDelta( FBitsWriter & writer, const int32_t value, const int32_t base_value )
+        {
+            const auto delta = ZigZagEncode( value - base_value );
+
+            if ( delta == 0u )
+            {
+                writer.WriteBits( 0u, 1 );
+            }
+            else if ( delta < ( 1u << 5u ) )
+            {
+                writer.WriteBits( 0x1u, 2 );
+                writer.WriteBits( delta, 5 );
+            }
+            else if ( delta < ( 1u << 10u ) )
+            {
+                writer.WriteBits( 0x3u, 3 );
+                writer.WriteBits( delta, 10 );
+            }
+            else
+            {
+                writer.WriteBits( 0x7u, 3 );
+                writer.WriteBits( delta, LargeDeltaBitsCount );
+            }
+        }
+
+        bool ReadDelta( FBitsReader & reader, int32_t & value, const int32_t base_value )
+        {
+            auto bits_count = 0;
+
+            if ( reader.ReadBits( 1 ) != 0u )
+            {
+                bits_count = 5;
+
+                if ( reader.ReadBits( 1 ) != 0u )
+                {
+                    bits_count = reader.ReadBits( 1 ) != 0u ? LargeDeltaBitsCount : 10;
+                }
+            }
+
+            const auto delta = bits_count > 0 ? ZigZagDecode( reader.ReadBits( bits_count ) ) : 0;
+            value = static_cast< int32_t >( static_cast< int64_t >( base_value ) + delta );
+
+            return !reader.HasError() && value >= -MaxQuantizedComponent && value <= MaxQuantizedComponent;
+        }
+
+        const FQuantizedBoid & GetBaseBoid( const FQuantizedFlock * base, const int32_t index )
+        {
+            static const FQuantizedBoid ZeroBoid = { { 0, 0, 0 }, { 0, 0, 0 } };
+
+            return base != nullptr && index < static_cast< int32_t >( base->Boids.size() ) ? base->Boids[ index ] : ZeroBoid;
+        }
+    }
+
+    FBitsWriter::FBitsWriter() :
+        BitsCount( 0 )
+    {
+    }
+
+    void FBitsWriter::Reset()
+    {
+        Bytes.clear();
+        BitsCount = 0;
+    }
+
+    void FBitsWriter::WriteBits( const uint32_t value, const int32_t bits_count )
+    {
+        for ( auto bit_index = 0; bit_index < bits_count; ++bit_index, ++BitsCount )
+        {
+            if ( ( BitsCount & 7 ) == 0 )
+            {
+                Bytes.push_back( 0u );
+            }
+
+            if ( ( value >> bit_index ) & 1u )
+            {
+                Bytes.back() |= static_cast< uint8_t >( 1u << ( BitsCount & 7 ) );
+            }
+        }
+    }
+
+    void FBitsWriter::WriteFloat( const float value )
+    {
+        uint32_t bits;
+        std::memcpy( &bits, &value, sizeof( bits ) );
+        WriteBits( bits, 32 );
+    }
+
+    FBitsReader::FBitsReader( const uint8_t * bytes, const int64_t bits_count ) :
+        Bytes( bytes ),
+        BitsCount( bits_count ),
+        Offset( 0 ),
+        bHasError( false )
+    {
+    }
+
+    uint32_t FBitsReader::ReadBits( const int32_t bits_count )
+    {
+        if ( bHasError || BitsCount - Offset < bits_count )
+        {
+            bHasError = true;
+            return 0u;
+        }
+
+        auto value = 0u;
+
+        for ( auto bit_index = 0; bit_index < bits_count; ++bit_index, ++Offset )
+        {
+            value |= static_cast< uint32_t >( ( Bytes[ Offset >> 3 ] >> ( Offset & 7 ) ) & 1u ) << bit_index;
+        }
+
+        return value;
+    }
+
+    float FBitsReader::ReadFloat()
+    {
+        const auto bits = ReadBits( 32 );
+        float value;
+        std::memcpy( &value, &bits, sizeof( value ) );
+        return value;
+    }
+
+    bool FQuantizedBoid::operator==( const FQuantizedBoid & other ) const
+    {
+        return std::memcmp( this, &other, sizeof( FQuantizedBoid ) ) == 0;
+    }
+
+    FQuantizedFlock::FQuantizedFlock() :
+        OwnerLocation( 0.0f ),
+        PositionPrecision( 1.0f ),
+        VelocityPrecision( 1.0f )
+    {
+    }
+
+    void FQuantizedFlock::Reset( const FVec3 & owner_location, const float position_precision, const float velocity_precision, const int32_t boids_count )
+    {
+        OwnerLocation = owner_location;
+        PositionPrecision = std::max( position_precision, SmallNumber );
+        VelocityPrecision = std::max( velocity_precision, SmallNumber );
+        Boids.resize( boids_count );
+    }
+
+    void FQuantizedFlock::SetBoid( const int32_t index, const FVec3 & location, const FVec3 & velocity )
+    {
+        const auto relative_location = location - OwnerLocation;
+        auto & boid = Boids[ index ];
+
+        boid.Location[ 0 ] = Quantize( relative_location.X, PositionPrecision );
+        boid.Location[ 1 ] = Quantize( relative_location.Y, PositionPrecision );
+        boid.Location[ 2 ] = Quantize( relative_location.Z, PositionPrecision );
+        boid.Velocity[ 0 ] = Quantize( velocity.X, VelocityPrecision );
+        boid.Velocity[ 1 ] = Quantize( velocity.Y, VelocityPrecision );
+        boid.Velocity[ 2 ] = Quantize( velocity.Z, VelocityPrecision );
+    }
+
+    FVec3 FQuantizedFlock::GetBoidLocation( const int32_t index ) const
+    {
+        const auto & boid = Boids[ index ];
+        return OwnerLocation + FVec3( static_cast< float >( boid.Location[ 0 ] ), static_cast< float >( boid.Location[ 1 ] ), static_cast< float >( boid.Location[ 2 ] ) ) * PositionPrecision;
+    }
+
+    FVec3 FQuantizedFlock::GetBoidVelocity( const int32_t index ) const
+    {
+        const auto & boid = Boids[ index ];
+        return FVec3( static_cast< float >( boid.Velocity[ 0 ] ), static_cast< float >( boid.Velocity[ 1 ] ), static_cast< float >( boid.Velocity[ 2 ] ) ) * VelocityPrecision;
+    }
+
+    bool FQuantizedFlock::operator==( const FQuantizedFlock & other ) const
+    {
+        return OwnerLocation.X == other.OwnerLocation.X
+               && OwnerLocation.Y == other.OwnerLocation.Y
+               && OwnerLocation.Z == other.OwnerLocation.Z
+               && PositionPrecision == other.PositionPrecision
+               && VelocityPrecision == other.VelocityPrecision
+               && Boids == other.Boids;
+    }
+
+    void EncodeQuantizedFlock( FBitsWriter & writer, const FQuantizedFlock & flock, const FQuantizedFlock * base )
+    {
+        writer.WriteFloat( flock.OwnerLocation.X );
+        writer.WriteFloat( flock.OwnerLocation.Y );
+        writer.WriteFloat( flock.OwnerLocation.Z );
+        writer.WriteFloat( flock.PositionPrecision );
+        writer.WriteFloat( flock.VelocityPrecision );
+        writer.WriteBits( static_cast< uint32_t >( flock.Boids.size() ), BoidsCountBitsCount );
+
+        // The differences are only meaningful when both states use the same precisions
+        const auto * compatible_base = base != nullptr && base->PositionPrecision == flock.PositionPrecision && base->VelocityPrecision == flock.VelocityPrecision
+                                           ? base
+                                           : nullptr;
+
+        for ( auto index = 0; index < static_cast< int32_t >( flock.Boids.size() ); ++index )
+        {
+            const auto & boid = flock.Boids[ index ];
+            const auto & base_boid = GetBaseBoid( compatible_base, index );
+
+            if ( boid == base_boid )
+            {
+                writer.WriteBits( 0u, 1 );
+                continue;
+            }
+
+            writer.WriteBits( 1u, 1 );
+
+            for ( auto axis = 0; axis < 3; ++axis )
+            {
+                WriteDelta( writer, boid.Location[ axis ], base_boid.Location[ axis ] );
+            }
+
+            for ( auto axis = 0; axis < 3; ++axis )
+            {
+                WriteDelta( writer, boid.Velocity[ axis ], base_boid.Velocity[ axis ] );
+            }
+        }
+    }
+
+    bool DecodeQuantizedFlock( FBitsReader & reader, FQuantizedFlock & flock, const FQuantizedFlock * base )
+    {
+        flock.OwnerLocation.X = reader.ReadFloat();
+        flock.OwnerLocation.Y = reader.ReadFloat();
+        flock.OwnerLocation.Z = reader.ReadFloat();
+        flock.PositionPrecision = reader.ReadFloat();
+        flock.VelocityPrecision = reader.ReadFloat();
+
+        const auto boids_count = static_cast< int32_t >( reader.ReadBits( BoidsCountBitsCount ) );
+
+        if ( reader.HasError() || !( flock.PositionPrecision > 0.0f ) || !( flock.VelocityPrecision > 0.0f ) )
+        {
+            return false;
+        }
+
+        const auto * compatible_base = base != nullptr && base->PositionPrecision == flock.PositionPrecision && base->VelocityPrecision == flock.VelocityPrecision
+                                           ? base
+                                           : nullptr;
+
+        // Grown boid by boid, so a corrupted count fails when the bits run out instead of allocating up front
+        flock.Boids.clear();
+
+        for ( auto index = 0; index < boids_count; ++index )
+        {
+            const auto & base_boid = GetBaseBoid( compatible_base, index );
+            auto boid = base_boid;
+
+            if ( reader.ReadBits( 1 ) != 0u )
+            {
+                for ( auto axis = 0; axis < 3; ++axis )
+                {
+                    if ( !ReadDelta( reader, boid.Location[ axis ], base_boid.Location[ axis ] ) )
+                    {
+                        return false;
+                    }
+                }
+
+                for ( auto axis = 0; axis < 3; ++axis )
+                {
+                    if ( !ReadDelta( reader, boid.Velocity[ axis ], base_boid.Velocity[ axis ] ) )
+                    {
+                        return false;
+                    }
+                }
+            }
+
+            if ( reader.HasError() )
+            {
+                return false;
+            }
+
+            flock.Boids.push_back( boid );
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,367 @@
+#include "FlockingCore/AFCoreFlockRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace AFFlockingCore
+{
+    namespace
+    {
+        constexpr uint32_t RecordingMagic = 0x43524641u; // "AFRC"
+        constexpr uint32_t RecordingVersion = 3u;
+
+        class FWriter
+        {
+        public:
+            explicit FWriter( std::vector< uint8_t > & bytes ) :
+                Bytes( bytes )
+            {
+            }
+
+            template < typename _TYPE_ >
+            void Write( const _TYPE_ value )
+            {
+                static_assert( std::is_arithmetic< _TYPE_ >::value, "Only arithmetic types have a fixed layout" );
+
+                const auto * value_bytes = reinterpret_cast< const uint8_t * >( &value );
+                Bytes.insert( Bytes.end(), value_bytes, value_bytes + sizeof( _TYPE_ ) );
+            }
+
+            void Write( const FVec3 & vector )
+            {
+                Write( vector.X );
+                Write( vector.Y );
+                Write( vector.Z );
+            }
+
+        private:
+            std::vector< uint8_t > & Bytes;
+        };
+
+        class FReader
+        {
+        public:
+            FReader( const uint8_t * bytes, const size_t bytes_count ) :
+                Bytes( bytes ),
+                BytesCount( bytes_count ),
+                Offset( 0 )
+            {
+            }
+
+            template < typename _TYPE_ >
+            bool Read( _TYPE_ & value )
+            {
+                static_assert( std::is_arithmetic< _TYPE_ >::value, "Only arithmetic types have a fixed layout" );
+
+                if ( BytesCount - Offset < sizeof( _TYPE_ ) )
+                {
+                    return false;
+                }
+
+                std::memcpy( &value, Bytes + Offset, sizeof( _TYPE_ ) );
+                Offset += sizeof( _TYPE_ );
+                return true;
+            }
+
+            bool Read( FVec3 & vector )
+            {
+                return Read( vector.X ) && Read( vector.Y ) && Read( vector.Z );
+            }
+
+            bool Read( bool & value )
+            {
+                uint8_t byte;
+
+                if ( !Read( byte ) )
+                {
+                    return false;
+                }
+
+                value = byte != 0;
+                return true;
+            }
+
+            // Reads the size of an array whose elements take at least element_size bytes, and checks there are enough bytes left for them
+            bool ReadCount( int32_t & count, const size_t element_size )
+            {
+                uint32_t value;
+
+                if ( !Read( value ) || value > static_cast< uint32_t >( INT32_MAX ) || static_cast< uint64_t >( value ) * element_size > BytesCount - Offset )
+                {
+                    return false;
+                }
+
+                count = static_cast< int32_t >( value );
+                return true;
+            }
+
+            size_t GetOffset() const
+            {
+                return Offset;
+            }
+
+        private:
+            const uint8_t * Bytes;
+            size_t BytesCount;
+            size_t Offset;
+        };
+
+        void WriteFrame( FWriter & writer, const FFlockState & state, const FSteeringOptions & options )
+        {
+            writer.Write( static_cast< uint8_t >( options.bUseVectorizedKernel ) );
+            writer.Write( static_cast< uint8_t >( options.bStoreDebugForces ) );
+            writer.Write( static_cast< uint8_t >( options.bSeparateFromOtherFlocks ) );
+            writer.Write( options.NeighborListSkinDistance );
+
+            writer.Write( static_cast< uint32_t >( state.Flocks.size() ) );
+
+            for ( const auto & flock : state.Flocks )
+            {
+                const auto & params = flock.Params;
+                writer.Write( params.PursuitWeight );
+                writer.Write( params.PursuitSlowdownRadius );
+                writer.Write( params.PursuitDistanceBehind );
+                writer.Write( params.NonForwardVelocityBrakingFactor );
+                writer.Write( params.AlignmentWeight );
+                writer.Write( params.AlignmentRadius );
+                writer.Write( params.CohesionWeight );
+                writer.Write( params.CohesionRadius );
+                writer.Write( params.SeparationWeight );
+                writer.Write( params.SeparationRadius );
+                writer.Write( params.MaxNeighborsCount );
+                writer.Write( static_cast< uint8_t >( params.bUseFarFieldOctree ) );
+                writer.Write( params.ObstacleAvoidanceWeight );
+
+                writer.Write( static_cast< uint8_t >( flock.LOD.bEnabled ) );
+
+                for ( auto level = 0; level < LODLevelsCount; ++level )
+                {
+                    writer.Write( flock.LOD.MinDistances[ level ] );
+                    writer.Write( flock.LOD.UpdateIntervals[ level ] );
+                }
+
+                writer.Write( flock.OwnerLocation );
+                writer.Write( flock.OwnerForwardVector );
+                writer.Write( flock.OwnerVelocity );
+                writer.Write( flock.FirstBoidIndex );
+                writer.Write( flock.BoidsCount );
+                writer.Write( flock.BoidsOrderVersion );
+            }
+
+            writer.Write( static_cast< uint32_t >( state.Boids.size() ) );
+
+            for ( auto boid_index = 0; boid_index < static_cast< int32_t >( state.Boids.size() ); ++boid_index )
+            {
+                const auto & boid = state.Boids[ boid_index ];
+                writer.Write( boid.Center );
+                writer.Write( boid.Velocity );
+                writer.Write( boid.MaxVelocity );
+                writer.Write( boid.SteeringVelocity );
+                writer.Write( boid.PreviousSteeringVelocity );
+                writer.Write( boid.FramesSinceUpdate );
+                writer.Write( boid.ObstacleAvoidance );
+                writer.Write( state.PursuitOffsetMultipliers[ boid_index ] );
+            }
+
+            writer.Write( static_cast< uint32_t >( state.BoidsToUpdate.size() ) );
+
+            for ( const auto boid_index : state.BoidsToUpdate )
+            {
+                writer.Write( boid_index );
+            }
+        }
+
+        bool ReadFrame( FReader & reader, FRecordedFrame & frame )
+        {
+            auto & options = frame.Options;
+            auto & state = frame.State;
+            state.Reset();
+
+            if ( !reader.Read( options.bUseVectorizedKernel ) || !reader.Read( options.bStoreDebugForces ) || !reader.Read( options.bSeparateFromOtherFlocks ) || !reader.Read( options.NeighborListSkinDistance ) )
+            {
+                return false;
+            }
+
+            int32_t flocks_count;
+
+            if ( !reader.ReadCount( flocks_count, 1 ) )
+            {
+                return false;
+            }
+
+            state.Flocks.resize( flocks_count );
+
+            for ( auto & flock : state.Flocks )
+            {
+                auto & params = flock.Params;
+                auto success = reader.Read( params.PursuitWeight ) && reader.Read( params.PursuitSlowdownRadius ) && reader.Read( params.PursuitDistanceBehind ) && reader.Read( params.NonForwardVelocityBrakingFactor )
+                               && reader.Read( params.AlignmentWeight ) && reader.Read( params.AlignmentRadius ) && reader.Read( params.CohesionWeight ) && reader.Read( params.CohesionRadius )
+                               && reader.Read( params.SeparationWeight ) && reader.Read( params.SeparationRadius ) && reader.Read( params.MaxNeighborsCount ) && reader.Read( params.bUseFarFieldOctree ) && reader.Read( params.ObstacleAvoidanceWeight )
+                               && reader.Read( flock.LOD.bEnabled );
+
+                for ( auto level = 0; level < LODLevelsCount; ++level )
+                {
+                    success = success && reader.Read( flock.LOD.MinDistances[ level ] ) && reader.Read( flock.LOD.UpdateIntervals[ level ] );
+                }
+
+                success = success && reader.Read( flock.OwnerLocation ) && reader.Read( flock.OwnerForwardVector ) && reader.Read( flock.OwnerVelocity )
+                          && reader.Read( flock.FirstBoidIndex ) && reader.Read( flock.BoidsCount ) && reader.Read( flock.BoidsOrderVersion );
+
+                if ( !success )
+                {
+                    return false;
+                }
+            }
+
+            int32_t boids_count;
+
+            if ( !reader.ReadCount( boids_count, 1 ) )
+            {
+                return false;
+            }
+
+            state.Boids.resize( boids_count );
+            state.PursuitOffsetMultipliers.resize( boids_count );
+            state.BoidFlockIndices.resize( boids_count );
+
+            for ( auto boid_index = 0; boid_index < boids_count; ++boid_index )
+            {
+                auto & boid = state.Boids[ boid_index ];
+
+                if ( !reader.Read( boid.Center ) || !reader.Read( boid.Velocity ) || !reader.Read( boid.MaxVelocity ) || !reader.Read( boid.SteeringVelocity )
+                     || !reader.Read( boid.PreviousSteeringVelocity ) || !reader.Read( boid.FramesSinceUpdate ) || !reader.Read( boid.ObstacleAvoidance ) || !reader.Read( state.PursuitOffsetMultipliers[ boid_index ] ) )
+                {
+                    return false;
+                }
+            }
+
+            // The flocks must own contiguous ranges covering all the boids, like FFlockState::AddFlock makes them
+            auto next_first_boid_index = 0;
+
+            for ( auto flock_index = 0; flock_index < flocks_count; ++flock_index )
+            {
+                const auto & flock = state.Flocks[ flock_index ];
+
+                if ( flock.FirstBoidIndex != next_first_boid_index || flock.BoidsCount < 0 || flock.BoidsCount > boids_count - flock.FirstBoidIndex )
+                {
+                    return false;
+                }
+
+                std::fill( state.BoidFlockIndices.begin() + flock.FirstBoidIndex, state.BoidFlockIndices.begin() + flock.FirstBoidIndex + flock.BoidsCount, flock_index );
+                next_first_boid_index += flock.BoidsCount;
+            }
+
+            if ( next_first_boid_index != boids_count )
+            {
+                return false;
+            }
+
+            int32_t update_count;
+
+            if ( !reader.ReadCount( update_count, sizeof( int32_t ) ) )
+            {
+                return false;
+            }
+
+            state.BoidsToUpdate.resize( update_count );
+
+            for ( auto & boid_index : state.BoidsToUpdate )
+            {
+                if ( !reader.Read( boid_index ) || boid_index < 0 || boid_index >= boids_count )
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+    }
+
+    FFlockRecorder::FFlockRecorder() :
+        NextFrameIndex( 0 ),
+        FramesCount( 0 )
+    {
+    }
+
+    void FFlockRecorder::SetMaxFramesCount( const int32_t max_frames_count )
+    {
+        Frames.resize( max_frames_count > 0 ? max_frames_count : 0 );
+        Clear();
+    }
+
+    void FFlockRecorder::Record( const FFlockState & state, const FSteeringOptions & options )
+    {
+        if ( Frames.empty() )
+        {
+            return;
+        }
+
+        auto & frame_bytes = Frames[ NextFrameIndex ];
+        frame_bytes.clear();
+
+        FWriter writer( frame_bytes );
+        WriteFrame( writer, state, options );
+
+        NextFrameIndex = ( NextFrameIndex + 1 ) % static_cast< int32_t >( Frames.size() );
+        FramesCount = std::min( FramesCount + 1, static_cast< int32_t >( Frames.size() ) );
+    }
+
+    void FFlockRecorder::Clear()
+    {
+        NextFrameIndex = 0;
+        FramesCount = 0;
+    }
+
+    void FFlockRecorder::WriteTo( std::vector< uint8_t > & bytes ) const
+    {
+        FWriter writer( bytes );
+        writer.Write( RecordingMagic );
+        writer.Write( RecordingVersion );
+        writer.Write( static_cast< uint32_t >( FramesCount ) );
+
+        const auto max_frames_count = static_cast< int32_t >( Frames.size() );
+        const auto oldest_frame_index = ( NextFrameIndex - FramesCount + max_frames_count ) % std::max( 1, max_frames_count );
+
+        for ( auto index = 0; index < FramesCount; ++index )
+        {
+            const auto & frame_bytes = Frames[ ( oldest_frame_index + index ) % max_frames_count ];
+            writer.Write( static_cast< uint32_t >( frame_bytes.size() ) );
+            bytes.insert( bytes.end(), frame_bytes.begin(), frame_bytes.end() );
+        }
+    }
+
+    bool ReadFlockRecording( const uint8_t * bytes, const size_t bytes_count, std::vector< FRecordedFrame > & frames )
+    {
+        FReader reader( bytes, bytes_count );
+        uint32_t magic;
+        uint32_t version;
+        int32_t frames_count;
+
+        if ( !reader.Read( magic ) || magic != RecordingMagic || !reader.Read( version ) || version != RecordingVersion || !reader.ReadCount( frames_count, sizeof( uint32_t ) ) )
+        {
+            return false;
+        }
+
+        frames.resize( frames_count );
+
+        for ( auto & frame : frames )
+        {
+            uint32_t frame_bytes_count;
+
+            if ( !reader.Read( frame_bytes_count ) )
+            {
+                return false;
+            }
+
+            const auto frame_start_offset = reader.GetOffset();
+
+            if ( !ReadFrame( reader, frame ) || reader.GetOffset() - frame_start_offset != frame_bytes_count )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
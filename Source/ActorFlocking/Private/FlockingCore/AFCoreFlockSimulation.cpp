@@ -0,0 +1,352 @@
+#include "FlockingCore/AFCoreFlockSimulation.h"
+
+#include "FlockingCore/AFCoreSteeringBehaviors.h"
+
+#include <algorithm>
+
+namespace AFFlockingCore
+{
+    namespace
+    {
+        uint32_t GetSteeringFeatures( const FFlockParams & params, const FSteeringOptions & options )
+        {
+            auto features = 0u;
+
+            // A force without weight or radius would only add zeros
+            if ( params.AlignmentWeight != 0.0f && params.AlignmentRadius > 0.0f )
+            {
+                features |= ESteeringFeatures::Alignment;
+            }
+
+            if ( params.CohesionWeight != 0.0f && params.CohesionRadius > 0.0f )
+            {
+                features |= ESteeringFeatures::Cohesion;
+            }
+
+            if ( params.SeparationWeight != 0.0f && params.SeparationRadius > 0.0f )
+            {
+                features |= ESteeringFeatures::Separation;
+            }
+
+            if ( options.bStoreDebugForces )
+            {
+                features |= ESteeringFeatures::DebugForces;
+            }
+
+            return features;
+        }
+
+        bool UsesFarField( const FFlockParams & params, const uint32_t features )
+        {
+            return params.bUseFarFieldOctree && params.MaxNeighborsCount <= 0 && ( features & ( ESteeringFeatures::Alignment | ESteeringFeatures::Cohesion ) ) != 0;
+        }
+    }
+
+    FSteeringOptions::FSteeringOptions() :
+        bUseVectorizedKernel( true ),
+        bStoreDebugForces( false ),
+        bSeparateFromOtherFlocks( false ),
+        NeighborListSkinDistance( 0.0f )
+    {
+    }
+
+    FSteeringCounters::FSteeringCounters() :
+        NeighborCandidatesCount( 0 ),
+        PairTestsCount( 0 ),
+        NeighborsCount( 0 )
+    {
+    }
+
+    void FSteeringCounters::Add( const FSteeringCounters & other )
+    {
+        NeighborCandidatesCount += other.NeighborCandidatesCount;
+        PairTestsCount += other.PairTestsCount;
+        NeighborsCount += other.NeighborsCount;
+    }
+
+    FFlockSimulation::FFlockSimulation() :
+        bUseNeighbors( false ),
+        bUseNearestNeighbors( false ),
+        bUseNeighborLists( false ),
+        bHasRebuiltNeighborLists( false )
+    {
+    }
+
+    void FFlockSimulation::BuildNeighborSearch( const FFlockState & state, const FSteeringOptions & options )
+    {
+        Options = options;
+        FlocksRadii.resize( state.Flocks.size() );
+        FlocksFeatures.resize( state.Flocks.size() );
+        FlocksOctrees.resize( state.Flocks.size() );
+
+        // All the flocks share the same spatial hash, whose cells must be large enough for the biggest radius
+        auto neighbor_radius = 0.0f;
+        auto max_neighbors_count = 0;
+        auto has_metric_flocks = false;
+
+        for ( auto flock_index = 0; flock_index < static_cast< int32_t >( state.Flocks.size() ); ++flock_index )
+        {
+            const auto & flock = state.Flocks[ flock_index ];
+            const auto & params = flock.Params;
+            const auto features = GetSteeringFeatures( params, Options );
+            FlocksFeatures[ flock_index ] = features;
+
+            const auto alignment_radius = ( features & ESteeringFeatures::Alignment ) != 0 ? params.AlignmentRadius : 0.0f;
+            const auto cohesion_radius = ( features & ESteeringFeatures::Cohesion ) != 0 ? params.CohesionRadius : 0.0f;
+            const auto separation_radius = ( features & ESteeringFeatures::Separation ) != 0 ? params.SeparationRadius : 0.0f;
+
+            if ( UsesFarField( params, features ) )
+            {
+                // The spatial hash only has to find the neighbors within the separation radius
+                FlocksRadii[ flock_index ] = FNeighborRadii { 0.0f, 0.0f, separation_radius };
+                FlocksOctrees[ flock_index ].Build( state, flock.FirstBoidIndex, flock.BoidsCount );
+            }
+            else
+            {
+                FlocksRadii[ flock_index ] = FNeighborRadii { alignment_radius, cohesion_radius, separation_radius };
+            }
+
+            const auto & radii = FlocksRadii[ flock_index ];
+            neighbor_radius = std::max( { neighbor_radius, radii.AlignmentRadius, radii.CohesionRadius, radii.SeparationRadius } );
+            max_neighbors_count = std::max( max_neighbors_count, params.MaxNeighborsCount );
+            has_metric_flocks |= params.MaxNeighborsCount <= 0;
+        }
+
+        // No boid can be a neighbor if all the radii are null, as the distance between two boids can't be negative
+        bUseNeighbors = neighbor_radius > 0.0f;
+        bUseNearestNeighbors = bUseNeighbors && max_neighbors_count > 0;
+        bUseNeighborLists = bUseNeighbors && has_metric_flocks && Options.NeighborListSkinDistance > 0.0f;
+        bHasRebuiltNeighborLists = false;
+
+        if ( bUseNearestNeighbors )
+        {
+            NearestNeighborsSpatialHash.Build( state.Boids, GetNearestNeighborsCellSize( state, neighbor_radius, max_neighbors_count ) );
+        }
+
+        if ( bUseNeighborLists )
+        {
+            if ( !NeighborLists.IsValidFor( state, neighbor_radius ) )
+            {
+                const auto cutoff_radius = neighbor_radius + Options.NeighborListSkinDistance;
+                SpatialHash.Build( state.Boids, cutoff_radius );
+                NeighborLists.Build( state, SpatialHash, cutoff_radius );
+                bHasRebuiltNeighborLists = true;
+            }
+        }
+        else if ( bUseNeighbors && has_metric_flocks )
+        {
+            SpatialHash.Build( state.Boids, neighbor_radius );
+
+            if ( Options.bUseVectorizedKernel )
+            {
+                SoA.Build( state, SpatialHash );
+            }
+        }
+
+        if ( Options.bStoreDebugForces )
+        {
+            DebugForces.resize( state.Boids.size() );
+        }
+    }
+
+    void FFlockSimulation::ComputeSteeringVelocities( FFlockState & state, const int32_t first, const int32_t last, FSteeringScratch & scratch )
+    {
+        typedef void ( FFlockSimulation::*FComputeFlockSteeringVelocities )( FFlockState &, int32_t, int32_t, FSteeringScratch & );
+
+        // One instantiation per combination of ESteeringFeatures, indexed by the features
+        static const FComputeFlockSteeringVelocities compute_flock_steering_velocities[ ESteeringFeatures::CombinationsCount ] = {
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 0u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 1u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 2u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 3u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 4u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 5u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 6u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 7u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 8u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 9u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 10u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 11u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 12u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 13u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 14u >,
+            &FFlockSimulation::ComputeFlockSteeringVelocities< 15u >,
+        };
+
+        // The boids to update are in ascending order, and each flock owns a contiguous range of boids, so the boids of a flock are consecutive
+        auto flock_first = first;
+
+        while ( flock_first < last )
+        {
+            const auto flock_index = state.BoidFlockIndices[ state.BoidsToUpdate[ flock_first ] ];
+            const auto & flock = state.Flocks[ flock_index ];
+            const auto flock_end_boid_index = flock.FirstBoidIndex + flock.BoidsCount;
+            auto flock_last = flock_first + 1;
+
+            while ( flock_last < last && state.BoidsToUpdate[ flock_last ] < flock_end_boid_index )
+            {
+                ++flock_last;
+            }
+
+            ( this->*compute_flock_steering_velocities[ FlocksFeatures[ flock_index ] ] )( state, flock_first, flock_last, scratch );
+            flock_first = flock_last;
+        }
+    }
+
+    template < uint32_t _FEATURES_ >
+    void FFlockSimulation::ComputeFlockSteeringVelocities( FFlockState & state, const int32_t first, const int32_t last, FSteeringScratch & scratch )
+    {
+        constexpr auto neighbor_features = _FEATURES_ & ESteeringFeatures::NeighborForces;
+        constexpr auto has_alignment = ( _FEATURES_ & ESteeringFeatures::Alignment ) != 0;
+        constexpr auto has_cohesion = ( _FEATURES_ & ESteeringFeatures::Cohesion ) != 0;
+        constexpr auto has_separation = ( _FEATURES_ & ESteeringFeatures::Separation ) != 0;
+        constexpr auto has_debug_forces = ( _FEATURES_ & ESteeringFeatures::DebugForces ) != 0;
+
+        const auto flock_index = state.BoidFlockIndices[ state.BoidsToUpdate[ first ] ];
+        const auto & flock = state.Flocks[ flock_index ];
+        const auto & params = flock.Params;
+        const auto & radii = FlocksRadii[ flock_index ];
+        const auto uses_far_field = UsesFarField( params, _FEATURES_ );
+
+        for ( auto update_index = first; update_index < last; ++update_index )
+        {
+            const auto boid_index = state.BoidsToUpdate[ update_index ];
+            auto & boid = state.Boids[ boid_index ];
+            const auto velocity = boid.Velocity;
+
+            FNeighborForces neighbor_forces;
+
+            // Without neighbor forces, only the pursuit and the obstacle avoidance are left, which don't depend on the neighbors
+            if ( neighbor_features != 0 )
+            {
+                if ( bUseNeighbors && params.MaxNeighborsCount > 0 )
+                {
+                    scratch.Counters.PairTestsCount += AccumulateNearestNeighborForces( neighbor_forces, scratch.Counters.NeighborCandidatesCount, boid_index, state, NearestNeighborsSpatialHash, radii, params.MaxNeighborsCount, Options.bSeparateFromOtherFlocks, scratch.NearestNeighbors );
+                }
+                else if ( bUseNeighborLists )
+                {
+                    const auto neighbors_count = NeighborLists.GetNeighborsCount( boid_index );
+                    scratch.Counters.NeighborCandidatesCount += neighbors_count;
+                    scratch.Counters.PairTestsCount += AccumulateNeighborForces< neighbor_features >( neighbor_forces, boid_index, state, NeighborLists.GetNeighbors( boid_index ), neighbors_count, radii, Options.bSeparateFromOtherFlocks );
+                }
+                else if ( bUseNeighbors )
+                {
+                    if ( Options.bUseVectorizedKernel )
+                    {
+                        scratch.Counters.PairTestsCount += SoA.AccumulateNeighborForces< neighbor_features >( neighbor_forces, scratch.Counters.NeighborCandidatesCount, boid_index, SpatialHash, radii, Options.bSeparateFromOtherFlocks );
+                    }
+                    else
+                    {
+                        SpatialHash.GatherCandidates( boid.Center, scratch.NeighborCandidates );
+                        scratch.Counters.NeighborCandidatesCount += static_cast< int64_t >( scratch.NeighborCandidates.size() );
+                        scratch.Counters.PairTestsCount += AccumulateNeighborForces< neighbor_features >( neighbor_forces, boid_index, state, scratch.NeighborCandidates, radii, Options.bSeparateFromOtherFlocks );
+                    }
+                }
+            }
+
+            if ( uses_far_field )
+            {
+                const FNeighborRadii far_field_radii { has_alignment ? params.AlignmentRadius : 0.0f, has_cohesion ? params.CohesionRadius : 0.0f, 0.0f };
+                scratch.Counters.PairTestsCount += FlocksOctrees[ flock_index ].AccumulateAlignmentAndCohesion( neighbor_forces, boid_index, state, far_field_radii );
+            }
+
+            scratch.Counters.NeighborsCount += std::max( { neighbor_forces.AlignmentBoidsCount, neighbor_forces.CohesionBoidsCount, neighbor_forces.SeparationBoidsCount } );
+
+            const auto pursuit_target = flock.OwnerLocation - flock.OwnerForwardVector * params.PursuitDistanceBehind * state.PursuitOffsetMultipliers[ boid_index ];
+
+            const auto seek_force = Pursuit( boid, pursuit_target, flock.OwnerVelocity, params.PursuitSlowdownRadius );
+            const auto obstacle_avoidance_force = boid.ObstacleAvoidance * boid.MaxVelocity;
+
+            auto result = velocity + seek_force * params.PursuitWeight;
+
+            // The disabled forces have no weight, so skipping them gives the same result
+            if ( has_cohesion && neighbor_forces.CohesionBoidsCount > 0 )
+            {
+                auto cohesion_force = neighbor_forces.CohesionForce / static_cast< float >( neighbor_forces.CohesionBoidsCount );
+                cohesion_force -= boid.Center;
+                cohesion_force.Normalize();
+                cohesion_force *= boid.MaxVelocity;
+                result += cohesion_force * params.CohesionWeight;
+
+                if ( has_debug_forces )
+                {
+                    DebugForces[ boid_index ].CohesionForce = cohesion_force * params.CohesionWeight;
+                }
+            }
+            else if ( has_debug_forces )
+            {
+                DebugForces[ boid_index ].CohesionForce = FVec3( 0.0f );
+            }
+
+            if ( has_alignment && neighbor_forces.AlignmentBoidsCount > 0 )
+            {
+                const auto alignment_force = neighbor_forces.AlignmentForce / static_cast< float >( neighbor_forces.AlignmentBoidsCount );
+                result += alignment_force * params.AlignmentWeight;
+
+                if ( has_debug_forces )
+                {
+                    DebugForces[ boid_index ].AlignmentForce = alignment_force * params.AlignmentWeight;
+                }
+            }
+            else if ( has_debug_forces )
+            {
+                DebugForces[ boid_index ].AlignmentForce = FVec3( 0.0f );
+            }
+
+            if ( has_separation && neighbor_forces.SeparationBoidsCount > 0 )
+            {
+                auto separation_force = neighbor_forces.SeparationForce / static_cast< float >( neighbor_forces.SeparationBoidsCount );
+                separation_force *= -1.0f;
+                separation_force.Normalize();
+                separation_force *= boid.MaxVelocity;
+                result += separation_force * params.SeparationWeight;
+
+                if ( has_debug_forces )
+                {
+                    DebugForces[ boid_index ].SeparationForce = separation_force * params.SeparationWeight;
+                }
+            }
+            else if ( has_debug_forces )
+            {
+                DebugForces[ boid_index ].SeparationForce = FVec3( 0.0f );
+            }
+
+            result += obstacle_avoidance_force * params.ObstacleAvoidanceWeight;
+
+            if ( has_debug_forces )
+            {
+                DebugForces[ boid_index ].PursuitForce = seek_force * params.PursuitWeight;
+                DebugForces[ boid_index ].ObstacleAvoidanceForce = obstacle_avoidance_force * params.ObstacleAvoidanceWeight;
+            }
+
+            const auto direction = result.GetSafeNormal();
+
+            const auto dot = FVec3::DotProduct( direction, flock.OwnerForwardVector );
+
+            if ( dot < 0.0f )
+            {
+                result += result * -params.NonForwardVelocityBrakingFactor;
+            }
+
+            boid.SteeringVelocity = direction * boid.MaxVelocity;
+        }
+    }
+
+    void FFlockSimulation::Update( FFlockState & state, const FSteeringOptions & options, FSteeringScratch & scratch )
+    {
+        BuildNeighborSearch( state, options );
+        ComputeSteeringVelocities( state, 0, static_cast< int32_t >( state.BoidsToUpdate.size() ), scratch );
+    }
+
+    size_t FFlockSimulation::GetAllocatedSize() const
+    {
+        auto octrees_size = FlocksOctrees.capacity() * sizeof( FFarFieldOctree );
+
+        for ( const auto & octree : FlocksOctrees )
+        {
+            octrees_size += octree.GetAllocatedSize();
+        }
+
+        return SpatialHash.GetAllocatedSize() + NearestNeighborsSpatialHash.GetAllocatedSize() + SoA.GetAllocatedSize() + NeighborLists.GetAllocatedSize() + octrees_size + DebugForces.capacity() * sizeof( FBoidDebugForces ) + FlocksRadii.capacity() * sizeof( FNeighborRadii );
+    }
+}
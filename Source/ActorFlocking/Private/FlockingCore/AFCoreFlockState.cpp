@@ -0,0 +1,46 @@
+#include "FlockingCore/AFCoreFlockState.h"
+
+namespace AFFlockingCore
+{
+    FFlock::FFlock() :
+        OwnerLocation( 0.0f ),
+        OwnerForwardVector( 0.0f ),
+        OwnerVelocity( 0.0f ),
+        FirstBoidIndex( 0 ),
+        BoidsCount( 0 ),
+        BoidsOrderVersion( 0 )
+    {
+    }
+
+    void FFlockState::Reset()
+    {
+        Flocks.clear();
+        Boids.clear();
+        BoidFlockIndices.clear();
+        PursuitOffsetMultipliers.clear();
+        BoidsToUpdate.clear();
+    }
+
+    FFlock & FFlockState::AddFlock( const int32_t boids_count )
+    {
+        const auto flock_index = static_cast< int32_t >( Flocks.size() );
+        const auto first_boid_index = static_cast< int32_t >( Boids.size() );
+
+        Flocks.emplace_back();
+
+        auto & flock = Flocks.back();
+        flock.FirstBoidIndex = first_boid_index;
+        flock.BoidsCount = boids_count;
+
+        Boids.resize( first_boid_index + boids_count );
+        BoidFlockIndices.resize( first_boid_index + boids_count, flock_index );
+        PursuitOffsetMultipliers.resize( first_boid_index + boids_count, 1.0f );
+
+        for ( auto boid_index = first_boid_index; boid_index < first_boid_index + boids_count; ++boid_index )
+        {
+            BoidsToUpdate.push_back( boid_index );
+        }
+
+        return flock;
+    }
+}
@@ -0,0 +1,50 @@
+#include "FlockingCore/AFCoreIntegration.h"
+
+#include <cmath>
+
+namespace AFFlockingCore
+{
+    FVec3 GetAcceleratedVelocity( const FVec3 & velocity, const FVec3 & steering_velocity, const float delta_time, const float max_acceleration )
+    {
+        if ( max_acceleration <= 0.0f )
+        {
+            return steering_velocity;
+        }
+
+        const auto max_velocity_change = max_acceleration * delta_time;
+        const auto velocity_change = steering_velocity - velocity;
+        const auto velocity_change_size_squared = velocity_change.SizeSquared();
+
+        if ( velocity_change_size_squared > Square( max_velocity_change ) )
+        {
+            return velocity + velocity_change * ( max_velocity_change / std::sqrt( velocity_change_size_squared ) );
+        }
+
+        return steering_velocity;
+    }
+
+    void IntegrateBoids( FBoid * boids, const int32_t boids_count, const float delta_time, const float max_acceleration )
+    {
+        for ( auto boid_index = 0; boid_index < boids_count; ++boid_index )
+        {
+            auto & boid = boids[ boid_index ];
+
+            boid.Velocity = GetAcceleratedVelocity( boid.Velocity, boid.SteeringVelocity, delta_time, max_acceleration );
+            boid.Center += boid.Velocity * delta_time;
+        }
+    }
+
+    void AdvanceFixedStep( FFlockState & state, const float step_duration )
+    {
+        for ( auto & boid : state.Boids )
+        {
+            boid.Velocity = boid.SteeringVelocity;
+            boid.Center += boid.Velocity * step_duration;
+        }
+
+        for ( auto & flock : state.Flocks )
+        {
+            flock.OwnerLocation += flock.OwnerVelocity * step_duration;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#include "FlockingCore/AFCoreMortonOrder.h"
+
+#include <algorithm>
+
+namespace AFFlockingCore
+{
+    namespace
+    {
+        constexpr uint32_t MortonCoordinateMax = ( 1u << 10 ) - 1u;
+
+        uint32_t SpreadBits( uint32_t value )
+        {
+            value &= MortonCoordinateMax;
+            value = ( value | ( value << 16 ) ) & 0x030000FFu;
+            value = ( value | ( value << 8 ) ) & 0x0300F00Fu;
+            value = ( value | ( value << 4 ) ) & 0x030C30C3u;
+            value = ( value | ( value << 2 ) ) & 0x09249249u;
+            return value;
+        }
+
+        uint32_t QuantizeCoordinate( const float value, const float minimum, const float inverse_extent )
+        {
+            return static_cast< uint32_t >( Clamp( ( value - minimum ) * inverse_extent, 0.0f, 1.0f ) * static_cast< float >( MortonCoordinateMax ) );
+        }
+    }
+
+    uint32_t EncodeMortonCode( const uint32_t x, const uint32_t y, const uint32_t z )
+    {
+        return SpreadBits( x ) | ( SpreadBits( y ) << 1 ) | ( SpreadBits( z ) << 2 );
+    }
+
+    void SortByMortonCode( int32_t * order, const FVec3 * centers, const int32_t centers_count, std::vector< uint64_t > & keys )
+    {
+        if ( centers_count <= 0 )
+        {
+            return;
+        }
+
+        auto minimum = centers[ 0 ];
+        auto maximum = centers[ 0 ];
+
+        for ( auto index = 1; index < centers_count; ++index )
+        {
+            const auto & center = centers[ index ];
+            minimum = FVec3( std::min( minimum.X, center.X ), std::min( minimum.Y, center.Y ), std::min( minimum.Z, center.Z ) );
+            maximum = FVec3( std::max( maximum.X, center.X ), std::max( maximum.Y, center.Y ), std::max( maximum.Z, center.Z ) );
+        }
+
+        // The same scale on all the axes keeps the cells of the curve cubic
+        const auto extent = std::max( { maximum.X - minimum.X, maximum.Y - minimum.Y, maximum.Z - minimum.Z } );
+        const auto inverse_extent = extent > SmallNumber ? 1.0f / extent : 0.0f;
+
+        keys.resize( centers_count );
+
+        // The index in the low bits makes the sort stable and deterministic
+        for ( auto index = 0; index < centers_count; ++index )
+        {
+            const auto & center = centers[ index ];
+            const auto code = EncodeMortonCode( QuantizeCoordinate( center.X, minimum.X, inverse_extent ), QuantizeCoordinate( center.Y, minimum.Y, inverse_extent ), QuantizeCoordinate( center.Z, minimum.Z, inverse_extent ) );
+            keys[ index ] = ( static_cast< uint64_t >( code ) << 32 ) | static_cast< uint32_t >( index );
+        }
+
+        std::sort( keys.begin(), keys.end() );
+
+        for ( auto index = 0; index < centers_count; ++index )
+        {
+            order[ index ] = static_cast< int32_t >( keys[ index ] & 0xFFFFFFFFu );
+        }
+    }
+}
@@ -0,0 +1,207 @@
+#include "FlockingCore/AFCoreNearestNeighbors.h"
+
+#include "FlockingCore/AFCoreSpatialHashGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace AFFlockingCore
+{
+    namespace
+    {
+        // An isolated boid visits at most this number of shells around its own cell before reaching the biggest radius
+        constexpr int32_t MaxNearestNeighborsShellsCount = 8;
+
+        // Keeps the max_count nearest neighbors seen so far
+        void AddNearestNeighborCandidate( std::vector< std::pair< float, int32_t > > & neighbors, const float distance_squared, const int32_t boid_index, const int32_t max_count )
+        {
+            const auto candidate = std::make_pair( distance_squared, boid_index );
+
+            if ( static_cast< int32_t >( neighbors.size() ) < max_count )
+            {
+                neighbors.push_back( candidate );
+                std::push_heap( neighbors.begin(), neighbors.end() );
+            }
+            else if ( candidate < neighbors.front() )
+            {
+                std::pop_heap( neighbors.begin(), neighbors.end() );
+                neighbors.back() = candidate;
+                std::push_heap( neighbors.begin(), neighbors.end() );
+            }
+        }
+
+        bool HasFoundNearestNeighbors( const std::vector< std::pair< float, int32_t > > & neighbors, const int32_t max_count, const float searched_distance_squared )
+        {
+            return static_cast< int32_t >( neighbors.size() ) == max_count && neighbors.front().first <= searched_distance_squared;
+        }
+
+        void SortByBoidIndex( std::vector< std::pair< float, int32_t > > & neighbors )
+        {
+            std::sort( neighbors.begin(), neighbors.end(), []( const std::pair< float, int32_t > & first, const std::pair< float, int32_t > & second ) {
+                return first.second < second.second;
+            } );
+        }
+
+        void AccumulateSeparation( FNeighborForces & forces, const FVec3 & to_other, const float distance_squared, const FNeighborRadii & radii )
+        {
+            const auto distance = std::sqrt( distance_squared );
+            forces.SeparationForce += to_other * ( 1.0f - Clamp( distance / radii.SeparationRadius, 0.0f, 1.0f ) );
+            forces.SeparationBoidsCount++;
+        }
+    }
+
+    FNearestNeighborsScratch::FNearestNeighborsScratch() :
+        Stamp( 0 )
+    {
+    }
+
+    float GetNearestNeighborsCellSize( const FFlockState & state, const float neighbor_radius, const int32_t max_neighbors_count )
+    {
+        const auto & boids = state.Boids;
+
+        if ( boids.empty() || max_neighbors_count <= 0 )
+        {
+            return neighbor_radius;
+        }
+
+        auto minimum = boids.front().Center;
+        auto maximum = boids.front().Center;
+
+        for ( const auto & boid : boids )
+        {
+            minimum = FVec3( std::min( minimum.X, boid.Center.X ), std::min( minimum.Y, boid.Center.Y ), std::min( minimum.Z, boid.Center.Z ) );
+            maximum = FVec3( std::max( maximum.X, boid.Center.X ), std::max( maximum.Y, boid.Center.Y ), std::max( maximum.Z, boid.Center.Z ) );
+        }
+
+        const auto extent = maximum - minimum;
+        const auto volume = std::max( extent.X, 1.0f ) * std::max( extent.Y, 1.0f ) * std::max( extent.Z, 1.0f );
+        const auto density_cell_size = std::cbrt( volume * static_cast< float >( max_neighbors_count ) / static_cast< float >( boids.size() ) );
+
+        return Clamp( density_cell_size, neighbor_radius / static_cast< float >( MaxNearestNeighborsShellsCount ), neighbor_radius );
+    }
+
+    int32_t AccumulateNearestNeighborForces( FNeighborForces & forces, int64_t & neighbor_candidates_count, const int32_t boid_index, const FFlockState & state, const FSpatialHashGrid & spatial_hash, const FNeighborRadii & radii, const int32_t max_neighbors_count, const bool separate_from_other_flocks, FNearestNeighborsScratch & scratch )
+    {
+        const auto & boids = state.Boids;
+        const auto & boid = boids[ boid_index ];
+        const auto flock_index = state.BoidFlockIndices[ boid_index ];
+        const auto & sorted_boid_indices = spatial_hash.GetSortedBoidIndices();
+        const auto cell_size = spatial_hash.GetCellSize();
+        const auto same_flock_radius = std::max( radii.AlignmentRadius, std::max( radii.CohesionRadius, radii.SeparationRadius ) );
+        const auto same_flock_radius_squared = Square( same_flock_radius );
+        const auto other_flocks_radius_squared = separate_from_other_flocks ? Square( radii.SeparationRadius ) : 0.0f;
+
+        auto & same_flock_neighbors = scratch.SameFlockNeighbors;
+        auto & other_flocks_neighbors = scratch.OtherFlocksNeighbors;
+        same_flock_neighbors.clear();
+        other_flocks_neighbors.clear();
+
+        if ( scratch.VisitedBucketsStamps.size() != spatial_hash.GetBucketsCount() )
+        {
+            scratch.VisitedBucketsStamps.assign( spatial_hash.GetBucketsCount(), 0u );
+            scratch.Stamp = 0u;
+        }
+
+        if ( ++scratch.Stamp == 0u )
+        {
+            std::fill( scratch.VisitedBucketsStamps.begin(), scratch.VisitedBucketsStamps.end(), 0u );
+            scratch.Stamp = 1u;
+        }
+
+        auto pair_tests_count = 0;
+
+        for ( auto shell = 0; static_cast< float >( shell - 1 ) * cell_size < same_flock_radius; ++shell )
+        {
+            spatial_hash.ForEachBucketInShell( boid.Center, shell, [ & ]( const uint32_t bucket_index, const int32_t first, const int32_t last ) {
+                if ( scratch.VisitedBucketsStamps[ bucket_index ] == scratch.Stamp )
+                {
+                    return;
+                }
+
+                scratch.VisitedBucketsStamps[ bucket_index ] = scratch.Stamp;
+                neighbor_candidates_count += last - first;
+                pair_tests_count += last - first;
+
+                for ( auto sorted_index = first; sorted_index < last; ++sorted_index )
+                {
+                    const auto other_boid_index = sorted_boid_indices[ sorted_index ];
+
+                    if ( other_boid_index == boid_index )
+                    {
+                        continue;
+                    }
+
+                    const auto distance_squared = ( boids[ other_boid_index ].Center - boid.Center ).SizeSquared();
+
+                    if ( state.BoidFlockIndices[ other_boid_index ] == flock_index )
+                    {
+                        if ( distance_squared < same_flock_radius_squared )
+                        {
+                            AddNearestNeighborCandidate( same_flock_neighbors, distance_squared, other_boid_index, max_neighbors_count );
+                        }
+                    }
+                    else if ( distance_squared < other_flocks_radius_squared )
+                    {
+                        AddNearestNeighborCandidate( other_flocks_neighbors, distance_squared, other_boid_index, max_neighbors_count );
+                    }
+                }
+            } );
+
+            // The boids of the next shells are at least shell * cell_size away
+            const auto searched_distance_squared = Square( static_cast< float >( shell ) * cell_size );
+
+            if ( HasFoundNearestNeighbors( same_flock_neighbors, max_neighbors_count, searched_distance_squared )
+                 && ( !separate_from_other_flocks || HasFoundNearestNeighbors( other_flocks_neighbors, max_neighbors_count, searched_distance_squared ) ) )
+            {
+                break;
+            }
+        }
+
+        // The k nearest boids within a radius are the ones of the k nearest boids within the biggest radius which are within that radius
+        SortByBoidIndex( same_flock_neighbors );
+
+        for ( const auto & neighbor : same_flock_neighbors )
+        {
+            const auto & other_boid = boids[ neighbor.second ];
+            const auto distance_squared = neighbor.first;
+
+            if ( distance_squared < Square( radii.AlignmentRadius ) )
+            {
+                forces.AlignmentForce += other_boid.Velocity;
+                forces.AlignmentBoidsCount++;
+            }
+
+            if ( distance_squared < Square( radii.CohesionRadius ) )
+            {
+                forces.CohesionForce += other_boid.Center;
+                forces.CohesionBoidsCount++;
+            }
+
+            if ( !separate_from_other_flocks && distance_squared < Square( radii.SeparationRadius ) )
+            {
+                AccumulateSeparation( forces, other_boid.Center - boid.Center, distance_squared, radii );
+            }
+        }
+
+        // With the other flocks, the separation uses the nearest boids of all the flocks
+        if ( separate_from_other_flocks )
+        {
+            for ( const auto & neighbor : same_flock_neighbors )
+            {
+                if ( neighbor.first < Square( radii.SeparationRadius ) )
+                {
+                    AddNearestNeighborCandidate( other_flocks_neighbors, neighbor.first, neighbor.second, max_neighbors_count );
+                }
+            }
+
+            SortByBoidIndex( other_flocks_neighbors );
+
+            for ( const auto & neighbor : other_flocks_neighbors )
+            {
+                AccumulateSeparation( forces, boids[ neighbor.second ].Center - boid.Center, neighbor.first, radii );
+            }
+        }
+
+        return pair_tests_count;
+    }
+}
@@ -0,0 +1,77 @@
+#include "FlockingCore/AFCoreNeighborForces.h"
+
+namespace AFFlockingCore
+{
+    FNeighborForces::FNeighborForces() :
+        AlignmentForce( 0.0f ),
+        CohesionForce( 0.0f ),
+        SeparationForce( 0.0f ),
+        AlignmentBoidsCount( 0 ),
+        CohesionBoidsCount( 0 ),
+        SeparationBoidsCount( 0 )
+    {
+    }
+
+    template < uint32_t _FEATURES_ >
+    int32_t AccumulateNeighborForces( FNeighborForces & forces, const int32_t boid_index, const FFlockState & state, const int32_t * candidates, const int32_t candidates_count, const FNeighborRadii & radii, const bool separate_from_other_flocks )
+    {
+        const auto & boids = state.Boids;
+        const auto & boid = boids[ boid_index ];
+        const auto flock_index = state.BoidFlockIndices[ boid_index ];
+
+        for ( auto candidate_index = 0; candidate_index < candidates_count; ++candidate_index )
+        {
+            const auto other_boid_index = candidates[ candidate_index ];
+
+            if ( other_boid_index == boid_index )
+            {
+                continue;
+            }
+
+            const auto is_same_flock = state.BoidFlockIndices[ other_boid_index ] == flock_index;
+
+            if ( !is_same_flock && !separate_from_other_flocks )
+            {
+                continue;
+            }
+
+            const auto & other_boid = boids[ other_boid_index ];
+            const auto to_other = other_boid.Center - boid.Center;
+            const auto distance = to_other.Size();
+
+            if ( ( _FEATURES_ & ESteeringFeatures::Alignment ) != 0 && is_same_flock && distance < radii.AlignmentRadius )
+            {
+                forces.AlignmentForce += other_boid.Velocity;
+                forces.AlignmentBoidsCount++;
+            }
+
+            if ( ( _FEATURES_ & ESteeringFeatures::Cohesion ) != 0 && is_same_flock && distance < radii.CohesionRadius )
+            {
+                forces.CohesionForce += other_boid.Center;
+                forces.CohesionBoidsCount++;
+            }
+
+            if ( ( _FEATURES_ & ESteeringFeatures::Separation ) != 0 && distance < radii.SeparationRadius )
+            {
+                forces.SeparationForce += to_other * ( 1.0f - Clamp( distance / radii.SeparationRadius, 0.0f, 1.0f ) );
+                forces.SeparationBoidsCount++;
+            }
+        }
+
+        return candidates_count;
+    }
+
+#define AF_CORE_INSTANTIATE_NEIGHBOR_FORCES( _FEATURES_ ) \
+    template int32_t AccumulateNeighborForces< _FEATURES_ >( FNeighborForces &, int32_t, const FFlockState &, const int32_t *, int32_t, const FNeighborRadii &, bool );
+
+    AF_CORE_INSTANTIATE_NEIGHBOR_FORCES( 0u )
+    AF_CORE_INSTANTIATE_NEIGHBOR_FORCES( 1u )
+    AF_CORE_INSTANTIATE_NEIGHBOR_FORCES( 2u )
+    AF_CORE_INSTANTIATE_NEIGHBOR_FORCES( 3u )
+    AF_CORE_INSTANTIATE_NEIGHBOR_FORCES( 4u )
+    AF_CORE_INSTANTIATE_NEIGHBOR_FORCES( 5u )
+    AF_CORE_INSTANTIATE_NEIGHBOR_FORCES( 6u )
+    AF_CORE_INSTANTIATE_NEIGHBOR_FORCES( 7u )
+
+#undef AF_CORE_INSTANTIATE_NEIGHBOR_FORCES
+}
@@ -0,0 +1,98 @@
+#include "FlockingCore/AFCoreNeighborLists.h"
+
+#include "FlockingCore/AFCoreSpatialHashGrid.h"
+
+#include <algorithm>
+
+namespace AFFlockingCore
+{
+    FNeighborLists::FNeighborLists() :
+        CutoffRadius( 0.0f )
+    {
+    }
+
+    bool FNeighborLists::IsValidFor( const FFlockState & state, const float neighbor_radius ) const
+    {
+        const auto & boids = state.Boids;
+
+        if ( ReferenceCenters.size() != boids.size() || FlocksBoidsOrderVersions.size() != state.Flocks.size() || neighbor_radius >= CutoffRadius )
+        {
+            return false;
+        }
+
+        for ( auto flock_index = 0; flock_index < static_cast< int32_t >( state.Flocks.size() ); ++flock_index )
+        {
+            if ( state.Flocks[ flock_index ].BoidsOrderVersion != FlocksBoidsOrderVersions[ flock_index ] )
+            {
+                return false;
+            }
+        }
+
+        // Two boids moving toward each other both use half of the margin
+        const auto max_displacement_squared = Square( 0.5f * ( CutoffRadius - neighbor_radius ) );
+
+        for ( auto boid_index = 0; boid_index < static_cast< int32_t >( boids.size() ); ++boid_index )
+        {
+            if ( ( boids[ boid_index ].Center - ReferenceCenters[ boid_index ] ).SizeSquared() > max_displacement_squared )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void FNeighborLists::Build( const FFlockState & state, const FSpatialHashGrid & spatial_hash, const float cutoff_radius )
+    {
+        const auto & boids = state.Boids;
+        const auto boids_count = static_cast< int32_t >( boids.size() );
+        const auto & sorted_boid_indices = spatial_hash.GetSortedBoidIndices();
+        const auto cutoff_radius_squared = Square( cutoff_radius );
+
+        CutoffRadius = cutoff_radius;
+        ReferenceCenters.resize( boids_count );
+        FlocksBoidsOrderVersions.resize( state.Flocks.size() );
+
+        for ( auto flock_index = 0; flock_index < static_cast< int32_t >( state.Flocks.size() ); ++flock_index )
+        {
+            FlocksBoidsOrderVersions[ flock_index ] = state.Flocks[ flock_index ].BoidsOrderVersion;
+        }
+        Offsets.resize( boids_count + 1 );
+        Neighbors.clear();
+
+        for ( auto boid_index = 0; boid_index < boids_count; ++boid_index )
+        {
+            const auto center = boids[ boid_index ].Center;
+            const auto first_neighbor = static_cast< int32_t >( Neighbors.size() );
+
+            ReferenceCenters[ boid_index ] = center;
+            Offsets[ boid_index ] = first_neighbor;
+
+            spatial_hash.ForEachBucketAround( center, [ & ]( const int32_t first, const int32_t last ) {
+                for ( auto sorted_index = first; sorted_index < last; ++sorted_index )
+                {
+                    const auto other_boid_index = sorted_boid_indices[ sorted_index ];
+
+                    if ( other_boid_index != boid_index && ( boids[ other_boid_index ].Center - center ).SizeSquared() < cutoff_radius_squared )
+                    {
+                        Neighbors.push_back( other_boid_index );
+                    }
+                }
+            } );
+
+            std::sort( Neighbors.begin() + first_neighbor, Neighbors.end() );
+        }
+
+        Offsets[ boids_count ] = static_cast< int32_t >( Neighbors.size() );
+    }
+
+    float FNeighborLists::GetAverageLength() const
+    {
+        return ReferenceCenters.empty() ? 0.0f : static_cast< float >( Neighbors.size() ) / static_cast< float >( ReferenceCenters.size() );
+    }
+
+    size_t FNeighborLists::GetAllocatedSize() const
+    {
+        return ReferenceCenters.capacity() * sizeof( FVec3 ) + ( Offsets.capacity() + Neighbors.capacity() ) * sizeof( int32_t ) + FlocksBoidsOrderVersions.capacity() * sizeof( uint32_t );
+    }
+}
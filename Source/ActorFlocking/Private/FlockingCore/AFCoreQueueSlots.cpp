@@ -0,0 +1,111 @@
+#include "FlockingCore/AFCoreQueueSlots.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace AFFlockingCore
+{
+    namespace
+    {
+        // Equal keys keep the order of their indices, so the assignment does not depend on the sort implementation
+        void SortIndicesByKey( std::vector< int32_t > & indices, const float * keys, const int32_t count )
+        {
+            indices.resize( count );
+            std::iota( indices.begin(), indices.end(), 0 );
+            std::sort( indices.begin(), indices.end(), [ keys ]( const int32_t first_index, const int32_t second_index ) {
+                return keys[ first_index ] < keys[ second_index ] || ( keys[ first_index ] == keys[ second_index ] && first_index < second_index );
+            } );
+        }
+    }
+
+    int32_t FQueueSlots::Num() const
+    {
+        return static_cast< int32_t >( Positions.size() );
+    }
+
+    int32_t FQueueSlots::GetPosition( const int32_t boid_index ) const
+    {
+        return Positions[ boid_index ];
+    }
+
+    int32_t FQueueSlots::GetBoidIndex( const int32_t position ) const
+    {
+        return BoidIndices[ position ];
+    }
+
+    void FQueueSlots::Add()
+    {
+        const auto index = Num();
+        Positions.push_back( index );
+        BoidIndices.push_back( index );
+    }
+
+    int32_t FQueueSlots::Remove( const int32_t boid_index )
+    {
+        const auto removed_position = Positions[ boid_index ];
+        const auto last_index = Num() - 1;
+
+        for ( auto position = removed_position; position < last_index; ++position )
+        {
+            BoidIndices[ position ] = BoidIndices[ position + 1 ];
+            Positions[ BoidIndices[ position ] ] = position;
+        }
+
+        BoidIndices.pop_back();
+
+        if ( boid_index != last_index )
+        {
+            Positions[ boid_index ] = Positions[ last_index ];
+            BoidIndices[ Positions[ boid_index ] ] = boid_index;
+        }
+
+        Positions.pop_back();
+        return removed_position;
+    }
+
+    void FQueueSlots::SwapPositions( const int32_t first_position, const int32_t second_position )
+    {
+        std::swap( BoidIndices[ first_position ], BoidIndices[ second_position ] );
+        Positions[ BoidIndices[ first_position ] ] = first_position;
+        Positions[ BoidIndices[ second_position ] ] = second_position;
+    }
+
+    int32_t FQueueSlots::GetPositionAround( const int32_t position, const int32_t min_distance, const int32_t max_distance, const float random_ratio ) const
+    {
+        // The candidates are in two ranges, before and after position, clamped to the queue
+        const auto closest_distance = std::max( 1, min_distance );
+        const auto first_before = std::max( 0, position - max_distance );
+        const auto before_count = std::max( 0, position - closest_distance - first_before + 1 );
+        const auto first_after = position + closest_distance;
+        const auto after_count = std::max( 0, std::min( Num() - 1, position + max_distance ) - first_after + 1 );
+        const auto candidates_count = before_count + after_count;
+
+        if ( candidates_count == 0 )
+        {
+            return -1;
+        }
+
+        const auto candidate_index = std::min( static_cast< int32_t >( random_ratio * static_cast< float >( candidates_count ) ), candidates_count - 1 );
+
+        return candidate_index < before_count
+                   ? first_before + candidate_index
+                   : first_after + candidate_index - before_count;
+    }
+
+    void FQueueSlots::AssignPositionsByProximity( const float * boid_targets, const float * position_targets )
+    {
+        const auto count = Num();
+
+        SortIndicesByKey( SortedBoidIndices, boid_targets, count );
+        SortIndicesByKey( SortedPositions, position_targets, count );
+
+        for ( auto index = 0; index < count; ++index )
+        {
+            const auto boid_index = SortedBoidIndices[ index ];
+            const auto position = SortedPositions[ index ];
+
+            Positions[ boid_index ] = position;
+            BoidIndices[ position ] = boid_index;
+        }
+    }
+}
@@ -0,0 +1,352 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+/* Minimal 4 wide float vector used by the neighbor kernel : SSE2 on x86, NEON on ARM64, and a scalar fallback everywhere else.
+ * Define AF_CORE_DISABLE_SIMD to force the scalar fallback.
+ */
+#if !defined( AF_CORE_DISABLE_SIMD ) && ( defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) )
+    #define AF_CORE_SIMD_SSE 1
+    #include <emmintrin.h>
+#elif !defined( AF_CORE_DISABLE_SIMD ) && ( defined( __aarch64__ ) || defined( _M_ARM64 ) )
+    #define AF_CORE_SIMD_NEON 1
+    #include <arm_neon.h>
+#endif
+
+namespace AFFlockingCore
+{
+    namespace Simd
+    {
+        constexpr int32_t Width = 4;
+
+#if defined( AF_CORE_SIMD_SSE )
+
+        typedef __m128 FFloat4;
+
+        inline FFloat4 Load( const float * values )
+        {
+            return _mm_loadu_ps( values );
+        }
+
+        inline FFloat4 Set1( const float value )
+        {
+            return _mm_set1_ps( value );
+        }
+
+        inline FFloat4 Set( const float x, const float y, const float z, const float w )
+        {
+            return _mm_setr_ps( x, y, z, w );
+        }
+
+        inline FFloat4 Zero()
+        {
+            return _mm_setzero_ps();
+        }
+
+        inline FFloat4 Add( const FFloat4 first, const FFloat4 second )
+        {
+            return _mm_add_ps( first, second );
+        }
+
+        inline FFloat4 Subtract( const FFloat4 first, const FFloat4 second )
+        {
+            return _mm_sub_ps( first, second );
+        }
+
+        inline FFloat4 Multiply( const FFloat4 first, const FFloat4 second )
+        {
+            return _mm_mul_ps( first, second );
+        }
+
+        // first * second + third
+        inline FFloat4 MultiplyAdd( const FFloat4 first, const FFloat4 second, const FFloat4 third )
+        {
+            return _mm_add_ps( _mm_mul_ps( first, second ), third );
+        }
+
+        inline FFloat4 Min( const FFloat4 first, const FFloat4 second )
+        {
+            return _mm_min_ps( first, second );
+        }
+
+        inline FFloat4 Sqrt( const FFloat4 value )
+        {
+            return _mm_sqrt_ps( value );
+        }
+
+        inline FFloat4 CompareLess( const FFloat4 first, const FFloat4 second )
+        {
+            return _mm_cmplt_ps( first, second );
+        }
+
+        inline FFloat4 CompareEqual( const FFloat4 first, const FFloat4 second )
+        {
+            return _mm_cmpeq_ps( first, second );
+        }
+
+        inline FFloat4 CompareNotEqual( const FFloat4 first, const FFloat4 second )
+        {
+            return _mm_cmpneq_ps( first, second );
+        }
+
+        inline FFloat4 And( const FFloat4 first, const FFloat4 second )
+        {
+            return _mm_and_ps( first, second );
+        }
+
+        inline bool AnyLane( const FFloat4 mask )
+        {
+            return _mm_movemask_ps( mask ) != 0;
+        }
+
+        inline void Store( const FFloat4 value, float * values )
+        {
+            _mm_storeu_ps( values, value );
+        }
+
+#elif defined( AF_CORE_SIMD_NEON )
+
+        typedef float32x4_t FFloat4;
+
+        inline FFloat4 Load( const float * values )
+        {
+            return vld1q_f32( values );
+        }
+
+        inline FFloat4 Set1( const float value )
+        {
+            return vdupq_n_f32( value );
+        }
+
+        inline FFloat4 Set( const float x, const float y, const float z, const float w )
+        {
+            const float values[ 4 ] = { x, y, z, w };
+            return vld1q_f32( values );
+        }
+
+        inline FFloat4 Zero()
+        {
+            return vdupq_n_f32( 0.0f );
+        }
+
+        inline FFloat4 Add( const FFloat4 first, const FFloat4 second )
+        {
+            return vaddq_f32( first, second );
+        }
+
+        inline FFloat4 Subtract( const FFloat4 first, const FFloat4 second )
+        {
+            return vsubq_f32( first, second );
+        }
+
+        inline FFloat4 Multiply( const FFloat4 first, const FFloat4 second )
+        {
+            return vmulq_f32( first, second );
+        }
+
+        // first * second + third. Not fused, to give the same result as the other implementations
+        inline FFloat4 MultiplyAdd( const FFloat4 first, const FFloat4 second, const FFloat4 third )
+        {
+            return vaddq_f32( vmulq_f32( first, second ), third );
+        }
+
+        inline FFloat4 Min( const FFloat4 first, const FFloat4 second )
+        {
+            return vminq_f32( first, second );
+        }
+
+        inline FFloat4 Sqrt( const FFloat4 value )
+        {
+            return vsqrtq_f32( value );
+        }
+
+        inline FFloat4 CompareLess( const FFloat4 first, const FFloat4 second )
+        {
+            return vreinterpretq_f32_u32( vcltq_f32( first, second ) );
+        }
+
+        inline FFloat4 CompareEqual( const FFloat4 first, const FFloat4 second )
+        {
+            return vreinterpretq_f32_u32( vceqq_f32( first, second ) );
+        }
+
+        inline FFloat4 CompareNotEqual( const FFloat4 first, const FFloat4 second )
+        {
+            return vreinterpretq_f32_u32( vmvnq_u32( vceqq_f32( first, second ) ) );
+        }
+
+        inline FFloat4 And( const FFloat4 first, const FFloat4 second )
+        {
+            return vreinterpretq_f32_u32( vandq_u32( vreinterpretq_u32_f32( first ), vreinterpretq_u32_f32( second ) ) );
+        }
+
+        inline bool AnyLane( const FFloat4 mask )
+        {
+            return vmaxvq_u32( vreinterpretq_u32_f32( mask ) ) != 0;
+        }
+
+        inline void Store( const FFloat4 value, float * values )
+        {
+            vst1q_f32( values, value );
+        }
+
+#else
+
+        struct FFloat4
+        {
+            float Lanes[ 4 ];
+        };
+
+        namespace Private
+        {
+            inline float MaskToFloat( const bool value )
+            {
+                union
+                {
+                    uint32_t Bits;
+                    float Value;
+                } mask;
+
+                mask.Bits = value ? 0xFFFFFFFFu : 0u;
+                return mask.Value;
+            }
+
+            inline uint32_t FloatToBits( const float value )
+            {
+                union
+                {
+                    uint32_t Bits;
+                    float Value;
+                } mask;
+
+                mask.Value = value;
+                return mask.Bits;
+            }
+
+            template < typename _OPERATION_ >
+            inline FFloat4 Map( const FFloat4 first, const FFloat4 second, const _OPERATION_ & operation )
+            {
+                return FFloat4 { { operation( first.Lanes[ 0 ], second.Lanes[ 0 ] ),
+                    operation( first.Lanes[ 1 ], second.Lanes[ 1 ] ),
+                    operation( first.Lanes[ 2 ], second.Lanes[ 2 ] ),
+                    operation( first.Lanes[ 3 ], second.Lanes[ 3 ] ) } };
+            }
+        }
+
+        inline FFloat4 Load( const float * values )
+        {
+            return FFloat4 { { values[ 0 ], values[ 1 ], values[ 2 ], values[ 3 ] } };
+        }
+
+        inline FFloat4 Set1( const float value )
+        {
+            return FFloat4 { { value, value, value, value } };
+        }
+
+        inline FFloat4 Set( const float x, const float y, const float z, const float w )
+        {
+            return FFloat4 { { x, y, z, w } };
+        }
+
+        inline FFloat4 Zero()
+        {
+            return Set1( 0.0f );
+        }
+
+        inline FFloat4 Add( const FFloat4 first, const FFloat4 second )
+        {
+            return Private::Map( first, second, []( const float a, const float b ) {
+                return a + b;
+            } );
+        }
+
+        inline FFloat4 Subtract( const FFloat4 first, const FFloat4 second )
+        {
+            return Private::Map( first, second, []( const float a, const float b ) {
+                return a - b;
+            } );
+        }
+
+        inline FFloat4 Multiply( const FFloat4 first, const FFloat4 second )
+        {
+            return Private::Map( first, second, []( const float a, const float b ) {
+                return a * b;
+            } );
+        }
+
+        inline FFloat4 MultiplyAdd( const FFloat4 first, const FFloat4 second, const FFloat4 third )
+        {
+            return Add( Multiply( first, second ), third );
+        }
+
+        inline FFloat4 Min( const FFloat4 first, const FFloat4 second )
+        {
+            return Private::Map( first, second, []( const float a, const float b ) {
+                return a < b ? a : b;
+            } );
+        }
+
+        inline FFloat4 Sqrt( const FFloat4 value )
+        {
+            return FFloat4 { { std::sqrt( value.Lanes[ 0 ] ), std::sqrt( value.Lanes[ 1 ] ), std::sqrt( value.Lanes[ 2 ] ), std::sqrt( value.Lanes[ 3 ] ) } };
+        }
+
+        inline FFloat4 CompareLess( const FFloat4 first, const FFloat4 second )
+        {
+            return Private::Map( first, second, []( const float a, const float b ) {
+                return Private::MaskToFloat( a < b );
+            } );
+        }
+
+        inline FFloat4 CompareEqual( const FFloat4 first, const FFloat4 second )
+        {
+            return Private::Map( first, second, []( const float a, const float b ) {
+                return Private::MaskToFloat( a == b );
+            } );
+        }
+
+        inline FFloat4 CompareNotEqual( const FFloat4 first, const FFloat4 second )
+        {
+            return Private::Map( first, second, []( const float a, const float b ) {
+                return Private::MaskToFloat( a != b );
+            } );
+        }
+
+        inline FFloat4 And( const FFloat4 first, const FFloat4 second )
+        {
+            return Private::Map( first, second, []( const float a, const float b ) {
+                union
+                {
+                    uint32_t Bits;
+                    float Value;
+                } result;
+
+                result.Bits = Private::FloatToBits( a ) & Private::FloatToBits( b );
+                return result.Value;
+            } );
+        }
+
+        inline bool AnyLane( const FFloat4 mask )
+        {
+            return ( Private::FloatToBits( mask.Lanes[ 0 ] ) | Private::FloatToBits( mask.Lanes[ 1 ] ) | Private::FloatToBits( mask.Lanes[ 2 ] ) | Private::FloatToBits( mask.Lanes[ 3 ] ) ) != 0;
+        }
+
+        inline void Store( const FFloat4 value, float * values )
+        {
+            values[ 0 ] = value.Lanes[ 0 ];
+            values[ 1 ] = value.Lanes[ 1 ];
+            values[ 2 ] = value.Lanes[ 2 ];
+            values[ 3 ] = value.Lanes[ 3 ];
+        }
+
+#endif
+
+        inline float HorizontalSum( const FFloat4 value )
+        {
+            float lanes[ 4 ];
+            Store( value, lanes );
+            return ( lanes[ 0 ] + lanes[ 1 ] ) + ( lanes[ 2 ] + lanes[ 3 ] );
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#include "FlockingCore/AFCoreSpatialHashGrid.h"
+
+#include <algorithm>
+
+namespace AFFlockingCore
+{
+    namespace
+    {
+        uint32_t RoundUpToPowerOfTwo( const uint32_t value )
+        {
+            auto result = 1u;
+
+            while ( result < value )
+            {
+                result <<= 1;
+            }
+
+            return result;
+        }
+    }
+
+    FSpatialHashGrid::FSpatialHashGrid() :
+        InverseCellSize( 0.0f ),
+        BucketMask( 0 )
+    {
+    }
+
+    void FSpatialHashGrid::Build( const std::vector< FBoid > & boids, const float cell_size )
+    {
+        const auto boids_count = static_cast< int32_t >( boids.size() );
+
+        InverseCellSize = cell_size > 0.0f ? 1.0f / cell_size : 0.0f;
+
+        // Twice as many buckets as boids keeps the hash collisions low without wasting too much memory
+        const auto bucket_count = RoundUpToPowerOfTwo( static_cast< uint32_t >( std::max( 2 * boids_count, 1 ) ) );
+        BucketMask = bucket_count - 1;
+
+        BucketStarts.assign( bucket_count + 1, 0 );
+        BoidBuckets.resize( boids_count );
+        SortedBoidIndices.resize( boids_count );
+
+        for ( auto boid_index = 0; boid_index < boids_count; ++boid_index )
+        {
+            const auto cell_coordinates = GetCellCoordinates( boids[ boid_index ].Center );
+            const auto bucket_index = GetBucketIndex( cell_coordinates.X, cell_coordinates.Y, cell_coordinates.Z );
+            BoidBuckets[ boid_index ] = bucket_index;
+            ++BucketStarts[ bucket_index ];
+        }
+
+        for ( uint32_t bucket_index = 1; bucket_index < bucket_count; ++bucket_index )
+        {
+            BucketStarts[ bucket_index ] += BucketStarts[ bucket_index - 1 ];
+        }
+
+        BucketStarts[ bucket_count ] = boids_count;
+
+        // Walk the boids backwards so each bucket ends up sorted in ascending boid index order
+        for ( auto boid_index = boids_count - 1; boid_index >= 0; --boid_index )
+        {
+            SortedBoidIndices[ --BucketStarts[ BoidBuckets[ boid_index ] ] ] = boid_index;
+        }
+    }
+
+    void FSpatialHashGrid::GatherCandidates( const FVec3 & location, std::vector< int32_t > & candidates ) const
+    {
+        candidates.clear();
+
+        ForEachBucketAround( location, [ this, &candidates ]( const int32_t first, const int32_t last ) {
+            candidates.insert( candidates.end(), SortedBoidIndices.begin() + first, SortedBoidIndices.begin() + last );
+        } );
+
+        // Keep the same accumulation order as a brute force loop over the flock
+        std::sort( candidates.begin(), candidates.end() );
+    }
+
+    size_t FSpatialHashGrid::GetAllocatedSize() const
+    {
+        return BucketStarts.capacity() * sizeof( int32_t )
+               + SortedBoidIndices.capacity() * sizeof( int32_t )
+               + BoidBuckets.capacity() * sizeof( uint32_t );
+    }
+}
@@ -0,0 +1,174 @@
+#include "FlockingCore/AFCoreSyntheticFlocks.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace AFFlockingCore
+{
+    namespace
+    {
+        // Flocks are spread along the X axis, half overlapping their neighbors
+        FVec3 GetFlockOrigin( const int32_t flock_index, const float flock_radius )
+        {
+            return FVec3( static_cast< float >( flock_index ) * flock_radius, 0.0f, 0.0f );
+        }
+
+        float GetFlockRadius( const int32_t boids_count, const FSyntheticFlocksParams & params )
+        {
+            return std::cbrt( 3.0f * static_cast< float >( boids_count ) / ( 4.0f * 3.14159265f ) ) * params.BoidSpacing;
+        }
+    }
+
+    FSyntheticRandom::FSyntheticRandom( const uint32_t seed ) :
+        State( 0u ),
+        Increment( ( static_cast< uint64_t >( seed ) << 1u ) | 1u )
+    {
+        Next();
+        State += seed;
+        Next();
+    }
+
+    uint32_t FSyntheticRandom::Next()
+    {
+        const auto old_state = State;
+        State = old_state * 6364136223846793005ull + Increment;
+        const auto xor_shifted = static_cast< uint32_t >( ( ( old_state >> 18u ) ^ old_state ) >> 27u );
+        const auto rotation = static_cast< uint32_t >( old_state >> 59u );
+        return ( xor_shifted >> rotation ) | ( xor_shifted << ( ( 32u - rotation ) & 31u ) );
+    }
+
+    float FSyntheticRandom::Range( const float min_value, const float max_value )
+    {
+        return min_value + ( max_value - min_value ) * static_cast< float >( Next() >> 8 ) * ( 1.0f / 16777216.0f );
+    }
+
+    FVec3 FSyntheticRandom::PointInSphere( const float radius )
+    {
+        for ( ;; )
+        {
+            const FVec3 point( Range( -1.0f, 1.0f ), Range( -1.0f, 1.0f ), Range( -1.0f, 1.0f ) );
+
+            if ( point.SizeSquared() <= 1.0f )
+            {
+                return point * radius;
+            }
+        }
+    }
+
+    FSyntheticFlocksParams::FSyntheticFlocksParams() :
+        FlocksCount( 1 ),
+        Seed( 12345u ),
+        BoidSpacing( 150.0f ),
+        bUseLOD( false )
+    {
+    }
+
+    FFlockState MakeSyntheticFlocks( const int32_t boids_count, const FSyntheticFlocksParams & params )
+    {
+        FSyntheticRandom random( params.Seed + static_cast< uint32_t >( boids_count ) );
+        FFlockState state;
+
+        for ( auto flock_index = 0; flock_index < params.FlocksCount; ++flock_index )
+        {
+            const auto flock_boids_count = boids_count / params.FlocksCount + ( flock_index < boids_count % params.FlocksCount ? 1 : 0 );
+            const auto flock_radius = GetFlockRadius( flock_boids_count, params );
+            const auto flock_origin = GetFlockOrigin( flock_index, flock_radius );
+            auto & flock = state.AddFlock( flock_boids_count );
+            flock.LOD.bEnabled = params.bUseLOD;
+            flock.Params = params.Params;
+
+            for ( auto boid_index = flock.FirstBoidIndex; boid_index < flock.FirstBoidIndex + flock.BoidsCount; ++boid_index )
+            {
+                auto & boid = state.Boids[ boid_index ];
+                boid.MaxVelocity = random.Range( 400.0f, 600.0f );
+                boid.Center = flock_origin + random.PointInSphere( flock_radius );
+                boid.Velocity = random.PointInSphere( 1.0f ).GetSafeNormal() * ( boid.MaxVelocity * 0.5f );
+                boid.SteeringVelocity = FVec3( 0.0f );
+                boid.PreviousSteeringVelocity = FVec3( 0.0f );
+            }
+        }
+
+        return state;
+    }
+
+    void UpdateSyntheticOwners( FFlockState & state, const float time, const FSyntheticFlocksParams & params )
+    {
+        const auto circle_radius = 5000.0f;
+        const auto angular_speed = 0.1f;
+        const auto angle = time * angular_speed;
+
+        for ( auto flock_index = 0; flock_index < static_cast< int32_t >( state.Flocks.size() ); ++flock_index )
+        {
+            auto & flock = state.Flocks[ flock_index ];
+            const auto flock_origin = GetFlockOrigin( flock_index, GetFlockRadius( flock.BoidsCount, params ) );
+
+            flock.OwnerLocation = flock_origin + FVec3( std::cos( angle ), std::sin( angle ), 0.0f ) * circle_radius;
+            flock.OwnerForwardVector = FVec3( -std::sin( angle ), std::cos( angle ), 0.0f );
+            flock.OwnerVelocity = flock.OwnerForwardVector * ( circle_radius * angular_speed );
+        }
+    }
+
+    double GetCentersChecksum( const FFlockState & state )
+    {
+        auto checksum = 0.0;
+
+        for ( const auto & boid : state.Boids )
+        {
+            checksum += static_cast< double >( boid.Center.X ) + static_cast< double >( boid.Center.Y ) + static_cast< double >( boid.Center.Z );
+        }
+
+        return checksum;
+    }
+
+    double GetSteeringChecksum( const FFlockState & state )
+    {
+        auto checksum = 0.0;
+
+        for ( const auto boid_index : state.BoidsToUpdate )
+        {
+            const auto & steering_velocity = state.Boids[ boid_index ].SteeringVelocity;
+            checksum += static_cast< double >( steering_velocity.X ) + static_cast< double >( steering_velocity.Y ) + static_cast< double >( steering_velocity.Z );
+        }
+
+        return checksum;
+    }
+
+    FSteeringError GetSteeringError( const FFlockState & state, const FFlockState & reference_state )
+    {
+        FSteeringError error { 0.0, 0.0 };
+        const auto boids_count = static_cast< int32_t >( state.Boids.size() );
+
+        for ( auto boid_index = 0; boid_index < boids_count; ++boid_index )
+        {
+            const auto & boid = state.Boids[ boid_index ];
+            const auto boid_error = static_cast< double >( ( boid.SteeringVelocity - reference_state.Boids[ boid_index ].SteeringVelocity ).Size() / boid.MaxVelocity );
+            error.MeanError += boid_error;
+            error.MaxError = std::max( error.MaxError, boid_error );
+        }
+
+        error.MeanError /= static_cast< double >( std::max( 1, boids_count ) );
+        return error;
+    }
+
+    FSteeringError MeasureFarFieldError( const int32_t boids_count, const FSyntheticFlocksParams & params, const FSteeringOptions & options )
+    {
+        auto far_field_params = params;
+        far_field_params.Params.bUseFarFieldOctree = true;
+        auto state = MakeSyntheticFlocks( boids_count, far_field_params );
+        UpdateSyntheticOwners( state, 0.0f, far_field_params );
+
+        auto exact_state = state;
+
+        for ( auto & flock : exact_state.Flocks )
+        {
+            flock.Params.bUseFarFieldOctree = false;
+        }
+
+        FFlockSimulation simulation;
+        FSteeringScratch scratch;
+        simulation.Update( state, options, scratch );
+        simulation.Update( exact_state, options, scratch );
+
+        return GetSteeringError( state, exact_state );
+    }
+}
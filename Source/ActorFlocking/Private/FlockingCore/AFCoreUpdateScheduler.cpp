@@ -0,0 +1,142 @@
+#include "FlockingCore/AFCoreUpdateScheduler.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace AFFlockingCore
+{
+    namespace
+    {
+        // Weight of the last reported duration in the cost estimates
+        constexpr double CostSmoothingFactor = 0.1;
+
+        double SmoothCost( const double current_cost, const double new_cost )
+        {
+            return current_cost > 0.0
+                       ? current_cost + ( new_cost - current_cost ) * CostSmoothingFactor
+                       : new_cost;
+        }
+    }
+
+    FSchedulerCounters::FSchedulerCounters() :
+        LODBoidsCounts {},
+        DeferredBoidsCount( 0 ),
+        UpdatedBoidsCount( 0 )
+    {
+    }
+
+    FUpdateScheduler::FUpdateScheduler() :
+        BuildNeighborSearchMicroseconds( 0.0 ),
+        MicrosecondsPerBoid( 0.0 ),
+        FrameIndex( 0 )
+    {
+    }
+
+    FSchedulerCounters FUpdateScheduler::Schedule( FFlockState & state, const std::vector< FVec3 > & viewer_locations, const float budget_microseconds )
+    {
+        FSchedulerCounters counters;
+
+        DueBoidIndices.clear();
+
+        for ( const auto & flock : state.Flocks )
+        {
+            for ( auto boid_index = flock.FirstBoidIndex; boid_index < flock.FirstBoidIndex + flock.BoidsCount; ++boid_index )
+            {
+                const auto & boid = state.Boids[ boid_index ];
+                const auto lod_level = GetLODLevel( flock.LOD, boid.Center, viewer_locations );
+
+                ++counters.LODBoidsCounts[ lod_level ];
+
+                // The boid index offsets the frame where each boid is due, to spread the updates over the interval.
+                // Boids which missed their frame, because of the budget or because they changed of level, are due until they get updated
+                const auto update_interval = static_cast< uint32_t >( flock.LOD.UpdateIntervals[ lod_level ] );
+
+                if ( ( FrameIndex + static_cast< uint32_t >( boid_index ) ) % update_interval == 0
+                     || boid.FramesSinceUpdate >= static_cast< int32_t >( update_interval ) )
+                {
+                    DueBoidIndices.push_back( boid_index );
+                }
+            }
+        }
+
+        const auto due_boids_count = static_cast< int32_t >( DueBoidIndices.size() );
+        auto updated_boids_count = due_boids_count;
+
+        // Until a first update has been measured, there is no way to know how many boids fit in the budget
+        if ( budget_microseconds > 0.0f && MicrosecondsPerBoid > 0.0 )
+        {
+            const auto available_microseconds = static_cast< double >( budget_microseconds ) - BuildNeighborSearchMicroseconds;
+            const auto affordable_boids_count = static_cast< int32_t >( std::min( available_microseconds / MicrosecondsPerBoid, static_cast< double >( std::numeric_limits< int32_t >::max() ) ) );
+
+            // Always update at least one boid, so the flocks make progress even with a budget too small
+            updated_boids_count = std::min( updated_boids_count, std::max( affordable_boids_count, 1 ) );
+
+            if ( updated_boids_count < due_boids_count )
+            {
+                std::nth_element( DueBoidIndices.begin(), DueBoidIndices.begin() + updated_boids_count, DueBoidIndices.end(), [ &state ]( const int32_t first, const int32_t second ) {
+                    const auto first_frames = state.Boids[ first ].FramesSinceUpdate;
+                    const auto second_frames = state.Boids[ second ].FramesSinceUpdate;
+                    return first_frames != second_frames ? first_frames > second_frames : first < second;
+                } );
+
+                DueBoidIndices.resize( updated_boids_count );
+
+                // Keep the memory order of the boids for the update
+                std::sort( DueBoidIndices.begin(), DueBoidIndices.end() );
+            }
+        }
+
+        counters.UpdatedBoidsCount = updated_boids_count;
+        counters.DeferredBoidsCount = due_boids_count - updated_boids_count;
+
+        for ( auto & boid : state.Boids )
+        {
+            boid.FramesSinceUpdate = std::min( boid.FramesSinceUpdate, NeverUpdated - 1 ) + 1;
+        }
+
+        for ( const auto boid_index : DueBoidIndices )
+        {
+            state.Boids[ boid_index ].FramesSinceUpdate = 0;
+        }
+
+        state.BoidsToUpdate.assign( DueBoidIndices.begin(), DueBoidIndices.end() );
+        ++FrameIndex;
+
+        return counters;
+    }
+
+    void FUpdateScheduler::ReportUpdateDuration( const int32_t updated_boids_count, const double build_neighbor_search_microseconds, const double compute_steering_microseconds )
+    {
+        BuildNeighborSearchMicroseconds = SmoothCost( BuildNeighborSearchMicroseconds, build_neighbor_search_microseconds );
+
+        if ( updated_boids_count > 0 )
+        {
+            MicrosecondsPerBoid = SmoothCost( MicrosecondsPerBoid, compute_steering_microseconds / static_cast< double >( updated_boids_count ) );
+        }
+    }
+
+    int32_t FUpdateScheduler::GetLODLevel( const FLODParams & lod_params, const FVec3 & location, const std::vector< FVec3 > & viewer_locations ) const
+    {
+        // Without viewer, for example on a dedicated server without players, everything stays at full rate
+        if ( !lod_params.bEnabled || viewer_locations.empty() )
+        {
+            return 0;
+        }
+
+        auto closest_distance_squared = std::numeric_limits< float >::max();
+
+        for ( const auto & viewer_location : viewer_locations )
+        {
+            closest_distance_squared = std::min( closest_distance_squared, ( viewer_location - location ).SizeSquared() );
+        }
+
+        auto lod_level = 0;
+
+        while ( lod_level + 1 < LODLevelsCount && closest_distance_squared >= Square( lod_params.MinDistances[ lod_level + 1 ] ) )
+        {
+            ++lod_level;
+        }
+
+        return lod_level;
+    }
+}
@@ -0,0 +1,488 @@
+#include "AFBoidMovementComponent.h"
+#include "AFFlockingComponent.h"
+#include "AFFlockingCoreConversions.h"
+#include "FlockingCore/AFCoreIntegration.h"
+#include "FlockingCore/AFCoreSyntheticFlocks.h"
+
+#include <Algo/Find.h>
+#include <Components/SceneComponent.h>
+#include <Engine/Engine.h>
+#include <Engine/World.h>
+#include <HAL/PlatformTime.h>
+#include <Misc/AutomationTest.h>
+#include <Misc/CommandLine.h>
+#include <Misc/ConfigCacheIni.h>
+#include <Misc/FileHelper.h>
+#include <Misc/Parse.h>
+#include <Misc/Paths.h>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Declared as a friend of the flocking component, to reach the functions the tests drive without making them public
+struct FAFFlockingComponentTestAccess
+{
+    static FAFFlockSettings & GetFlockSettings( UAFFlockingComponent & flocking_component )
+    {
+        return flocking_component.FlockSettings;
+    }
+
+    static void RandomSwapBoidsPositions( UAFFlockingComponent & flocking_component )
+    {
+        flocking_component.RandomSwapBoidsPositions();
+    }
+};
+
+/* Regression tests of the flocking simulation, runnable headless with :
+ * UE4Editor-Cmd <Project>.uproject -nullrhi -unattended -ExecCmds="Automation RunTests ActorFlocking; Quit"
+ * The steering tests run the synthetic flocks of the standalone benchmark and compare the result with the checksums it prints.
+ * The performance tests compare the median duration of a tick with the baselines saved in Config/FlockingPerformanceBaselines.ini.
+ */
+
+namespace
+{
+    constexpr int32 TestedBoidsCounts[] = { 10, 100, 1000, 5000 };
+
+    // The scalar kernel is an order of magnitude slower than the SIMD kernel, so it is only compared on the small flocks
+    constexpr int32 MaxScalarKernelBoidsCount = 1000;
+
+    constexpr int32 GoldenTicksCount = 100;
+    // The steering velocities are compared with the scalar reference kernel every this number of ticks
+    constexpr int32 ReferenceTicksInterval = 10;
+    constexpr float DeltaTime = 1.0f / 60.0f;
+
+    struct FAFGoldenChecksum
+    {
+        int32 BoidsCount;
+        double CentersChecksum;
+    };
+
+    // Printed by FlockingBenchmark --sizes 10,100,1000,5000 --ticks 100. Must only be updated by a change expected to modify the steering
+    constexpr FAFGoldenChecksum GoldenChecksums[] = {
+        { 10, 12169.555 },
+        { 100, 109820.090 },
+        { 1000, 1141966.377 },
+        { 5000, 5681560.236 },
+    };
+
+    const TCHAR * const SettingsSection = TEXT( "ActorFlocking.PerformanceTests" );
+    const TCHAR * const BaselinesSection = TEXT( "Baselines" );
+
+    // Read from the [ActorFlocking.PerformanceTests] section of the game config
+    struct FAFPerformanceTestsSettings
+    {
+        FAFPerformanceTestsSettings() :
+            TicksCount( 120 ),
+            WarmupTicksCount( 10 ),
+            MaxRegressionPercent( 25.0f ),
+            GoldenTolerance( 0.0001f ),
+            GoldenMaxSteeringDifference( 0.5f ),
+            FarFieldMaxMeanError( 0.0001f ),
+            FarFieldMaxError( 0.005f )
+        {
+            GConfig->GetInt( SettingsSection, TEXT( "TicksCount" ), TicksCount, GGameIni );
+            GConfig->GetInt( SettingsSection, TEXT( "WarmupTicksCount" ), WarmupTicksCount, GGameIni );
+            GConfig->GetFloat( SettingsSection, TEXT( "MaxRegressionPercent" ), MaxRegressionPercent, GGameIni );
+            GConfig->GetFloat( SettingsSection, TEXT( "GoldenTolerance" ), GoldenTolerance, GGameIni );
+            GConfig->GetFloat( SettingsSection, TEXT( "GoldenMaxSteeringDifference" ), GoldenMaxSteeringDifference, GGameIni );
+            GConfig->GetFloat( SettingsSection, TEXT( "FarFieldMaxMeanError" ), FarFieldMaxMeanError, GGameIni );
+            GConfig->GetFloat( SettingsSection, TEXT( "FarFieldMaxError" ), FarFieldMaxError, GGameIni );
+
+            WarmupTicksCount = FMath::Max( 0, WarmupTicksCount );
+            TicksCount = FMath::Max( WarmupTicksCount + 1, TicksCount );
+        }
+
+        int32 TicksCount;
+        // The first ticks fill the caches and grow the arrays, and are not compared with the baselines
+        int32 WarmupTicksCount;
+        // A median duration longer than the baseline by more than this percentage fails the test
+        float MaxRegressionPercent;
+        // Relative difference allowed with the golden checksums, as the SIMD and scalar kernels, and the math libraries of the platforms, round differently
+        float GoldenTolerance;
+        // Largest difference, in cm/s, allowed between the steering velocity of a boid and the one of the scalar reference kernel computed from the same state
+        float GoldenMaxSteeringDifference;
+        /* Errors allowed for the steering velocities computed with the far field octree, relative to the max velocity. The octree is exact,
+         * but it sums the neighbors in another order, which slightly changes the boids whose forces almost cancel out */
+        float FarFieldMaxMeanError;
+        float FarFieldMaxError;
+    };
+
+    void GetBoidsCountsTests( TArray< FString > & out_beautified_names, TArray< FString > & out_test_commands )
+    {
+        for ( const auto boids_count : TestedBoidsCounts )
+        {
+            out_beautified_names.Add( FString::Printf( TEXT( "%d boids" ), boids_count ) );
+            out_test_commands.Add( FString::FromInt( boids_count ) );
+        }
+    }
+
+    double GetMicrosecondsSince( const uint64 start_cycles )
+    {
+        return FPlatformTime::ToMilliseconds64( FPlatformTime::Cycles64() - start_cycles ) * 1000.0;
+    }
+
+    // Largest difference between the steering velocity of a boid of state and the one computed by the scalar reference kernel from the same inputs
+    float GetMaxReferenceSteeringDifference( const AFFlockingCore::FFlockState & state, AFFlockingCore::FFlockSimulation & reference_simulation )
+    {
+        AFFlockingCore::FSteeringOptions reference_options;
+        reference_options.bUseVectorizedKernel = false;
+
+        auto reference_state = state;
+        AFFlockingCore::FSteeringScratch scratch;
+        reference_simulation.Update( reference_state, reference_options, scratch );
+
+        auto max_difference = 0.0f;
+
+        for ( auto boid_index = 0; boid_index < static_cast< int32 >( state.Boids.size() ); ++boid_index )
+        {
+            const auto difference = ( state.Boids[ boid_index ].SteeringVelocity - reference_state.Boids[ boid_index ].SteeringVelocity ).Size();
+            max_difference = FMath::Max( max_difference, difference );
+        }
+
+        return max_difference;
+    }
+
+    /* Runs the synthetic flocks of the benchmark through the steering update of the flocking component, and returns the checksum of the final centers of the boids.
+     * The boids directly use their steering velocity, so the centers depend on the steering velocities of every tick.
+     * When max_reference_difference is given, it receives the largest difference with the scalar reference kernel, measured every ReferenceTicksInterval ticks */
+    double RunSyntheticFlocks( const int32 boids_count, const int32 ticks_count, const FAFFlockingPerformance & performance, TArray< double > * tick_durations, float * max_reference_difference = nullptr )
+    {
+        const AFFlockingCore::FSyntheticFlocksParams params;
+
+        FAFFlockSimulationFrame frame;
+        frame.Performance = performance;
+        frame.State = AFFlockingCore::MakeSyntheticFlocks( boids_count, params );
+
+        AFFlockingCore::FFlockSimulation reference_simulation;
+
+        if ( max_reference_difference != nullptr )
+        {
+            *max_reference_difference = 0.0f;
+        }
+
+        for ( auto tick_index = 0; tick_index < ticks_count; ++tick_index )
+        {
+            AFFlockingCore::UpdateSyntheticOwners( frame.State, static_cast< float >( tick_index ) * DeltaTime, params );
+
+            const auto start_cycles = FPlatformTime::Cycles64();
+            frame.UpdateBoidsSteeringVelocity();
+
+            if ( tick_durations != nullptr )
+            {
+                tick_durations->Add( GetMicrosecondsSince( start_cycles ) );
+            }
+
+            if ( max_reference_difference != nullptr && ( tick_index + 1 ) % ReferenceTicksInterval == 0 )
+            {
+                *max_reference_difference = FMath::Max( *max_reference_difference, GetMaxReferenceSteeringDifference( frame.State, reference_simulation ) );
+            }
+
+            AFFlockingCore::IntegrateBoids( frame.State.Boids.data(), boids_count, DeltaTime, 0.0f );
+        }
+
+        return AFFlockingCore::GetCentersChecksum( frame.State );
+    }
+
+    FString GetBaselinesPath()
+    {
+        return FPaths::ProjectConfigDir() / TEXT( "FlockingPerformanceBaselines.ini" );
+    }
+
+    /* Saves the duration of each tick in Saved/Profiling/Flocking/PerformanceTests/name.csv, and compares their median with the baseline of name.
+     * Running the tests with -UpdateFlockingBaselines saves the median as the new baseline instead */
+    void CheckTickDurations( FAutomationTestBase & test, const FString & name, const TArray< double > & tick_durations, const FAFPerformanceTestsSettings & settings )
+    {
+        auto csv = FString( TEXT( "Tick,Microseconds\n" ) );
+
+        for ( auto tick_index = 0; tick_index < tick_durations.Num(); ++tick_index )
+        {
+            csv += FString::Printf( TEXT( "%d,%.2f\n" ), tick_index, tick_durations[ tick_index ] );
+        }
+
+        FFileHelper::SaveStringToFile( csv, *( FPaths::ProfilingDir() / TEXT( "Flocking" ) / TEXT( "PerformanceTests" ) / name + TEXT( ".csv" ) ) );
+
+        TArray< double > measured_durations( tick_durations.GetData() + settings.WarmupTicksCount, tick_durations.Num() - settings.WarmupTicksCount );
+        measured_durations.Sort();
+
+        const auto median = measured_durations[ measured_durations.Num() / 2 ];
+        const auto baselines_path = GetBaselinesPath();
+
+        FConfigFile baselines;
+        baselines.Read( baselines_path );
+
+        if ( FParse::Param( FCommandLine::Get(), TEXT( "UpdateFlockingBaselines" ) ) )
+        {
+            baselines.SetString( BaselinesSection, *name, *FString::Printf( TEXT( "%.2f" ), median ) );
+            baselines.Write( baselines_path );
+            test.AddInfo( FString::Printf( TEXT( "%s : baseline set to %.2f us per tick" ), *name, median ) );
+            return;
+        }
+
+        FString baseline_string;
+        const auto baseline = baselines.GetString( BaselinesSection, *name, baseline_string ) ? FCString::Atod( *baseline_string ) : 0.0;
+
+        if ( baseline <= 0.0 )
+        {
+            test.AddError( FString::Printf( TEXT( "%s : %.2f us per tick. No baseline in %s, run the tests with -UpdateFlockingBaselines to save one" ), *name, median, *baselines_path ) );
+            return;
+        }
+
+        const auto change_percent = ( median / baseline - 1.0 ) * 100.0;
+        const auto message = FString::Printf( TEXT( "%s : %.2f us per tick, %+.1f%% against the baseline of %.2f us" ), *name, median, change_percent, baseline );
+
+        if ( change_percent > settings.MaxRegressionPercent )
+        {
+            test.AddError( message );
+        }
+        else
+        {
+            test.AddInfo( message );
+        }
+    }
+
+    UWorld * CreateTestWorld()
+    {
+        auto * world = UWorld::CreateWorld( EWorldType::Game, false, TEXT( "FlockingPerformanceTest" ) );
+        auto & world_context = GEngine->CreateNewWorldContext( EWorldType::Game );
+        world_context.SetCurrentWorld( world );
+
+        world->InitializeActorsForPlay( FURL() );
+        world->BeginPlay();
+        return world;
+    }
+
+    void DestroyTestWorld( UWorld * world )
+    {
+        GEngine->DestroyWorldContext( world );
+        world->DestroyWorld( false );
+    }
+
+    AActor * SpawnActorWithRoot( UWorld * world, const FVector & location )
+    {
+        auto * actor = world->SpawnActor< AActor >();
+        auto * root = NewObject< USceneComponent >( actor );
+        actor->SetRootComponent( root );
+        root->RegisterComponent();
+        actor->SetActorLocation( location );
+        return actor;
+    }
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST( FAFFlockingSteeringGoldenTest, "ActorFlocking.Steering.Golden", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter )
+
+void FAFFlockingSteeringGoldenTest::GetTests( TArray< FString > & out_beautified_names, TArray< FString > & out_test_commands ) const
+{
+    GetBoidsCountsTests( out_beautified_names, out_test_commands );
+}
+
+bool FAFFlockingSteeringGoldenTest::RunTest( const FString & parameters )
+{
+    const auto boids_count = FCString::Atoi( *parameters );
+    const auto * golden_checksum = Algo::FindBy( GoldenChecksums, boids_count, &FAFGoldenChecksum::BoidsCount );
+
+    if ( golden_checksum == nullptr )
+    {
+        AddError( FString::Printf( TEXT( "No golden checksum for %d boids" ), boids_count ) );
+        return false;
+    }
+
+    const FAFPerformanceTestsSettings settings;
+    FAFFlockingPerformance performance;
+
+    for ( const auto use_vectorized_kernel : { true, false } )
+    {
+        if ( !use_vectorized_kernel && boids_count > MaxScalarKernelBoidsCount )
+        {
+            continue;
+        }
+
+        performance.bUseVectorizedSteering = use_vectorized_kernel;
+
+        // The scalar kernel is the reference, so only the SIMD kernel is compared with it
+        auto max_reference_difference = 0.0f;
+        const auto checksum = RunSyntheticFlocks( boids_count, GoldenTicksCount, performance, nullptr, use_vectorized_kernel ? &max_reference_difference : nullptr );
+
+        if ( max_reference_difference > settings.GoldenMaxSteeringDifference )
+        {
+            AddError( FString::Printf( TEXT( "SIMD kernel : steering velocities up to %.4f cm/s away from the scalar reference kernel, instead of %.4f" ), max_reference_difference, settings.GoldenMaxSteeringDifference ) );
+        }
+
+        const auto relative_error = FMath::Abs( checksum - golden_checksum->CentersChecksum ) / FMath::Max( FMath::Abs( golden_checksum->CentersChecksum ), 1.0 );
+
+        if ( relative_error > settings.GoldenTolerance )
+        {
+            AddError( FString::Printf( TEXT( "%s kernel : checksum %.3f instead of %.3f" ), use_vectorized_kernel ? TEXT( "SIMD" ) : TEXT( "Scalar" ), checksum, golden_checksum->CentersChecksum ) );
+        }
+    }
+
+    return true;
+}
+
+/* Compares the steering velocities computed with the far field octree with the ones of the spatial hash, with radii which cover a large part of the flocks */
+IMPLEMENT_COMPLEX_AUTOMATION_TEST( FAFFlockingFarFieldTest, "ActorFlocking.Steering.FarField", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter )
+
+void FAFFlockingFarFieldTest::GetTests( TArray< FString > & out_beautified_names, TArray< FString > & out_test_commands ) const
+{
+    GetBoidsCountsTests( out_beautified_names, out_test_commands );
+}
+
+bool FAFFlockingFarFieldTest::RunTest( const FString & parameters )
+{
+    const auto boids_count = FCString::Atoi( *parameters );
+    const FAFPerformanceTestsSettings settings;
+
+    AFFlockingCore::FSyntheticFlocksParams params;
+    params.Params.AlignmentRadius = 1000.0f;
+    params.Params.CohesionRadius = 1000.0f;
+
+    const auto error = AFFlockingCore::MeasureFarFieldError( boids_count, params, AFFlockingCore::FSteeringOptions() );
+    const auto message = FString::Printf( TEXT( "Far field error : mean %.4f%%, max %.4f%% of the max velocity" ), error.MeanError * 100.0, error.MaxError * 100.0 );
+
+    if ( error.MeanError > settings.FarFieldMaxMeanError || error.MaxError > settings.FarFieldMaxError )
+    {
+        AddError( message );
+    }
+    else
+    {
+        AddInfo( message );
+    }
+
+    return true;
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST( FAFFlockingSteeringPerformanceTest, "ActorFlocking.Performance.Steering", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter )
+
+void FAFFlockingSteeringPerformanceTest::GetTests( TArray< FString > & out_beautified_names, TArray< FString > & out_test_commands ) const
+{
+    GetBoidsCountsTests( out_beautified_names, out_test_commands );
+}
+
+bool FAFFlockingSteeringPerformanceTest::RunTest( const FString & parameters )
+{
+    const auto boids_count = FCString::Atoi( *parameters );
+    const FAFPerformanceTestsSettings settings;
+
+    TArray< double > tick_durations;
+    RunSyntheticFlocks( boids_count, settings.TicksCount, FAFFlockingPerformance(), &tick_durations );
+
+    CheckTickDurations( *this, FString::Printf( TEXT( "Steering_%d" ), boids_count ), tick_durations, settings );
+    return true;
+}
+
+/* Parks the owner of a small flock until the flock falls asleep, then moves the owner, which must wake the flock up */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST( FAFFlockingSleepTest, "ActorFlocking.Sleep", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter )
+
+bool FAFFlockingSleepTest::RunTest( const FString & /*parameters*/ )
+{
+    constexpr int32 BoidsCount = 10;
+    constexpr int32 MaxTicksCount = 600;
+
+    auto * world = CreateTestWorld();
+    auto * owner = SpawnActorWithRoot( world, FVector::ZeroVector );
+    auto * flocking_component = NewObject< UAFFlockingComponent >( owner );
+    flocking_component->RegisterComponent();
+    flocking_component->SetSleepEnabled( true );
+
+    const auto synthetic_state = AFFlockingCore::MakeSyntheticFlocks( BoidsCount, AFFlockingCore::FSyntheticFlocksParams() );
+
+    for ( const auto & boid : synthetic_state.Boids )
+    {
+        auto * boid_actor = SpawnActorWithRoot( world, ToVector( boid.Center ) );
+        auto * movement_component = NewObject< UAFBoidMovementComponent >( boid_actor );
+        movement_component->RegisterComponent();
+        movement_component->SetUpdatedComponent( boid_actor->GetRootComponent() );
+        flocking_component->RegisterMovementComponent( movement_component );
+    }
+
+    // The owner stays parked, so the boids gather around their pursuit target
+    for ( auto tick_index = 0; tick_index < MaxTicksCount && !flocking_component->IsSleeping(); ++tick_index )
+    {
+        flocking_component->TickComponent( DeltaTime, LEVELTICK_All, &flocking_component->PrimaryComponentTick );
+    }
+
+    TestTrue( TEXT( "The flock of a parked owner falls asleep" ), flocking_component->IsSleeping() );
+
+    owner->SetActorLocation( FVector( 1000.0f, 0.0f, 0.0f ) );
+
+    TestFalse( TEXT( "Moving the owner wakes the flock up" ), flocking_component->IsSleeping() );
+
+    DestroyTestWorld( world );
+    return true;
+}
+
+/* Spawns an owner and its boids, which use UAFBoidMovementComponent and are moved by the flock, and measures the tick of the flocking component and the swaps of the boids */
+IMPLEMENT_COMPLEX_AUTOMATION_TEST( FAFFlockingComponentPerformanceTest, "ActorFlocking.Performance.Component", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter )
+
+void FAFFlockingComponentPerformanceTest::GetTests( TArray< FString > & out_beautified_names, TArray< FString > & out_test_commands ) const
+{
+    GetBoidsCountsTests( out_beautified_names, out_test_commands );
+}
+
+bool FAFFlockingComponentPerformanceTest::RunTest( const FString & parameters )
+{
+    const auto boids_count = FCString::Atoi( *parameters );
+    const FAFPerformanceTestsSettings settings;
+    auto * world = CreateTestWorld();
+
+    // The swaps pick their boids with FMath::RandRange
+    FMath::RandInit( boids_count );
+
+    auto * owner = SpawnActorWithRoot( world, FVector::ZeroVector );
+    auto * flocking_component = NewObject< UAFFlockingComponent >( owner );
+    flocking_component->RegisterComponent();
+
+    // Each call swaps 2.5 to 5% of the boids with a boid close to them in the queue. The world does not tick, so the swaps only run when the test calls them
+    auto & flock_settings = FAFFlockingComponentTestAccess::GetFlockSettings( *flocking_component );
+    flock_settings.bAllowSwapPositions = true;
+    flock_settings.SwapPositionDistanceInterval = FInt32Interval( 1, 10 );
+    flock_settings.SwapPositionBoidCountInterval = FInt32Interval( FMath::Max( 1, boids_count / 40 ), FMath::Max( 1, boids_count / 20 ) );
+
+    // The boids start where the synthetic flocks of the steering tests start
+    const auto synthetic_state = AFFlockingCore::MakeSyntheticFlocks( boids_count, AFFlockingCore::FSyntheticFlocksParams() );
+    TArray< UAFBoidMovementComponent * > movement_components;
+
+    for ( const auto & boid : synthetic_state.Boids )
+    {
+        auto * boid_actor = SpawnActorWithRoot( world, ToVector( boid.Center ) );
+        auto * movement_component = NewObject< UAFBoidMovementComponent >( boid_actor );
+        movement_component->RegisterComponent();
+        movement_component->SetUpdatedComponent( boid_actor->GetRootComponent() );
+        movement_component->Velocity = ToVector( boid.Velocity );
+
+        flocking_component->RegisterMovementComponent( movement_component );
+        movement_components.Add( movement_component );
+    }
+
+    TArray< double > tick_durations;
+    TArray< double > swap_durations;
+
+    for ( auto tick_index = 0; tick_index < settings.TicksCount; ++tick_index )
+    {
+        // The sleep is disabled by default, so the flock is simulated every tick
+        owner->SetActorLocation( FVector( static_cast< float >( tick_index ) * DeltaTime * 500.0f, 0.0f, 0.0f ) );
+
+        auto start_cycles = FPlatformTime::Cycles64();
+        flocking_component->TickComponent( DeltaTime, LEVELTICK_All, &flocking_component->PrimaryComponentTick );
+        tick_durations.Add( GetMicrosecondsSince( start_cycles ) );
+
+        start_cycles = FPlatformTime::Cycles64();
+        FAFFlockingComponentTestAccess::RandomSwapBoidsPositions( *flocking_component );
+        swap_durations.Add( GetMicrosecondsSince( start_cycles ) );
+    }
+
+    for ( const auto * movement_component : movement_components )
+    {
+        if ( movement_component->Velocity.ContainsNaN() )
+        {
+            AddError( FString::Printf( TEXT( "The boid %s has an invalid velocity" ), *movement_component->GetOwner()->GetName() ) );
+            break;
+        }
+    }
+
+    CheckTickDurations( *this, FString::Printf( TEXT( "TickComponent_%d" ), boids_count ), tick_durations, settings );
+    CheckTickDurations( *this, FString::Printf( TEXT( "RandomSwapBoidsPositions_%d" ), boids_count ), swap_durations, settings );
+
+    DestroyTestWorld( world );
+    return true;
+}
+
+#endif
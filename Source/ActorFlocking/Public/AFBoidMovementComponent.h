@@ -0,0 +1,56 @@
+#pragma once
+
+#include <CoreMinimal.h>
+#include <GameFramework/MovementComponent.h>
+
+#include "AFBoidMovementComponent.generated.h"
+
+/* Movement component dedicated to the boids of a flock, much cheaper than a flying UCharacterMovementComponent.
+ * The flocking component writes the steering velocity of the boid, and the component integrates it without floor logic nor network prediction.
+ * The moves are not swept, except every CollisionSweepInterval seconds. By default, the flocking component moves all its boids in a single loop, and the tick of this component is disabled.
+ */
+UCLASS( ClassGroup = Movement, meta = ( BlueprintSpawnableComponent ) )
+class ACTORFLOCKING_API UAFBoidMovementComponent final : public UMovementComponent
+{
+    GENERATED_BODY()
+
+public:
+    UAFBoidMovementComponent();
+
+    float GetMaxSpeed() const override;
+    void TickComponent( float delta_time, ELevelTick tick_type, FActorComponentTickFunction * this_tick_function ) override;
+
+    // Velocity the boid goes toward, limited by MaxAcceleration. Written by the flocking component the boid is registered to
+    void SetSteeringVelocity( const FVector & steering_velocity );
+
+    /* Called by the flocking component when the boid is registered and unregistered. When the flock moves the boid, the tick of the component is disabled.
+     * Returns false if the boid keeps moving on its own tick */
+    bool SetMovedByFlock( bool moved_by_flock );
+
+    // Integrates the steering velocity and moves the updated component. Returns true if the move was swept
+    bool MoveBoid( float delta_time );
+
+private:
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.0" ) )
+    float MaxSpeed;
+
+    /* How fast the velocity goes toward the steering velocity. 0 applies the steering velocity instantly, like RequestDirectMove does for the flying characters */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.0" ) )
+    float MaxAcceleration;
+
+    /* When positive, a move is swept against the world every this duration, in seconds, and slides along what it hits. The moves in between are not swept,
+     * so the boids can go through thin obstacles : combine it with the obstacle avoidance of the flock. 0 never sweeps */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.0" ) )
+    float CollisionSweepInterval;
+
+    UPROPERTY( EditAnywhere )
+    uint8 bRotationFollowsVelocity : 1;
+
+    /* Let the flocking component the boid is registered to move it, with all its other boids in a single loop, instead of ticking this component */
+    UPROPERTY( EditAnywhere )
+    uint8 bAllowFlockMoves : 1;
+
+    FVector SteeringVelocity;
+    float TimeSinceSweep;
+    bool bIsMovedByFlock;
+};
@@ -1,13 +1,32 @@
 #pragma once
 
+#include <Async/TaskGraphInterfaces.h>
 #include <Components/ActorComponent.h>
+#include <Components/LineBatchComponent.h>
 #include <CoreMinimal.h>
 #include <Engine/DataAsset.h>
+#include <Engine/EngineBaseTypes.h>
+#include <Engine/EngineTypes.h>
+#include <Engine/NetSerialization.h>
+#include <WorldCollision.h>
+
+#include "FlockingCore/AFCoreFixedTimestep.h"
+#include "FlockingCore/AFCoreFlockQuantization.h"
+#include "FlockingCore/AFCoreFlockRecorder.h"
+#include "FlockingCore/AFCoreFlockSimulation.h"
+#include "FlockingCore/AFCoreQueueSlots.h"
+#include "FlockingCore/AFCoreUpdateScheduler.h"
 
 #include "AFFlockingComponent.generated.h"
 
-class UCharacterMovementComponent;
+class ACharacter;
+class UAFBoidMovementComponent;
+class UAFFlockingSubsystem;
 class UCurveFloat;
+class UInstancedStaticMeshComponent;
+class UMovementComponent;
+class USceneComponent;
+class UStaticMesh;
 
 USTRUCT()
 struct FAFFlockSettings
@@ -17,6 +36,8 @@ struct FAFFlockSettings
     FAFFlockSettings();
 
     void LerpBetween( const FAFFlockSettings & start, const FAFFlockSettings & end, float ratio );
+    AFFlockingCore::FFlockParams GetParams() const;
+    void SetParams( const AFFlockingCore::FFlockParams & params );
 
     /* How much of the steering force computed to follow the owner is kept */
     UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.0" ) )
@@ -58,6 +79,38 @@ struct FAFFlockSettings
     UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.0" ) )
     float SeparationRadius;
 
+    /* When positive, each force only takes into account this number of nearest boids within its radius, like starlings which react to their 6 or 7 nearest neighbors.
+     * This bounds the cost of each boid when the flock bunches up, where all the boids are within the radii of each other. 0 takes into account all the boids within the radii */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0" ) )
+    int32 MaxNeighborsCount;
+
+    /* Computes alignment and cohesion with an octree of the flock instead of testing every boid within their radii. The result is the same.
+     * It tests far fewer boids when the radii cover most of a big flock, but each test is slower than with the vectorized kernel : with 10000 boids and radii of 1000,
+     * the benchmark measured it 6 times faster than the scalar kernel, and 1.5 times slower than the vectorized kernel. Ignored when MaxNeighborsCount is positive */
+    UPROPERTY( EditAnywhere )
+    uint8 bUseFarFieldOctree : 1;
+
+    /* How much of the steering force computed to make boids move away from the obstacles in front of them is kept. 0 disables the obstacle traces */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.0" ) )
+    float ObstacleAvoidanceWeight;
+
+    /* Length of the traces done along the velocity of the boids to detect the obstacles. The closer the obstacle, the stronger the force */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.0" ) )
+    float ObstacleTraceDistance;
+
+    /* Channel of the obstacle traces */
+    UPROPERTY( EditAnywhere )
+    TEnumAsByte< ECollisionChannel > ObstacleTraceChannel;
+
+    /* Maximum number of asynchronous obstacle traces per tick. The boids are traced in turn : with 1000 boids and 50 traces, each boid is traced every 20 ticks.
+     * The results arrive the next tick */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0" ) )
+    int32 MaxObstacleTracesPerTick;
+
+    /* Time after which an obstacle detected by a trace only has half of its effect, so the boids keep avoiding it between two of their traces */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.01" ) )
+    float ObstacleMemoryHalfLife;
+
     /* Allows to create groups of boids. The X-Axis is the boid index. The Y-Axis is the multiplier to PursuitDistanceBehind.
      * You will most likely configure the curve to use constant interpolation, to have steps between values.
      * For example, if you set a value to the coordinates (0;1) and a value to the coordinates (3;2),
@@ -74,9 +127,9 @@ struct FAFFlockSettings
     UPROPERTY( EditAnywhere, meta = ( EditCondition = "bAllowSwapPositions", UIMin = "0", ClampMin = "0" ) )
     FFloatInterval SwapPositionDelayInterval;
 
-    /* Distance interval between boids to swap.
-     * For example, if the minimum is set to 2, and the maximum to 4, and the first selected boid is at index 4,
-     * only boids at index 0,1,2,6,7,8 would be eligible for a swap
+    /* Distance interval between the positions in the queue of the boids to swap.
+     * For example, if the minimum is set to 2, and the maximum to 4, and the first selected boid is at position 4,
+     * only boids at positions 0,1,2,6,7,8 would be eligible for a swap
      */
     UPROPERTY( EditAnywhere, meta = ( EditCondition = "bAllowSwapPositions", UIMin = "1", ClampMin = "1" ) )
     FInt32Interval SwapPositionDistanceInterval;
@@ -104,6 +157,102 @@ public:
     FAFFlockSettings Settings;
 };
 
+/* Distance based levels of detail : the boids far from all the player cameras compute their steering velocity less often, and reuse the last one in between */
+USTRUCT()
+struct FAFFlockingLOD
+{
+    GENERATED_USTRUCT_BODY()
+
+    FAFFlockingLOD();
+
+    AFFlockingCore::FLODParams GetParams() const;
+
+    UPROPERTY( EditAnywhere )
+    uint8 bEnableLOD : 1;
+
+    /* Distance to the closest player camera from which the boids use the LOD 1 */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "bEnableLOD", ClampMin = "0.0" ) )
+    float LOD1MinDistance;
+
+    /* Number of frames between two updates of the boids in LOD 1 */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "bEnableLOD", ClampMin = "1" ) )
+    int32 LOD1UpdateInterval;
+
+    /* Distance to the closest player camera from which the boids use the LOD 2 */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "bEnableLOD", ClampMin = "0.0" ) )
+    float LOD2MinDistance;
+
+    /* Number of frames between two updates of the boids in LOD 2 */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "bEnableLOD", ClampMin = "1" ) )
+    int32 LOD2UpdateInterval;
+
+    /* Maximum time spent computing the steering velocities each frame, in microseconds. The boids which don't fit are updated during the next frames, the stalest first. 0 means no budget.
+     * Ignored when the flock is batched in the flocking subsystem, which has its own budget */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.0" ) )
+    float UpdateBudgetMicroseconds;
+};
+
+/* Lets a settled flock stop ticking : the owner does not move, and all the boids stayed close to their pursuit target for a while.
+ * The flock wakes up as soon as the owner moves, a boid is registered or unregistered, or the settings change */
+USTRUCT()
+struct FAFFlockingSleep
+{
+    GENERATED_USTRUCT_BODY()
+
+    FAFFlockingSleep();
+
+    UPROPERTY( EditAnywhere )
+    uint8 bEnableSleep : 1;
+
+    /* The flock is settled while its owner moves slower than this speed */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "bEnableSleep", ClampMin = "0.0" ) )
+    float MaxOwnerVelocity;
+
+    /* The flock is settled while each boid is closer than this distance to its pursuit target.
+     * The boids steer at their max speed until they sleep, circling around their target, so their velocity can not tell when they arrived */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "bEnableSleep", ClampMin = "0.0" ) )
+    float MaxTargetDistance;
+
+    /* Time the flock must stay settled before it falls asleep, in seconds */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "bEnableSleep", ClampMin = "0.0" ) )
+    float SettleDuration;
+
+    /* Interval of the updates of a sleeping flock, in seconds, which wake it up if it is not settled anymore. 0 does not update the flock until something wakes it up */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "bEnableSleep", ClampMin = "0.0" ) )
+    float SleepTickInterval;
+};
+
+/* Boids which are only data owned by the flocking component, without actor nor movement component.
+ * They move with a simple integration of their steering velocity, and are rendered as the instances of an instanced static mesh component created by the flocking component */
+USTRUCT()
+struct FAFLightweightBoidsSettings
+{
+    GENERATED_USTRUCT_BODY()
+
+    FAFLightweightBoidsSettings();
+
+    /* Number of lightweight boids spawned around the owner when the component begins to play */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0" ) )
+    int32 Count;
+
+    UPROPERTY( EditAnywhere )
+    UStaticMesh * Mesh;
+
+    UPROPERTY( EditAnywhere )
+    FVector MeshScale;
+
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.0" ) )
+    float MaxVelocity;
+
+    /* How fast the velocity of a boid goes toward its steering velocity. 0 applies the steering velocity instantly, like the character movement components */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.0" ) )
+    float MaxAcceleration;
+
+    /* Radius of the sphere around the owner where the lightweight boids are spawned */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.0" ) )
+    float SpawnRadius;
+};
+
 USTRUCT()
 struct FAFFlockingDebug
 {
@@ -111,6 +260,8 @@ struct FAFFlockingDebug
 
     FAFFlockingDebug();
 
+    bool IsEnabled() const;
+
     UPROPERTY( EditInstanceOnly )
     uint8 bDrawBoidSphere : 1;
 
@@ -125,20 +276,276 @@ struct FAFFlockingDebug
 
     UPROPERTY( EditInstanceOnly )
     uint8 bDrawSeparationForce : 1;
+
+    UPROPERTY( EditInstanceOnly )
+    uint8 bDrawObstacleAvoidanceForce : 1;
+
+    /* Maximum number of boids drawn per flock, after the stride is applied. 0 draws all of them.
+     * All the lines are submitted in one batch, but a debug line still costs a lot more than a boid */
+    UPROPERTY( EditInstanceOnly, meta = ( ClampMin = "0" ) )
+    int32 MaxDrawnBoidsCount;
+
+    // Only draws one boid every this number of boids
+    UPROPERTY( EditInstanceOnly, meta = ( ClampMin = "1" ) )
+    int32 DrawnBoidsStride;
+
+    // Number of segments of each of the 3 circles drawn for the sphere of a boid
+    UPROPERTY( EditInstanceOnly, meta = ( EditCondition = "bDrawBoidSphere", ClampMin = "3", ClampMax = "32" ) )
+    int32 BoidSphereSegmentsCount;
 };
 
 USTRUCT()
-struct FAFBoidsData
+struct FAFFlockingRecording
 {
     GENERATED_USTRUCT_BODY()
 
-    FAFBoidsData() = default;
-    FAFBoidsData( const UCharacterMovementComponent & movement_component );
+    FAFFlockingRecording();
 
-    FVector Center;
-    FVector Velocity;
-    float MaxVelocity;
-    FVector SteeringVelocity;
+    /* Number of ticks whose steering inputs are kept in memory, to be saved with SaveRecording and replayed with the standalone benchmark.
+     * Each tick takes about 76 bytes per boid. 0 disables the recording */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0" ) )
+    int32 RecordedFramesCount;
+
+    /* When positive, the recorded ticks are saved as soon as the steering update takes longer than this duration, in microseconds.
+     * To catch the ticks leading to the spike, the recording is only saved once it holds RecordedFramesCount ticks, and it is then cleared */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "RecordedFramesCount > 0", ClampMin = "0.0" ) )
+    float SaveOnSpikeMicroseconds;
+};
+
+USTRUCT()
+struct FAFFlockingReplication
+{
+    GENERATED_USTRUCT_BODY()
+
+    FAFFlockingReplication();
+
+    /* Replicate the locations and velocities of all the boids in a single property, quantized relative to the owner and delta encoded against the last state each client acknowledged.
+     * The boid actors registered on the server stop replicating their movement, and the clients register them and run the flocking locally between two updates.
+     * The owner of the flock must be replicated, and the component must be part of its default components */
+    UPROPERTY( EditAnywhere )
+    uint8 bReplicateFlock : 1;
+
+    /* Size of a quantization step of the locations. The replicated locations are within 0.87 times this distance of the boids */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "bReplicateFlock", ClampMin = "0.01" ) )
+    float PositionPrecision;
+
+    /* Size of a quantization step of the velocities */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "bReplicateFlock", ClampMin = "0.01" ) )
+    float VelocityPrecision;
+
+    /* Number of delta encoded states sent to a client between two full states, which let a client recover when it lost the base of the deltas */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "bReplicateFlock", ClampMin = "1" ) )
+    int32 FullStateInterval;
+};
+
+UENUM()
+enum class EAFAsyncSteeringLatency : uint8
+{
+    // The steering velocities are applied at the beginning of the next tick of the component
+    NextFrame,
+    // The steering velocities are applied at the end of the frame, during the post update work tick group
+    SameFrame
+};
+
+USTRUCT()
+struct FAFFlockingPerformance
+{
+    GENERATED_USTRUCT_BODY()
+
+    FAFFlockingPerformance();
+
+    /* Compute the neighbor forces with the SIMD kernel, which tests 4 neighbors at once. When unchecked, the scalar reference kernel is used */
+    UPROPERTY( EditAnywhere )
+    uint8 bUseVectorizedSteering : 1;
+
+    /* Split the boids in batches which compute their steering velocity on the worker threads. The result is identical to the single threaded path */
+    UPROPERTY( EditAnywhere )
+    uint8 bUseParallelSteering : 1;
+
+    /* Minimum number of boids processed by a worker thread. Flocks smaller than that are processed on the game thread */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "bUseParallelSteering", UIMin = "1", ClampMin = "1" ) )
+    int32 ParallelSteeringMinBatchSize;
+
+    /* When positive, the neighbors of each boid are cached in lists built with the biggest radius plus this distance, and reused until a boid moved more than half of it.
+     * Best for flocks whose boids move slowly relative to each other. 0 searches the neighbors every frame */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.0" ) )
+    float NeighborListSkinDistance;
+
+    /* When positive, the boids are stored in the simulation along a Z-order curve, re-sorted every this number of ticks, so the boids close to each other are close in memory during the neighbor pass.
+     * Only the storage order changes : the index of the boids in the queue is kept. Worth it with thousands of boids. 0 stores the boids in the order they were registered */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0" ) )
+    int32 BoidsSortInterval;
+
+    /* When positive, the steering velocities are computed at this fixed rate, in updates per second, instead of every tick. The velocity requested to the boids every tick is interpolated between the last two updates.
+     * Makes the behavior and the cost of the flock independent from the frame rate : a flock updated at 20 Hz on a server running at 60 Hz saves two thirds of the steering cost */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "0.0" ) )
+    float FixedTimestepRate;
+
+    /* Maximum number of fixed steps simulated in a single tick. After a hitch, the time beyond is dropped instead of being caught up during the next ticks */
+    UPROPERTY( EditAnywhere, meta = ( ClampMin = "1", UIMin = "1" ) )
+    int32 MaxSubstepsCount;
+
+    /* Compute the steering velocities in a task which runs while the rest of the frame is processed. Only the boids data gathering happens during the tick */
+    UPROPERTY( EditAnywhere )
+    uint8 bUseAsyncSteering : 1;
+
+    /* When the steering velocities computed by the task are applied to the boids */
+    UPROPERTY( EditAnywhere, meta = ( EditCondition = "bUseAsyncSteering" ) )
+    EAFAsyncSteeringLatency AsyncSteeringLatency;
+
+    /* Let the flocking subsystem update this flock with all the other batched flocks of the world, in a single tick and neighbor pass.
+     * The component does not tick anymore, and the other performance options are replaced by the ones of the subsystem */
+    UPROPERTY( EditAnywhere )
+    uint8 bUseFlockingSubsystem : 1;
+};
+
+/* Identifies a boid registered to a flocking component, for as long as it stays registered.
+ * Unlike the index of the boid in the flock, which changes when other boids are unregistered or when positions are swapped, the handle never changes.
+ */
+USTRUCT( BlueprintType )
+struct ACTORFLOCKING_API FAFBoidHandle
+{
+    GENERATED_USTRUCT_BODY()
+
+    FAFBoidHandle();
+    explicit FAFBoidHandle( int32 id );
+
+    bool IsValid() const;
+    int32 GetId() const;
+
+    bool operator==( const FAFBoidHandle & other ) const
+    {
+        return Id == other.Id;
+    }
+
+    friend uint32 GetTypeHash( const FAFBoidHandle & handle )
+    {
+        return GetTypeHash( handle.Id );
+    }
+
+private:
+    int32 Id;
+};
+
+/* Snapshot of everything the steering computation reads and writes.
+ * The component owns two of them, so a task can work on one while the game thread gathers the boids data in the other.
+ */
+struct FAFFlockSimulationFrame
+{
+    FAFFlockSimulationFrame();
+
+    // Selects the boids to update, based on the distance to the player cameras of world and the budget
+    void ScheduleBoidsUpdate( AFFlockingCore::FUpdateScheduler & scheduler, const UWorld * world, float budget_microseconds );
+    // Computes the steering velocities of StepsCount fixed steps, each one from the positions the previous one leads to. The previous steering velocities are the ones before the last step
+    void UpdateBoidsSteeringVelocity();
+    AFFlockingCore::FSteeringOptions GetSteeringOptions() const;
+    // Appends the debug lines of the flock to lines, to be submitted in one batch with SubmitDebugLines
+    void DrawDebug( TArray< FBatchedLine > & lines, const FAFFlockingDebug & debug, int32 flock_index ) const;
+
+    FAFFlockingDebug Debug;
+    FAFFlockingPerformance Performance;
+    bool bStoreDebugForces;
+    bool bSeparateFromOtherFlocks;
+    int32 StepsCount;
+    float StepDuration;
+    // Filled by UpdateBoidsSteeringVelocity with the sum of all the steps, to be reported to the scheduler
+    double BuildNeighborSearchMicroseconds;
+    double ComputeSteeringMicroseconds;
+    std::vector< AFFlockingCore::FVec3 > ViewerLocations;
+    AFFlockingCore::FFlockState State;
+    AFFlockingCore::FFlockSimulation Simulation;
+    // Only filled for the async steering, where a boid can be unregistered or moved to another slot while the task runs
+    TArray< FAFBoidHandle > BoidsHandles;
+    // Only filled for the async steering : the slot of each boid of State, when they are sorted. See UAFFlockingComponent::BoidsOrder
+    TArray< int32 > BoidsOrder;
+    // One per batch of the parallel steering
+    std::vector< AFFlockingCore::FSteeringScratch > BatchesScratches;
+
+private:
+    void ComputeSteeringStep();
+};
+
+/* Keeps the steering inputs of the last ticks of a flock, or of all the flocks batched by the subsystem, in a ring buffer.
+ * The recordings are saved in the Saved/Profiling/Flocking folder.
+ */
+struct FAFFlockRecorder
+{
+    // Records the inputs of the steering update of frame, which must be scheduled and not updated yet
+    void Record( const FAFFlockSimulationFrame & frame, const FAFFlockingRecording & recording );
+    // Saves the recording when the steering update of frame took longer than the spike duration of recording. name is the prefix of the file
+    void SaveOnSpike( const FAFFlockSimulationFrame & frame, const FAFFlockingRecording & recording, const FString & name );
+    bool Save( const FString & file_name ) const;
+
+    AFFlockingCore::FFlockRecorder Recorder;
+};
+
+/* Quantized state of all the boids of a flock, replicated with a custom delta serialization when FAFFlockingReplication::bReplicateFlock is set.
+ * Each state is numbered, and encoded against the last state the client acknowledged, which the client finds in the history of the states it received.
+ */
+USTRUCT()
+struct FAFReplicatedFlock
+{
+    GENERATED_USTRUCT_BODY()
+
+    FAFReplicatedFlock();
+
+    bool NetDeltaSerialize( FNetDeltaSerializeInfo & delta_parms );
+
+    // Shared with the base states of the connections, so the state is not copied for each client
+    TSharedPtr< const AFFlockingCore::FQuantizedFlock > Flock;
+    // The first boids of Flock belong to the actors of UAFFlockingComponent::ReplicatedBoidsActors, the others are lightweight boids
+    int32 ActorBoidsCount;
+    // Incremented by the server each time Flock changes. 0 means no state
+    uint32 Sequence;
+    int32 FullStateInterval;
+    // Bits written for all the clients, reset by the component when it measures the bandwidth
+    int64 SentBitsCount;
+
+private:
+    struct FReceivedState
+    {
+        uint32 Sequence;
+        TSharedPtr< const AFFlockingCore::FQuantizedFlock > Flock;
+    };
+
+    TArray< FReceivedState > ReceivedStates;
+    int32 NextReceivedStateIndex;
+    AFFlockingCore::FBitsWriter Writer;
+    TArray< uint8 > ReceivedBytes;
+};
+
+template <>
+struct TStructOpsTypeTraits< FAFReplicatedFlock > : public TStructOpsTypeTraitsBase2< FAFReplicatedFlock >
+{
+    enum
+    {
+        WithNetDeltaSerializer = true
+    };
+};
+
+class UAFFlockingComponent;
+
+/* Applies the steering velocities computed by the async task at the end of the frame, when EAFAsyncSteeringLatency::SameFrame is used */
+USTRUCT()
+struct FAFFlockingApplySteeringTickFunction : public FTickFunction
+{
+    GENERATED_USTRUCT_BODY()
+
+    FAFFlockingApplySteeringTickFunction();
+
+    void ExecuteTick( float delta_time, ELevelTick tick_type, ENamedThreads::Type current_thread, const FGraphEventRef & completion_graph_event ) override;
+    FString DiagnosticMessage() override;
+
+    UAFFlockingComponent * Target;
+};
+
+template <>
+struct TStructOpsTypeTraits< FAFFlockingApplySteeringTickFunction > : public TStructOpsTypeTraitsBase2< FAFFlockingApplySteeringTickFunction >
+{
+    enum
+    {
+        WithCopy = false
+    };
 };
 
 UCLASS( ClassGroup = Movement, hidecategories = ( Object, LOD, Lighting, Transform, Sockets, TextureStreaming ), meta = ( BlueprintSpawnableComponent ) )
@@ -149,13 +556,54 @@ class ACTORFLOCKING_API UAFFlockingComponent final : public UActorComponent
 public:
     UAFFlockingComponent();
 
+    /* Adds the actor of movement_component to the flock, and returns the handle of its boid. Registering a component twice returns the same handle.
+     * movement_component is a UAFBoidMovementComponent, a flying UCharacterMovementComponent, or any other movement component, whose velocity is then set directly.
+     * It must already have an updated component : the flock reads the location of the boid from it. A boid whose updated component is cleared later is unregistered */
+    UFUNCTION( BlueprintCallable )
+    FAFBoidHandle RegisterMovementComponent( UMovementComponent * movement_component );
+
+    UFUNCTION( BlueprintCallable )
+    void UnRegisterMovementComponent( UMovementComponent * movement_component );
+
     UFUNCTION( BlueprintCallable )
-    void RegisterMovementComponent( UCharacterMovementComponent * movement_component );
+    void UnRegisterBoid( FAFBoidHandle boid_handle );
+
+    /* The max speed of the boids is read when they are registered and when their movement mode changes.
+     * Call this function after changing the max speed of a boid in any other way */
+    UFUNCTION( BlueprintCallable )
+    void RefreshBoidMaxVelocity( FAFBoidHandle boid_handle );
+
+    /* Spawns or removes lightweight boids to have count of them */
+    UFUNCTION( BlueprintCallable )
+    void SetLightweightBoidsCount( int32 count );
+
+    UFUNCTION( BlueprintPure )
+    int32 GetLightweightBoidsCount() const;
+
+    /* Gives the first positions of the queue to the boids closest to the front of the owner, and the last ones to the boids furthest behind it,
+     * so a large queued flock reorganizes, for example after its owner turned around, without boids crossing the whole formation */
+    UFUNCTION( BlueprintCallable )
+    void ReassignQueueByProximity();
+
+    /* Makes a sleeping flock tick again. The flock wakes up by itself when its owner moves, when boids are registered or unregistered, and when the settings change */
+    UFUNCTION( BlueprintCallable )
+    void WakeUp();
+
+    /* Overrides Sleep.bEnableSleep. Disabling the sleep wakes the flock up */
+    UFUNCTION( BlueprintCallable )
+    void SetSleepEnabled( bool enable_sleep );
+
+    UFUNCTION( BlueprintPure )
+    bool IsSleeping() const;
 
+    /* Saves the ticks recorded with Recording.RecordedFramesCount in Saved/Profiling/Flocking/file_name. Returns false if nothing was recorded or the file could not be written */
     UFUNCTION( BlueprintCallable )
-    void UnRegisterMovementComponent( UCharacterMovementComponent * movement_component );
+    bool SaveRecording( const FString & file_name ) const;
 
     void BeginPlay() override;
+    void EndPlay( EEndPlayReason::Type end_play_reason ) override;
+    void OnUnregister() override;
+    void RegisterComponentTickFunctions( bool register_tick_functions ) override;
 
 #if WITH_EDITOR
     void PostEditChangeProperty( FPropertyChangedEvent & property_changed_event ) override;
@@ -165,26 +613,188 @@ public:
     void SetSettings( UAFFlockSettingsData * new_settings );
 
     void TickComponent( float delta_time, ELevelTick tick_type, FActorComponentTickFunction * this_tick_function ) override;
+    void GetLifetimeReplicatedProps( TArray< FLifetimeProperty > & out_lifetime_props ) const override;
+    void PreReplication( IRepChangedPropertyTracker & changed_property_tracker ) override;
 
 private:
-    void UpdateBoidsSteeringVelocity();
+    friend struct FAFFlockingApplySteeringTickFunction;
+    friend class UAFFlockingSubsystem;
+    // Lets the automation tests drive the random swaps. Only defined with the tests
+    friend struct FAFFlockingComponentTestAccess;
+
+    void UpdateSettingsTransition( float delta_time );
+    void GatherSimulationFrame( FAFFlockSimulationFrame & frame ) const;
+    // Sorts the boids along a Z-order curve when sort_interval ticks elapsed since the last sort, or when boids were added or removed. 0 restores the slot order
+    void UpdateBoidsOrder( int32 sort_interval );
+    // Slot of the boid stored at index in the flock state
+    int32 GetBoidSlot( int32 index ) const;
+    void GatherFlock( AFFlockingCore::FFlockState & state ) const;
+    void ApplySimulationFrame( const FAFFlockSimulationFrame & frame );
+    // Evaluates the queue curve for the positions of the queue from first_position, whose boid changed
+    void BakeQueueCurve( int32 first_position );
+    void StoreBoidsUpdateFrames( const AFFlockingCore::FFlockState & state, int32 flock_index );
+    void ApplyFlockSteering( const FAFFlockSimulationFrame & frame, int32 flock_index );
+    void DrawFlockDebug( const FAFFlockSimulationFrame & frame, const FAFFlockingDebug & debug, int32 flock_index );
+    // With a fixed timestep, the steering velocity is requested every tick, interpolated between the last two steps, instead of when it is computed
+    void ApplyBoidSteering( int32 slot, const AFFlockingCore::FBoid & frame_boid, bool request_direct_move );
+    void RequestBoidMove( int32 slot, const FVector & velocity );
+    void RequestInterpolatedMoves( float ratio );
+    void UpdateLightweightBoids( float delta_time );
+    // Moves the boid movement components whose tick is disabled, all at once
+    void MoveBoids( float delta_time );
+    // Called after each steering update. Puts the flock to sleep once it stayed settled for Sleep.SettleDuration, and wakes it up as soon as it is not settled anymore
+    void UpdateSleep( float simulated_duration );
+    bool IsSettled() const;
+    void FallAsleep();
+    // Clears the sleeping state, without making the component tick again
+    void LeaveSleep();
+    // Used by the flocking subsystem, which skips the sleeping flocks except once every Sleep.SleepTickInterval of simulated time
+    bool ShouldSimulate( float simulated_duration );
+    void OnOwnerTransformUpdated( USceneComponent * updated_component, EUpdateTransformFlags update_transform_flags, ETeleportType teleport );
+    /* Fades the obstacles detected by the previous traces, and starts the traces of the next boids, at most max_traces_count of them.
+     * Returns the number of traces started */
+    int32 UpdateObstacleAvoidance( float delta_time, int32 max_traces_count );
+    void OnObstacleTraceDone( const FTraceHandle & trace_handle, FTraceDatum & trace_datum );
+    void ResizeLightweightBoids();
+    void DispatchAsyncSteering();
+    void WaitForAsyncSteering();
+    void CompleteAsyncSteering();
+    void DiscardAsyncSteering();
     void TrySetSwapBoidsPositionsTimer();
     void RandomSwapBoidsPositions();
+    // Only the pursuit offset multipliers of the boids change, they keep their slots
+    void SwapQueuePositions( int32 first_position, int32 second_position );
+    // Returns the position the boid had in the queue
+    int32 RemoveBoidSlot( int32 slot );
+    // Unregisters the boids whose movement component was destroyed or lost its updated component, before the flock reads their location
+    void UnRegisterInvalidBoids();
+    // Quantizes the boids in ReplicatedFlock, and measures the bandwidth used since the last call
+    void UpdateReplicatedFlock();
+
+#if WITH_EDITOR
+    void OnObjectPropertyChanged( UObject * object, FPropertyChangedEvent & property_changed_event );
+#endif
+
+    UFUNCTION()
+    void OnBoidMovementModeChanged( ACharacter * character, EMovementMode previous_movement_mode, uint8 previous_custom_mode );
+
+    // Registers the replicated boid actors on the client, and unregisters the ones the server removed
+    UFUNCTION()
+    void OnRep_ReplicatedBoidsActors();
+
+    // Moves the boids of the client to the replicated state
+    UFUNCTION()
+    void OnRep_ReplicatedFlock();
 
     UPROPERTY( EditAnywhere )
     FAFFlockingDebug Debug;
 
+    UPROPERTY( EditAnywhere )
+    FAFFlockingPerformance Performance;
+
+    UPROPERTY( EditAnywhere )
+    FAFFlockingLOD LOD;
+
+    UPROPERTY( EditAnywhere )
+    FAFFlockingSleep Sleep;
+
+    UPROPERTY( EditAnywhere )
+    FAFFlockingRecording Recording;
+
+    UPROPERTY( EditAnywhere )
+    FAFFlockingReplication Replication;
+
+    /* Bandwidth used by the replication of this flock on the server, for all the clients */
+    UPROPERTY( VisibleInstanceOnly, Transient )
+    float ReplicatedBytesPerSecond;
+
+    // The boid actors in slot order, which is the order of the boids of ReplicatedFlock
+    UPROPERTY( Transient, ReplicatedUsing = OnRep_ReplicatedBoidsActors )
+    TArray< AActor * > ReplicatedBoidsActors;
+
+    UPROPERTY( Transient, ReplicatedUsing = OnRep_ReplicatedFlock )
+    FAFReplicatedFlock ReplicatedFlock;
+
+    UPROPERTY( EditAnywhere )
+    FAFLightweightBoidsSettings LightweightBoids;
+
     UPROPERTY( EditAnywhere )
     UAFFlockSettingsData * FlockSettingsData;
 
     UPROPERTY( VisibleInstanceOnly )
     FAFFlockSettings FlockSettings;
 
-    TArray< FAFBoidsData > BoidsData;
-    TArray< UCharacterMovementComponent * > BoidsMovementComponents;
+    UPROPERTY( Transient )
+    UInstancedStaticMeshComponent * LightweightBoidsInstances;
+
+    /* The registered boids are stored in slots, which are the indices of the following arrays and of the boids in the flock.
+     * Unregistering a boid moves the last one to its slot, and the handles allow to find the slot of a boid */
+    TArray< UMovementComponent * > BoidsMovementComponents;
+    TArray< FAFBoidHandle > BoidsHandles;
+    // State of the boids kept between the ticks : the max velocity, and the steering velocity reused when a boid is not updated. The location and velocity are read each tick
+    TArray< AFFlockingCore::FBoid > BoidsData;
+    TMap< FAFBoidHandle, int32 > BoidsSlots;
+    TMap< const UMovementComponent *, FAFBoidHandle > MovementComponentsHandles;
+    // The registered boid movement components the flock moves in MoveBoids, in no particular order
+    TArray< UAFBoidMovementComponent * > FlockMovedBoids;
+    int32 NextBoidHandleId;
+    // The lightweight boids come after the boids of BoidsMovementComponents in the flock
+    TArray< AFFlockingCore::FBoid > LightweightBoidsData;
+    TArray< FTransform > LightweightBoidsTransforms;
+    // QueueCurve evaluated at the position in the queue of the boid in each slot, then of each lightweight boid, so the curve is not evaluated every tick
+    TArray< float > PursuitOffsetMultipliers;
+    // Position in the queue of the boid in each slot. The lightweight boids are queued after the boids of BoidsMovementComponents, in their order
+    AFFlockingCore::FQueueSlots QueueSlots;
+    // Scratch memory of ReassignQueueByProximity
+    std::vector< float > QueueBoidsTargets;
+    std::vector< float > QueuePositionsMultipliers;
+    /* Permutation of the queue positions, shuffled by RandomSwapBoidsPositions, which moves the positions it swaps to the front.
+     * It stays a permutation of the positions, so it is only reset when the number of boids changes */
+    TArray< int32 > SwapPositions;
+    // Index of each queue position in SwapPositions
+    TArray< int32 > SwapPositionsIndices;
+    /* Slots of the boids in the order they are stored in the flock state, the lightweight boids coming after the slots of BoidsMovementComponents.
+     * Empty when the boids are stored in slot order. The slots, and so the positions of the boids in the queue, are not affected by the sort */
+    TArray< int32 > BoidsOrder;
+    // Incremented each time the order of the boids in the flock state changes
+    uint32 BoidsOrderVersion;
+    int32 TicksSinceBoidsSort;
+    std::vector< AFFlockingCore::FVec3 > BoidsSortCenters;
+    std::vector< uint64_t > BoidsSortKeys;
+    AFFlockingCore::FUpdateScheduler UpdateScheduler;
+    AFFlockingCore::FFixedTimestep FixedTimestep;
+    FAFFlockRecorder Recorder;
+    // Sequence of the replicated state the boids of the client were moved to
+    uint32 AppliedReplicatedSequence;
+    float ReplicationMeasureStartTime;
+    // Name of the events of this flock in the flocking trace channel
+    FString TraceName;
+    // Reused each tick to submit all the debug lines of the flock at once
+    TArray< FBatchedLine > DebugLines;
+    FTraceDelegate ObstacleTraceDelegate;
+    // Index in the flock of the next boid whose obstacles are traced
+    int32 ObstacleTraceCursor;
+    FAFFlockSimulationFrame SimulationFrames[ 2 ];
+    // Index of the frame processed by the async task. The game thread gathers the boids data in the other one
+    int32 AsyncFrameIndex;
+    bool bHasPendingAsyncFrame;
+    FGraphEventRef AsyncSteeringTask;
+    FAFFlockingApplySteeringTickFunction ApplySteeringTickFunction;
+    TWeakObjectPtr< UAFFlockingSubsystem > FlockingSubsystem;
     FAFFlockSettings FlockInitialSettings;
     FAFFlockSettings FlockTargetSettings;
     float TransitionDuration;
     float TransitionTimer;
     FTimerHandle SwapBoidPositionTimerHandle;
+    // Time the flock has been settled for
+    float SettledDuration;
+    // Time since the last update of the sleeping flock, when it is batched by the flocking subsystem
+    float SleepTimer;
+    // Tick interval of the component before it fell asleep
+    float AwakeTickInterval;
+    bool bIsSleeping;
+    FDelegateHandle OwnerTransformUpdatedDelegateHandle;
+#if WITH_EDITOR
+    FDelegateHandle ObjectPropertyChangedDelegateHandle;
+#endif
 };
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "AFFlockingComponent.h"
+
+#include <CoreMinimal.h>
+#include <Engine/EngineBaseTypes.h>
+#include <Subsystems/WorldSubsystem.h>
+
+#include "AFFlockingSubsystem.generated.h"
+
+class UAFFlockingSubsystem;
+
+/* Updates all the flocks batched by the subsystem, once per frame */
+USTRUCT()
+struct FAFFlockingSubsystemTickFunction : public FTickFunction
+{
+    GENERATED_USTRUCT_BODY()
+
+    FAFFlockingSubsystemTickFunction();
+
+    void ExecuteTick( float delta_time, ELevelTick tick_type, ENamedThreads::Type current_thread, const FGraphEventRef & completion_graph_event ) override;
+    FString DiagnosticMessage() override;
+
+    UAFFlockingSubsystem * Target;
+};
+
+template <>
+struct TStructOpsTypeTraits< FAFFlockingSubsystemTickFunction > : public TStructOpsTypeTraitsBase2< FAFFlockingSubsystemTickFunction >
+{
+    enum
+    {
+        WithCopy = false
+    };
+};
+
+/* Owns the boids of all the flocking components which use bUseFlockingSubsystem, in contiguous buffers, and updates them in a single tick.
+ * All the flocks share the same spatial hash, so there is one neighbor pass per frame instead of one per flock.
+ * The options are read from the game config, in the [/Script/ActorFlocking.AFFlockingSubsystem] section.
+ */
+UCLASS( Config = Game )
+class ACTORFLOCKING_API UAFFlockingSubsystem final : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    UAFFlockingSubsystem();
+
+    void Deinitialize() override;
+
+    void RegisterFlock( UAFFlockingComponent * flocking_component );
+    void UnRegisterFlock( UAFFlockingComponent * flocking_component );
+
+    /* Saves the ticks of all the batched flocks recorded with RecordedFramesCount in Saved/Profiling/Flocking/file_name */
+    UFUNCTION( BlueprintCallable )
+    bool SaveRecording( const FString & file_name ) const;
+
+private:
+    friend struct FAFFlockingSubsystemTickFunction;
+
+    void Tick( float delta_time );
+    // Gathers the flocks, computes their steering for steps_count fixed steps and applies it. The settings transitions advance by all the steps
+    void SimulateFlocks( int32 steps_count, float step_duration );
+
+    /* Compute the neighbor forces with the SIMD kernel. When false, the scalar reference kernel is used */
+    UPROPERTY( Config )
+    uint8 bUseVectorizedSteering : 1;
+
+    /* Split the boids of all the flocks in batches which compute their steering velocity on the worker threads */
+    UPROPERTY( Config )
+    uint8 bUseParallelSteering : 1;
+
+    /* Minimum number of boids processed by a worker thread */
+    UPROPERTY( Config )
+    int32 ParallelSteeringMinBatchSize;
+
+    /* Skin distance of the neighbor lists shared by all the flocks. 0 searches the neighbors every frame */
+    UPROPERTY( Config )
+    float NeighborListSkinDistance;
+
+    /* Number of ticks between two sorts of the boids of each flock along a Z-order curve, for the cache locality of the neighbor pass. 0 keeps the boids in the order they were registered */
+    UPROPERTY( Config )
+    int32 BoidsSortInterval;
+
+    /* When positive, the steering velocities of all the flocks are computed at this fixed rate, in updates per second, and interpolated in between. 0 computes them every frame */
+    UPROPERTY( Config )
+    float FixedTimestepRate;
+
+    /* Maximum number of fixed steps simulated in a single frame. The time beyond is dropped */
+    UPROPERTY( Config )
+    int32 MaxSubstepsCount;
+
+    /* Let the boids of the other flocks contribute to the separation force, so different flocks avoid each other. This has no extra cost, as the neighbor pass already visits them */
+    UPROPERTY( Config )
+    uint8 bUseCrossFlockSeparation : 1;
+
+    /* Maximum time spent computing the steering velocities of all the flocks each frame, in microseconds. 0 means no budget. The levels of detail are defined by each flock */
+    UPROPERTY( Config )
+    float UpdateBudgetMicroseconds;
+
+    /* Recording of the steering inputs of all the batched flocks, to be saved with SaveRecording or on a spike. Set in the config as Recording=(RecordedFramesCount=300,SaveOnSpikeMicroseconds=4000) */
+    UPROPERTY( Config )
+    FAFFlockingRecording Recording;
+
+    /* Maximum number of obstacle traces of all the flocks per tick, on top of the limit of each flock. The flocks take turns to trace first */
+    UPROPERTY( Config )
+    int32 MaxObstacleTracesPerTick;
+
+    UPROPERTY( Transient )
+    TArray< UAFFlockingComponent * > FlockingComponents;
+
+    // The flocks simulated this tick : the ones which are not sleeping, and the sleeping ones whose periodic update is due
+    TArray< UAFFlockingComponent * > SimulatedFlockingComponents;
+
+    FAFFlockSimulationFrame SimulationFrame;
+    AFFlockingCore::FUpdateScheduler UpdateScheduler;
+    AFFlockingCore::FFixedTimestep FixedTimestep;
+    FAFFlockRecorder Recorder;
+    // Index of the flock which starts the obstacle traces this tick
+    int32 FirstObstacleTracesFlockIndex;
+    FAFFlockingSubsystemTickFunction TickFunction;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "FlockingCore/AFCoreNeighborForces.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace AFFlockingCore
+{
+    class FSpatialHashGrid;
+
+    /* Structure of arrays copy of the boids centers, velocities and flock indices, stored in the spatial hash order so the boids of a bucket are contiguous.
+     * Each stream is padded to the SIMD width, which allows the kernel to always process 4 neighbors at once.
+     */
+    class FBoidsSoA
+    {
+    public:
+        static constexpr int32_t SimdWidth = 4;
+
+        void Build( const FFlockState & state, const FSpatialHashGrid & spatial_hash );
+
+        /* Accumulates the contribution of all the boids in the buckets around the boid at boid_index, with the same flock filtering as the scalar kernel.
+         * Adds the number of boids found in those buckets to neighbor_candidates_count, and returns the number of pairs which have been tested, padding lanes included.
+         * Like the scalar kernel, only the forces of _FEATURES_ are accumulated */
+        template < uint32_t _FEATURES_ = ESteeringFeatures::NeighborForces >
+        int32_t AccumulateNeighborForces( FNeighborForces & forces, int64_t & neighbor_candidates_count, int32_t boid_index, const FSpatialHashGrid & spatial_hash, const FNeighborRadii & radii, bool separate_from_other_flocks ) const;
+
+        size_t GetAllocatedSize() const;
+
+    private:
+        std::vector< float > CenterX;
+        std::vector< float > CenterY;
+        std::vector< float > CenterZ;
+        std::vector< float > VelocityX;
+        std::vector< float > VelocityY;
+        std::vector< float > VelocityZ;
+        // Stored as floats to be compared in the SIMD registers. Exact up to 2^24 flocks
+        std::vector< float > FlockIndices;
+        std::vector< int32_t > SortedPositions;
+    };
+}
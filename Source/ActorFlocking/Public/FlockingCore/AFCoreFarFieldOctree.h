@@ -0,0 +1,59 @@
+#pragma once
+
+#include "FlockingCore/AFCoreNeighborForces.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace AFFlockingCore
+{
+    /* Octree over the boids of a flock, where each node stores the sum of the centers and of the velocities of its boids.
+     * Allows to compute the alignment and cohesion forces with radii which cover most of the flock, where a spatial hash would test every pair :
+     * the nodes which are entirely within a radius contribute as a whole, which is exact as both forces only need the sums, and the nodes which straddle a radius are opened
+     * down to their boids. Only the summation order differs from the kernels.
+     */
+    class FFarFieldOctree
+    {
+    public:
+        FFarFieldOctree();
+
+        // Builds the tree over the boids in [first_boid_index, first_boid_index + boids_count) of state
+        void Build( const FFlockState & state, int32_t first_boid_index, int32_t boids_count );
+
+        /* Adds the alignment and cohesion contributions of the boids of the tree within radii of the boid at boid_index, which must belong to the tree, itself excluded.
+         * Returns the number of nodes and boids which have been tested */
+        int32_t AccumulateAlignmentAndCohesion( FNeighborForces & forces, int32_t boid_index, const FFlockState & state, const FNeighborRadii & radii ) const;
+
+        size_t GetAllocatedSize() const;
+
+    private:
+        struct FNode
+        {
+            // Tight bounds of the boids of the node
+            FVec3 Minimum;
+            FVec3 Maximum;
+            FVec3 CentersSum;
+            FVec3 VelocitiesSum;
+            // Range of the boids of the node in SortedBoidIndices
+            int32_t First;
+            int32_t Last;
+            // The children are contiguous in Nodes. A leaf has no child
+            int32_t FirstChild;
+            int32_t ChildrenCount;
+        };
+
+        void BuildNode( const FFlockState & state, int32_t node_index, int32_t first, int32_t last, int32_t depth );
+
+        int32_t FirstBoidIndex;
+        std::vector< FNode > Nodes;
+        std::vector< int32_t > SortedBoidIndices;
+        // Position of each boid of the flock in SortedBoidIndices, to know if a node contains the boid of the query
+        std::vector< int32_t > SortedPositions;
+        // Centers and velocities of the boids in the order of SortedBoidIndices, so the boids of a leaf are contiguous
+        std::vector< FVec3 > SortedCenters;
+        std::vector< FVec3 > SortedVelocities;
+        std::vector< int32_t > OctantScratch;
+        // Copy of the boids of the node being subdivided, partitioned back by octant into SortedBoidIndices
+        std::vector< int32_t > PartitionScratch;
+    };
+}
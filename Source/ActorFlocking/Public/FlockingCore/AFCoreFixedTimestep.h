@@ -0,0 +1,33 @@
+#pragma once
+
+#include "FlockingCore/AFCoreFlockState.h"
+
+#include <cstdint>
+
+namespace AFFlockingCore
+{
+    /* Accumulates the frame times to run the simulation at a fixed rate, whatever the frame rate */
+    class FFixedTimestep
+    {
+    public:
+        FFixedTimestep();
+
+        /* Adds delta_time to the accumulated time, and returns the number of steps of step_duration to simulate, at most max_steps_count.
+         * The time which does not fit in max_steps_count steps is dropped, so the frames after a hitch don't have to catch up */
+        int32_t Advance( float delta_time, float step_duration, int32_t max_steps_count );
+
+        // Position of the current time between the last step and the next one, in [0, 1]
+        float GetInterpolationRatio( float step_duration ) const;
+
+        void Reset();
+
+    private:
+        float Accumulator;
+    };
+
+    // Steering velocity between the last two steps of the simulation
+    inline FVec3 GetInterpolatedSteeringVelocity( const FBoid & boid, const float ratio )
+    {
+        return boid.PreviousSteeringVelocity + ( boid.SteeringVelocity - boid.PreviousSteeringVelocity ) * ratio;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+namespace AFFlockingCore
+{
+    constexpr int32_t LODLevelsCount = 3;
+
+    /* Numeric part of FAFFlockSettings, which is all the simulation needs */
+    struct FFlockParams
+    {
+        FFlockParams();
+
+        void LerpBetween( const FFlockParams & start, const FFlockParams & end, float ratio );
+
+        float PursuitWeight;
+        float PursuitSlowdownRadius;
+        float PursuitDistanceBehind;
+        float NonForwardVelocityBrakingFactor;
+        float AlignmentWeight;
+        float AlignmentRadius;
+        float CohesionWeight;
+        float CohesionRadius;
+        float SeparationWeight;
+        float SeparationRadius;
+        // When positive, each force only takes into account this number of nearest boids within its radius. Not interpolated, as 0 means no limit
+        int32_t MaxNeighborsCount;
+        /* Computes alignment and cohesion with an octree of the flock, where the nodes entirely within a radius are added as a whole. The result is exact.
+         * Separation still uses the spatial hash. Not interpolated. Ignored when MaxNeighborsCount is positive */
+        bool bUseFarFieldOctree;
+        // Weight of the force steering the boids away from FBoid::ObstacleAvoidance
+        float ObstacleAvoidanceWeight;
+    };
+
+    /* Distance based levels of detail of the boids of a flock. Level 0 always starts at a distance of 0 */
+    struct FLODParams
+    {
+        FLODParams();
+
+        bool bEnabled;
+        // Distance to the closest viewer from which each level starts
+        float MinDistances[ LODLevelsCount ];
+        // Number of frames between two updates of the steering velocity of a boid, for each level
+        int32_t UpdateIntervals[ LODLevelsCount ];
+    };
+}
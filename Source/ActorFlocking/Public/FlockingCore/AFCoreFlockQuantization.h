@@ -0,0 +1,106 @@
+#pragma once
+
+#include "FlockingCore/AFCoreMath.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace AFFlockingCore
+{
+    // The quantized components are clamped to this many bits, sign included
+    constexpr int32_t QuantizedComponentBitsCount = 20;
+
+    /* Appends bits to a byte buffer, the least significant bit first, like the bit streams of the engine */
+    class FBitsWriter
+    {
+    public:
+        FBitsWriter();
+
+        void Reset();
+        // Writes the bits_count lowest bits of value. bits_count must be at most 32
+        void WriteBits( uint32_t value, int32_t bits_count );
+        void WriteFloat( float value );
+
+        const std::vector< uint8_t > & GetBytes() const;
+        int64_t GetBitsCount() const;
+
+    private:
+        std::vector< uint8_t > Bytes;
+        int64_t BitsCount;
+    };
+
+    class FBitsReader
+    {
+    public:
+        FBitsReader( const uint8_t * bytes, int64_t bits_count );
+
+        // Returns 0 and sets the error flag when reading past the end
+        uint32_t ReadBits( int32_t bits_count );
+        float ReadFloat();
+
+        bool HasError() const;
+
+    private:
+        const uint8_t * Bytes;
+        int64_t BitsCount;
+        int64_t Offset;
+        bool bHasError;
+    };
+
+    struct FQuantizedBoid
+    {
+        bool operator==( const FQuantizedBoid & other ) const;
+
+        int32_t Location[ 3 ];
+        int32_t Velocity[ 3 ];
+    };
+
+    /* Locations and velocities of the boids of a flock, quantized to be sent over the network.
+     * The locations are relative to the owner of the flock, so they stay small and change slowly while the flock follows its owner.
+     */
+    struct FQuantizedFlock
+    {
+        FQuantizedFlock();
+
+        void Reset( const FVec3 & owner_location, float position_precision, float velocity_precision, int32_t boids_count );
+        void SetBoid( int32_t index, const FVec3 & location, const FVec3 & velocity );
+        FVec3 GetBoidLocation( int32_t index ) const;
+        FVec3 GetBoidVelocity( int32_t index ) const;
+
+        bool operator==( const FQuantizedFlock & other ) const;
+        bool operator!=( const FQuantizedFlock & other ) const;
+
+        FVec3 OwnerLocation;
+        // Size of a quantization step of the locations and of the velocities
+        float PositionPrecision;
+        float VelocityPrecision;
+        std::vector< FQuantizedBoid > Boids;
+    };
+
+    /* Writes flock as the difference of each component with the same boid of base, with fewer bits for the smaller differences.
+     * A boid which did not change takes a single bit. Without a base, or for the boids past the end of the base, the differences are taken with zero.
+     * The decoder must use the same base */
+    void EncodeQuantizedFlock( FBitsWriter & writer, const FQuantizedFlock & flock, const FQuantizedFlock * base );
+    // Returns false if the bits are truncated or inconsistent
+    bool DecodeQuantizedFlock( FBitsReader & reader, FQuantizedFlock & flock, const FQuantizedFlock * base );
+
+    inline const std::vector< uint8_t > & FBitsWriter::GetBytes() const
+    {
+        return Bytes;
+    }
+
+    inline int64_t FBitsWriter::GetBitsCount() const
+    {
+        return BitsCount;
+    }
+
+    inline bool FBitsReader::HasError() const
+    {
+        return bHasError;
+    }
+
+    inline bool FQuantizedFlock::operator!=( const FQuantizedFlock & other ) const
+    {
+        return !( *this == other );
+    }
+}
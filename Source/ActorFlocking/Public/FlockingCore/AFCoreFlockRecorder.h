@@ -0,0 +1,64 @@
+#pragma once
+
+#include "FlockingCore/AFCoreFlockSimulation.h"
+#include "FlockingCore/AFCoreFlockState.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace AFFlockingCore
+{
+    /* Input of one FFlockSimulation update, as recorded by FFlockRecorder */
+    struct FRecordedFrame
+    {
+        FSteeringOptions Options;
+        FFlockState State;
+    };
+
+    /* Keeps the inputs of the last simulation updates in a ring buffer of binary frames, to replay them without the engine.
+     * Each frame holds the steering options and the whole FFlockState after the scheduling : the flocks settings and owners, the boids, and the boids to update.
+     * The buffers of the frames are reused, so recording does not allocate once the ring buffer went around once.
+     * The format is little endian, and its version changes with the recorded structures.
+     */
+    class FFlockRecorder
+    {
+    public:
+        FFlockRecorder();
+
+        // Clears the recorded frames. 0 disables the recording
+        void SetMaxFramesCount( int32_t max_frames_count );
+        void Record( const FFlockState & state, const FSteeringOptions & options );
+        void Clear();
+
+        int32_t GetMaxFramesCount() const;
+        int32_t GetFramesCount() const;
+        bool IsFull() const;
+
+        // Appends the header and the recorded frames to bytes, the oldest first
+        void WriteTo( std::vector< uint8_t > & bytes ) const;
+
+    private:
+        std::vector< std::vector< uint8_t > > Frames;
+        int32_t NextFrameIndex;
+        int32_t FramesCount;
+    };
+
+    // Reads the frames written by FFlockRecorder::WriteTo. Returns false if the data is truncated, inconsistent, or from another version
+    bool ReadFlockRecording( const uint8_t * bytes, size_t bytes_count, std::vector< FRecordedFrame > & frames );
+
+    inline int32_t FFlockRecorder::GetMaxFramesCount() const
+    {
+        return static_cast< int32_t >( Frames.size() );
+    }
+
+    inline int32_t FFlockRecorder::GetFramesCount() const
+    {
+        return FramesCount;
+    }
+
+    inline bool FFlockRecorder::IsFull() const
+    {
+        return !Frames.empty() && FramesCount == static_cast< int32_t >( Frames.size() );
+    }
+}
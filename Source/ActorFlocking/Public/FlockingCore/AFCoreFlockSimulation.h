@@ -0,0 +1,121 @@
+#pragma once
+
+#include "FlockingCore/AFCoreBoidsSoA.h"
+#include "FlockingCore/AFCoreFarFieldOctree.h"
+#include "FlockingCore/AFCoreFlockState.h"
+#include "FlockingCore/AFCoreNearestNeighbors.h"
+#include "FlockingCore/AFCoreNeighborLists.h"
+#include "FlockingCore/AFCoreSpatialHashGrid.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace AFFlockingCore
+{
+    struct FSteeringOptions
+    {
+        FSteeringOptions();
+
+        // Use the SIMD kernel instead of the scalar reference kernel to compute the neighbor forces
+        bool bUseVectorizedKernel;
+        // Keep the weighted forces of each boid, for the debug drawing
+        bool bStoreDebugForces;
+        // Let the boids of the other flocks contribute to the separation force. Free, as all the flocks share the same spatial hash
+        bool bSeparateFromOtherFlocks;
+        /* When positive, the neighbors of each boid are cached in Verlet lists built with the neighbor radius plus this distance,
+         * and the spatial hash is only rebuilt when a boid moved more than half of it. The lists are evaluated with the scalar kernel */
+        float NeighborListSkinDistance;
+    };
+
+    struct FBoidDebugForces
+    {
+        FVec3 PursuitForce;
+        FVec3 AlignmentForce;
+        FVec3 CohesionForce;
+        FVec3 SeparationForce;
+        FVec3 ObstacleAvoidanceForce;
+    };
+
+    struct FSteeringCounters
+    {
+        FSteeringCounters();
+
+        void Add( const FSteeringCounters & other );
+
+        int64_t NeighborCandidatesCount;
+        int64_t PairTestsCount;
+        // Neighbors found within the biggest of the radii of the boids
+        int64_t NeighborsCount;
+    };
+
+    /* Scratch memory of a thread computing steering velocities */
+    struct FSteeringScratch
+    {
+        std::vector< int32_t > NeighborCandidates;
+        FNearestNeighborsScratch NearestNeighbors;
+        FSteeringCounters Counters;
+    };
+
+    /* Computes the steering velocities of all the flocks of a FFlockState, in two phases :
+     * - BuildNeighborSearch, which must run first, on a single thread
+     * - ComputeSteeringVelocities, which only reads the shared data and writes the steering velocity of the boids in [first, last) of FFlockState::BoidsToUpdate.
+     *   Disjoint ranges can run concurrently, each with its own scratch, and give the exact same result as a single call over the whole flock.
+     */
+    class FFlockSimulation
+    {
+    public:
+        FFlockSimulation();
+
+        void BuildNeighborSearch( const FFlockState & state, const FSteeringOptions & options );
+        void ComputeSteeringVelocities( FFlockState & state, int32_t first, int32_t last, FSteeringScratch & scratch );
+
+        // Runs both phases over all the boids to update
+        void Update( FFlockState & state, const FSteeringOptions & options, FSteeringScratch & scratch );
+
+        const std::vector< FBoidDebugForces > & GetDebugForces() const;
+        // Whether the last BuildNeighborSearch had to rebuild the neighbor lists
+        bool HasRebuiltNeighborLists() const;
+        const FNeighborLists & GetNeighborLists() const;
+        size_t GetAllocatedSize() const;
+
+    private:
+        // Computes the steering velocities of the boids in [first, last) of FFlockState::BoidsToUpdate, which must all belong to the same flock, whose features are _FEATURES_
+        template < uint32_t _FEATURES_ >
+        void ComputeFlockSteeringVelocities( FFlockState & state, int32_t first, int32_t last, FSteeringScratch & scratch );
+
+        FSteeringOptions Options;
+        /* Radii given to the neighbor kernels. Alignment and cohesion are left to the octree for the flocks which use the far field.
+         * The radii of the disabled forces are 0, so they don't make the spatial hash cells bigger */
+        std::vector< FNeighborRadii > FlocksRadii;
+        // ESteeringFeatures of each flock : its forces with a weight and a radius, and the debug forces
+        std::vector< uint32_t > FlocksFeatures;
+        // Only built for the flocks which use the far field
+        std::vector< FFarFieldOctree > FlocksOctrees;
+        bool bUseNeighbors;
+        bool bUseNearestNeighbors;
+        bool bUseNeighborLists;
+        bool bHasRebuiltNeighborLists;
+        FSpatialHashGrid SpatialHash;
+        FNeighborLists NeighborLists;
+        // Used by the flocks with a maximum number of neighbors, with cells sized from the density of the boids
+        FSpatialHashGrid NearestNeighborsSpatialHash;
+        FBoidsSoA SoA;
+        // Written by ComputeSteeringVelocities, each boid only touching its own element
+        std::vector< FBoidDebugForces > DebugForces;
+    };
+
+    inline const std::vector< FBoidDebugForces > & FFlockSimulation::GetDebugForces() const
+    {
+        return DebugForces;
+    }
+
+    inline bool FFlockSimulation::HasRebuiltNeighborLists() const
+    {
+        return bHasRebuiltNeighborLists;
+    }
+
+    inline const FNeighborLists & FFlockSimulation::GetNeighborLists() const
+    {
+        return NeighborLists;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "FlockingCore/AFCoreFlockParams.h"
+#include "FlockingCore/AFCoreMath.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace AFFlockingCore
+{
+    // Value of FBoid::FramesSinceUpdate for a boid which never got a steering velocity
+    constexpr int32_t NeverUpdated = 1 << 30;
+
+    struct FBoid
+    {
+        FVec3 Center;
+        FVec3 Velocity;
+        float MaxVelocity;
+        // Output of the simulation. Boids which are not updated keep the value they were given
+        FVec3 SteeringVelocity;
+        // Steering velocity of the previous step, kept by the owner of the boid when the simulation runs at a fixed rate, to interpolate toward SteeringVelocity
+        FVec3 PreviousSteeringVelocity;
+        int32_t FramesSinceUpdate;
+        // Direction away from the obstacles detected by the owner of the boid, whose size goes from 0 (no obstacle) to 1 (touching an obstacle)
+        FVec3 ObstacleAvoidance;
+    };
+
+    /* Settings and owner of a flock, and the range of FFlockState::Boids it owns */
+    struct FFlock
+    {
+        FFlock();
+
+        FFlockParams Params;
+        FLODParams LOD;
+        FVec3 OwnerLocation;
+        FVec3 OwnerForwardVector;
+        FVec3 OwnerVelocity;
+        int32_t FirstBoidIndex;
+        int32_t BoidsCount;
+        // Incremented by the owner of the flock each time it changes the order of its boids, so the data cached per boid index gets rebuilt
+        uint32_t BoidsOrderVersion;
+    };
+
+    /* Everything the simulation reads to compute the steering velocities of one or several flocks, and the boids where it writes them.
+     * The boids of all the flocks are stored contiguously, so a single neighbor pass can process all of them.
+     */
+    struct FFlockState
+    {
+        void Reset();
+
+        // Appends a flock owning boids_count new boids, with a pursuit offset multiplier of 1, which are all updated. The boids must then be filled by the caller
+        FFlock & AddFlock( int32_t boids_count );
+
+        std::vector< FFlock > Flocks;
+        std::vector< FBoid > Boids;
+        // Index in Flocks of each boid
+        std::vector< int32_t > BoidFlockIndices;
+        // Multiplier of PursuitDistanceBehind for each boid
+        std::vector< float > PursuitOffsetMultipliers;
+        // Indices of the boids whose steering velocity is computed, in ascending order. See FUpdateScheduler
+        std::vector< int32_t > BoidsToUpdate;
+    };
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "FlockingCore/AFCoreFlockState.h"
+
+#include <cstdint>
+
+namespace AFFlockingCore
+{
+    /* Velocity which goes from velocity toward steering_velocity, changing by at most max_acceleration * delta_time.
+     * A max_acceleration of 0 returns the steering velocity */
+    FVec3 GetAcceleratedVelocity( const FVec3 & velocity, const FVec3 & steering_velocity, float delta_time, float max_acceleration );
+
+    /* Moves the boids which are not driven by a movement component : their velocity goes toward their steering velocity,
+     * changing by at most max_acceleration * delta_time, then their center moves by velocity * delta_time.
+     * A max_acceleration of 0 applies the steering velocity instantly, like UCharacterMovementComponent::RequestDirectMove does for flying characters. */
+    void IntegrateBoids( FBoid * boids, int32_t boids_count, float delta_time, float max_acceleration );
+
+    /* Moves the boids of state with their steering velocity, and the owners of the flocks with their velocity, so the next fixed step of a tick
+     * computes the steering from where the boids will be after this one, although they only move once per tick */
+    void AdvanceFixedStep( FFlockState & state, float step_duration );
+}
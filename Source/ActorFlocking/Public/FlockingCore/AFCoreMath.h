@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+/* Engine independent flocking simulation.
+ * Nothing in the FlockingCore folder depends on the engine, which allows to build it in the standalone benchmark (see Benchmark/CMakeLists.txt).
+ */
+namespace AFFlockingCore
+{
+    constexpr float SmallNumber = 1.e-8f;
+
+    template < typename _TYPE_ >
+    inline _TYPE_ Clamp( const _TYPE_ value, const _TYPE_ minimum, const _TYPE_ maximum )
+    {
+        return value < minimum ? minimum : ( value < maximum ? value : maximum );
+    }
+
+    inline float Lerp( const float start, const float end, const float ratio )
+    {
+        return start + ratio * ( end - start );
+    }
+
+    inline float Square( const float value )
+    {
+        return value * value;
+    }
+
+    struct FVec3
+    {
+        FVec3() = default;
+
+        explicit FVec3( const float value ) :
+            X( value ),
+            Y( value ),
+            Z( value )
+        {
+        }
+
+        FVec3( const float x, const float y, const float z ) :
+            X( x ),
+            Y( y ),
+            Z( z )
+        {
+        }
+
+        FVec3 operator+( const FVec3 & other ) const
+        {
+            return FVec3( X + other.X, Y + other.Y, Z + other.Z );
+        }
+
+        FVec3 operator-( const FVec3 & other ) const
+        {
+            return FVec3( X - other.X, Y - other.Y, Z - other.Z );
+        }
+
+        FVec3 operator*( const float scale ) const
+        {
+            return FVec3( X * scale, Y * scale, Z * scale );
+        }
+
+        FVec3 operator/( const float scale ) const
+        {
+            const auto inverse_scale = 1.0f / scale;
+            return FVec3( X * inverse_scale, Y * inverse_scale, Z * inverse_scale );
+        }
+
+        FVec3 & operator+=( const FVec3 & other )
+        {
+            X += other.X;
+            Y += other.Y;
+            Z += other.Z;
+            return *this;
+        }
+
+        FVec3 & operator-=( const FVec3 & other )
+        {
+            X -= other.X;
+            Y -= other.Y;
+            Z -= other.Z;
+            return *this;
+        }
+
+        FVec3 & operator*=( const float scale )
+        {
+            X *= scale;
+            Y *= scale;
+            Z *= scale;
+            return *this;
+        }
+
+        FVec3 & operator/=( const float scale )
+        {
+            const auto inverse_scale = 1.0f / scale;
+            X *= inverse_scale;
+            Y *= inverse_scale;
+            Z *= inverse_scale;
+            return *this;
+        }
+
+        float SizeSquared() const
+        {
+            return X * X + Y * Y + Z * Z;
+        }
+
+        float Size() const
+        {
+            return std::sqrt( SizeSquared() );
+        }
+
+        bool IsNearlyZero( const float tolerance = SmallNumber ) const
+        {
+            return std::abs( X ) <= tolerance && std::abs( Y ) <= tolerance && std::abs( Z ) <= tolerance;
+        }
+
+        // Same contract as FVector::GetSafeNormal : returns a zero vector if the vector is too small to be normalized
+        FVec3 GetSafeNormal( const float tolerance = SmallNumber ) const
+        {
+            const auto size_squared = SizeSquared();
+
+            if ( size_squared == 1.0f )
+            {
+                return *this;
+            }
+
+            if ( size_squared < tolerance )
+            {
+                return FVec3( 0.0f );
+            }
+
+            return *this * ( 1.0f / std::sqrt( size_squared ) );
+        }
+
+        // Same contract as FVector::Normalize : leaves the vector untouched if it is too small to be normalized
+        bool Normalize( const float tolerance = SmallNumber )
+        {
+            const auto size_squared = SizeSquared();
+
+            if ( size_squared > tolerance )
+            {
+                *this *= 1.0f / std::sqrt( size_squared );
+                return true;
+            }
+
+            return false;
+        }
+
+        static float DotProduct( const FVec3 & first, const FVec3 & second )
+        {
+            return first.X * second.X + first.Y * second.Y + first.Z * second.Z;
+        }
+
+        float X;
+        float Y;
+        float Z;
+    };
+
+    inline FVec3 operator*( const float scale, const FVec3 & vector )
+    {
+        return vector * scale;
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "FlockingCore/AFCoreMath.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace AFFlockingCore
+{
+    // Interleaves the 10 lowest bits of each coordinate in a 30 bits Z-order curve code
+    uint32_t EncodeMortonCode( uint32_t x, uint32_t y, uint32_t z );
+
+    /* Fills order with the indices of the centers sorted along a Z-order curve over their bounding box, so the boids which are close in space get close in memory.
+     * Equal codes keep their relative order. keys is scratch memory */
+    void SortByMortonCode( int32_t * order, const FVec3 * centers, int32_t centers_count, std::vector< uint64_t > & keys );
+}
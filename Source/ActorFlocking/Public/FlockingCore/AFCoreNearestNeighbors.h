@@ -0,0 +1,36 @@
+#pragma once
+
+#include "FlockingCore/AFCoreNeighborForces.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace AFFlockingCore
+{
+    class FSpatialHashGrid;
+
+    /* Memory reused by the k nearest neighbors queries of a thread */
+    struct FNearestNeighborsScratch
+    {
+        FNearestNeighborsScratch();
+
+        // Bounded max heaps of ( squared distance, boid index ), the farthest neighbor on top
+        std::vector< std::pair< float, int32_t > > SameFlockNeighbors;
+        std::vector< std::pair< float, int32_t > > OtherFlocksNeighbors;
+        // Buckets visited by the current query are marked with its stamp, because cells of different shells can share a bucket
+        std::vector< uint32_t > VisitedBucketsStamps;
+        uint32_t Stamp;
+    };
+
+    /* Picks the cell size of the spatial hash used by the k nearest neighbors queries : small enough to hold about max_neighbors_count boids per cell
+     * at the average density of the boids, so a query stops after a few shells even when the whole flock is within the radii, but not so small that
+     * an isolated boid must visit too many shells to reach neighbor_radius */
+    float GetNearestNeighborsCellSize( const FFlockState & state, float neighbor_radius, int32_t max_neighbors_count );
+
+    /* Topological kernel : each force only takes into account the max_neighbors_count nearest boids within its radius.
+     * The boids are searched in shells of cells of increasing distance, which stops as soon as the nearest ones are known,
+     * so the cost of a boid does not depend on how many boids are within the radii. The selected neighbors are accumulated in ascending index order.
+     * Returns the number of pairs which have been tested, and adds the number of boids found in the visited buckets to neighbor_candidates_count. */
+    int32_t AccumulateNearestNeighborForces( FNeighborForces & forces, int64_t & neighbor_candidates_count, int32_t boid_index, const FFlockState & state, const FSpatialHashGrid & spatial_hash, const FNeighborRadii & radii, int32_t max_neighbors_count, bool separate_from_other_flocks, FNearestNeighborsScratch & scratch );
+}
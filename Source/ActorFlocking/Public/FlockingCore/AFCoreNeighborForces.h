@@ -0,0 +1,58 @@
+#pragma once
+
+#include "FlockingCore/AFCoreFlockState.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace AFFlockingCore
+{
+    /* Forces and outputs of the steering computation. The kernels take a combination of them as template parameter, so a disabled force is compiled out
+     * of the loops over the neighbors instead of being tested for every pair */
+    namespace ESteeringFeatures
+    {
+        enum Type : uint32_t
+        {
+            Alignment = 1u << 0,
+            Cohesion = 1u << 1,
+            Separation = 1u << 2,
+            DebugForces = 1u << 3,
+
+            NeighborForces = Alignment | Cohesion | Separation,
+            // Number of combinations of the features
+            CombinationsCount = 1u << 4
+        };
+    }
+
+    /* Sums of the neighbors contributions to the alignment, cohesion and separation forces of a boid, before they get averaged */
+    struct FNeighborForces
+    {
+        FNeighborForces();
+
+        FVec3 AlignmentForce;
+        FVec3 CohesionForce;
+        FVec3 SeparationForce;
+        int32_t AlignmentBoidsCount;
+        int32_t CohesionBoidsCount;
+        int32_t SeparationBoidsCount;
+    };
+
+    struct FNeighborRadii
+    {
+        float AlignmentRadius;
+        float CohesionRadius;
+        float SeparationRadius;
+    };
+
+    /* Scalar reference kernel, which tests the candidates in the order they are given. Returns the number of pairs which have been tested.
+     * Only the boids of the same flock contribute to the forces, unless separate_from_other_flocks is true, in which case the boids of the other flocks contribute to the separation force.
+     * Only the forces of _FEATURES_ are accumulated. It is instantiated for all the combinations of ESteeringFeatures::NeighborForces */
+    template < uint32_t _FEATURES_ = ESteeringFeatures::NeighborForces >
+    int32_t AccumulateNeighborForces( FNeighborForces & forces, int32_t boid_index, const FFlockState & state, const int32_t * candidates, int32_t candidates_count, const FNeighborRadii & radii, bool separate_from_other_flocks );
+
+    template < uint32_t _FEATURES_ = ESteeringFeatures::NeighborForces >
+    inline int32_t AccumulateNeighborForces( FNeighborForces & forces, const int32_t boid_index, const FFlockState & state, const std::vector< int32_t > & candidates, const FNeighborRadii & radii, const bool separate_from_other_flocks )
+    {
+        return AccumulateNeighborForces< _FEATURES_ >( forces, boid_index, state, candidates.data(), static_cast< int32_t >( candidates.size() ), radii, separate_from_other_flocks );
+    }
+}
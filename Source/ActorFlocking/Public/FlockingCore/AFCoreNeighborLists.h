@@ -0,0 +1,51 @@
+#pragma once
+
+#include "FlockingCore/AFCoreFlockState.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace AFFlockingCore
+{
+    class FSpatialHashGrid;
+
+    /* Verlet neighbor lists : for each boid, the indices of the boids within a cutoff radius, which is the neighbor radius plus a skin distance.
+     * The lists can replace the spatial hash queries until a boid which was outside of the cutoff radius may have come within the neighbor radius,
+     * which can't happen as long as no boid moved more than half of the margin between the cutoff radius and the neighbor radius since the build.
+     */
+    class FNeighborLists
+    {
+    public:
+        FNeighborLists();
+
+        // False if the number of boids or their order changed, or if the boids moved too much since the build for the lists to contain all the boids within neighbor_radius
+        bool IsValidFor( const FFlockState & state, float neighbor_radius ) const;
+
+        // The cell size of spatial_hash must be at least cutoff_radius. Each list is sorted in ascending order, like FSpatialHashGrid::GatherCandidates
+        void Build( const FFlockState & state, const FSpatialHashGrid & spatial_hash, float cutoff_radius );
+
+        const int32_t * GetNeighbors( int32_t boid_index ) const;
+        int32_t GetNeighborsCount( int32_t boid_index ) const;
+        float GetAverageLength() const;
+        size_t GetAllocatedSize() const;
+
+    private:
+        float CutoffRadius;
+        // Centers of the boids when the lists were built
+        std::vector< FVec3 > ReferenceCenters;
+        std::vector< uint32_t > FlocksBoidsOrderVersions;
+        // The neighbors of the boid at boid_index are in [ Offsets[ boid_index ], Offsets[ boid_index + 1 ] ) of Neighbors
+        std::vector< int32_t > Offsets;
+        std::vector< int32_t > Neighbors;
+    };
+
+    inline const int32_t * FNeighborLists::GetNeighbors( const int32_t boid_index ) const
+    {
+        return Neighbors.data() + Offsets[ boid_index ];
+    }
+
+    inline int32_t FNeighborLists::GetNeighborsCount( const int32_t boid_index ) const
+    {
+        return Offsets[ boid_index + 1 ] - Offsets[ boid_index ];
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace AFFlockingCore
+{
+    /* Permutation between the index where each boid is stored, which never changes while the boid is in the flock, and its position in the queue of the flock,
+     * which selects its pursuit offset multiplier. Changing the queue positions of the boids only updates this table, and never moves their data */
+    class FQueueSlots
+    {
+    public:
+        int32_t Num() const;
+        int32_t GetPosition( int32_t boid_index ) const;
+        int32_t GetBoidIndex( int32_t position ) const;
+
+        // The new boid is stored after the others, at the end of the queue
+        void Add();
+
+        /* The boids queued after the removed boid move up one position, in order, and the last stored boid takes its index, like TArray::RemoveAtSwap.
+         * Linear in the number of positions after the removed one, over integers only. Returns the position of the removed boid */
+        int32_t Remove( int32_t boid_index );
+
+        void SwapPositions( int32_t first_position, int32_t second_position );
+
+        /* Position at a distance between min_distance and max_distance of position in the queue, both included, picked by random_ratio in [0;1].
+         * Constant time, without allocation. Returns -1 when there is no such position */
+        int32_t GetPositionAround( int32_t position, int32_t min_distance, int32_t max_distance, float random_ratio ) const;
+
+        /* Gives the positions whose target is the furthest along the queue to the boids the furthest along it, so the boids do not cross the whole formation to reach their position.
+         * boid_targets is the coordinate of each stored boid along the queue, and position_targets the coordinate of the target of each position, in the same unit.
+         * Matching both sorted orders minimizes the distance the boids travel along the queue. Sorts scratch arrays, which do not allocate once they are big enough */
+        void AssignPositionsByProximity( const float * boid_targets, const float * position_targets );
+
+    private:
+        std::vector< int32_t > Positions;
+        std::vector< int32_t > BoidIndices;
+        std::vector< int32_t > SortedBoidIndices;
+        std::vector< int32_t > SortedPositions;
+    };
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "FlockingCore/AFCoreFlockState.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace AFFlockingCore
+{
+    /* Uniform spatial hash over the boids centers, rebuilt every tick.
+     * Boids are bucketed by cell with a counting sort, so a query only has to look at the 27 cells around a location
+     * instead of the whole flock. The cell size must be at least as large as the biggest query radius.
+     */
+    class FSpatialHashGrid
+    {
+    public:
+        FSpatialHashGrid();
+
+        void Build( const std::vector< FBoid > & boids, float cell_size );
+
+        /* Fills candidates with the indices of the boids in the cells surrounding location, sorted in ascending order.
+         * Candidates are a superset of the boids within cell_size of location. */
+        void GatherCandidates( const FVec3 & location, std::vector< int32_t > & candidates ) const;
+
+        /* Calls functor( first, last ) once for each bucket around location, where [first, last) is a range of GetSortedBoidIndices() */
+        template < typename _FUNCTOR_ >
+        void ForEachBucketAround( const FVec3 & location, const _FUNCTOR_ & functor ) const;
+
+        /* Calls functor( bucket_index, first, last ) for each non empty bucket of the cells at a Chebyshev distance of exactly shell cells from the cell of location.
+         * The boids of the shell are at least ( shell - 1 ) * cell size away from location. Different cells can share a bucket, even across shells : the caller must skip the buckets it already visited */
+        template < typename _FUNCTOR_ >
+        void ForEachBucketInShell( const FVec3 & location, int32_t shell, const _FUNCTOR_ & functor ) const;
+
+        /* Boid indices ordered by bucket. The boids of a bucket are stored contiguously, in ascending order */
+        const std::vector< int32_t > & GetSortedBoidIndices() const;
+
+        bool IsValid() const;
+        float GetCellSize() const;
+        uint32_t GetBucketsCount() const;
+        size_t GetAllocatedSize() const;
+
+    private:
+        struct FCellCoordinates
+        {
+            int32_t X;
+            int32_t Y;
+            int32_t Z;
+        };
+
+        FCellCoordinates GetCellCoordinates( const FVec3 & location ) const;
+        uint32_t GetBucketIndex( int32_t x, int32_t y, int32_t z ) const;
+
+        float InverseCellSize;
+        uint32_t BucketMask;
+        std::vector< int32_t > BucketStarts;
+        std::vector< int32_t > SortedBoidIndices;
+        std::vector< uint32_t > BoidBuckets;
+    };
+
+    template < typename _FUNCTOR_ >
+    void FSpatialHashGrid::ForEachBucketAround( const FVec3 & location, const _FUNCTOR_ & functor ) const
+    {
+        if ( !IsValid() )
+        {
+            return;
+        }
+
+        const auto cell_coordinates = GetCellCoordinates( location );
+
+        // Different cells can share a bucket : make sure each bucket is only visited once
+        uint32_t visited_buckets[ 27 ];
+        auto visited_buckets_count = 0;
+
+        for ( auto z = -1; z <= 1; ++z )
+        {
+            for ( auto y = -1; y <= 1; ++y )
+            {
+                for ( auto x = -1; x <= 1; ++x )
+                {
+                    const auto bucket_index = GetBucketIndex( cell_coordinates.X + x, cell_coordinates.Y + y, cell_coordinates.Z + z );
+
+                    auto already_visited = false;
+                    for ( auto visited_index = 0; visited_index < visited_buckets_count; ++visited_index )
+                    {
+                        if ( visited_buckets[ visited_index ] == bucket_index )
+                        {
+                            already_visited = true;
+                            break;
+                        }
+                    }
+
+                    if ( already_visited )
+                    {
+                        continue;
+                    }
+
+                    visited_buckets[ visited_buckets_count++ ] = bucket_index;
+
+                    const auto first = BucketStarts[ bucket_index ];
+                    const auto last = BucketStarts[ bucket_index + 1 ];
+
+                    if ( first != last )
+                    {
+                        functor( first, last );
+                    }
+                }
+            }
+        }
+    }
+
+    template < typename _FUNCTOR_ >
+    void FSpatialHashGrid::ForEachBucketInShell( const FVec3 & location, const int32_t shell, const _FUNCTOR_ & functor ) const
+    {
+        if ( !IsValid() )
+        {
+            return;
+        }
+
+        const auto cell_coordinates = GetCellCoordinates( location );
+
+        for ( auto z = -shell; z <= shell; ++z )
+        {
+            for ( auto y = -shell; y <= shell; ++y )
+            {
+                const auto is_on_shell_face = z == -shell || z == shell || y == -shell || y == shell;
+
+                // Inside the faces, only the first and the last cells of the row belong to the shell
+                const auto x_step = is_on_shell_face || shell == 0 ? 1 : 2 * shell;
+
+                for ( auto x = -shell; x <= shell; x += x_step )
+                {
+                    const auto bucket_index = GetBucketIndex( cell_coordinates.X + x, cell_coordinates.Y + y, cell_coordinates.Z + z );
+                    const auto first = BucketStarts[ bucket_index ];
+                    const auto last = BucketStarts[ bucket_index + 1 ];
+
+                    if ( first != last )
+                    {
+                        functor( bucket_index, first, last );
+                    }
+                }
+            }
+        }
+    }
+
+    inline const std::vector< int32_t > & FSpatialHashGrid::GetSortedBoidIndices() const
+    {
+        return SortedBoidIndices;
+    }
+
+    inline bool FSpatialHashGrid::IsValid() const
+    {
+        return InverseCellSize > 0.0f;
+    }
+
+    inline float FSpatialHashGrid::GetCellSize() const
+    {
+        return InverseCellSize > 0.0f ? 1.0f / InverseCellSize : 0.0f;
+    }
+
+    inline uint32_t FSpatialHashGrid::GetBucketsCount() const
+    {
+        return BucketMask + 1;
+    }
+
+    inline FSpatialHashGrid::FCellCoordinates FSpatialHashGrid::GetCellCoordinates( const FVec3 & location ) const
+    {
+        return FCellCoordinates {
+            static_cast< int32_t >( std::floor( location.X * InverseCellSize ) ),
+            static_cast< int32_t >( std::floor( location.Y * InverseCellSize ) ),
+            static_cast< int32_t >( std::floor( location.Z * InverseCellSize ) )
+        };
+    }
+
+    inline uint32_t FSpatialHashGrid::GetBucketIndex( const int32_t x, const int32_t y, const int32_t z ) const
+    {
+        const auto hash = static_cast< uint32_t >( x ) * 73856093u
+                          ^ static_cast< uint32_t >( y ) * 19349663u
+                          ^ static_cast< uint32_t >( z ) * 83492791u;
+
+        return hash & BucketMask;
+    }
+}
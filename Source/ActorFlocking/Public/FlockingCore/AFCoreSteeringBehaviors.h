@@ -0,0 +1,52 @@
+#pragma once
+
+#include "FlockingCore/AFCoreFlockState.h"
+
+namespace AFFlockingCore
+{
+    inline FVec3 Seek( const FBoid & boid, const FVec3 & target, const float slowdown_distance = 100.0f )
+    {
+        const auto to_target = target - boid.Center;
+        const auto to_target_direction = to_target.GetSafeNormal();
+
+        auto desired_velocity = to_target_direction * boid.MaxVelocity;
+
+        if ( slowdown_distance > 0.0f )
+        {
+            const auto distance_to_target = to_target.Size();
+            const auto slowdown_falloff = Clamp( distance_to_target / slowdown_distance, 0.0f, 1.0f );
+
+            desired_velocity *= slowdown_falloff;
+        }
+
+        return desired_velocity;
+    }
+
+    inline FVec3 Flee( const FBoid & boid, const FVec3 & from )
+    {
+        const auto desired_velocity = ( boid.Center - from ).GetSafeNormal() * boid.MaxVelocity;
+        return desired_velocity;
+    }
+
+    inline FVec3 Pursuit( const FBoid & boid, const FVec3 & target, const FVec3 & target_velocity, const float slowdown_distance = 100.0f )
+    {
+        const auto distance = ( target - boid.Center ).Size();
+        const auto time = distance / boid.MaxVelocity;
+        const auto future_position = target + target_velocity * time;
+        return Seek( boid, future_position, slowdown_distance );
+    }
+
+    inline FVec3 Evade( const FBoid & boid, const FVec3 & target, const FVec3 & target_velocity )
+    {
+        const auto distance = ( target - boid.Center ).Size();
+        const auto time = distance / boid.MaxVelocity;
+        const auto future_position = target + target_velocity * time;
+        return Flee( boid, future_position );
+    }
+
+    inline FVec3 FollowLeader( const FBoid & boid, const FBoid & leader_boid, const float distance = 100.0f )
+    {
+        const auto target = leader_boid.Velocity.GetSafeNormal() * -1.0f * distance;
+        return Seek( boid, target );
+    }
+}
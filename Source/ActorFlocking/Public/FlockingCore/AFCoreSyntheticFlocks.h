@@ -0,0 +1,65 @@
+#pragma once
+
+#include "FlockingCore/AFCoreFlockSimulation.h"
+#include "FlockingCore/AFCoreFlockState.h"
+
+#include <cstdint>
+
+namespace AFFlockingCore
+{
+    /* PCG32, so the synthetic flocks are the same on every platform and standard library */
+    class FSyntheticRandom
+    {
+    public:
+        explicit FSyntheticRandom( uint32_t seed );
+
+        uint32_t Next();
+        float Range( float min_value, float max_value );
+        FVec3 PointInSphere( float radius );
+
+    private:
+        uint64_t State;
+        uint64_t Increment;
+    };
+
+    /* Seeded flocks shared by the standalone benchmark and the automation tests of the plugin,
+     * so the checksums printed by the benchmark are the golden values of the tests */
+    struct FSyntheticFlocksParams
+    {
+        FSyntheticFlocksParams();
+
+        // The boids are split in this number of flocks, spread along the X axis
+        int32_t FlocksCount;
+        // Added to the number of boids, so each size gets its own flocks
+        uint32_t Seed;
+        // Average distance between two boids, which keeps the density of the flock constant whatever its size
+        float BoidSpacing;
+        bool bUseLOD;
+        // Copied to each flock
+        FFlockParams Params;
+    };
+
+    FFlockState MakeSyntheticFlocks( int32_t boids_count, const FSyntheticFlocksParams & params );
+
+    // Each owner flies in a large circle around the origin of its flock
+    void UpdateSyntheticOwners( FFlockState & state, float time, const FSyntheticFlocksParams & params );
+
+    // Sum of the coordinates of the centers of the boids, accumulated in double so the result does not depend on the size of the flocks
+    double GetCentersChecksum( const FFlockState & state );
+
+    // Sum of the components of the steering velocities of the boids updated by the last steering update
+    double GetSteeringChecksum( const FFlockState & state );
+
+    // Difference between the steering velocities of the same boids in two states, relative to the max velocity of each boid
+    struct FSteeringError
+    {
+        double MeanError;
+        double MaxError;
+    };
+
+    FSteeringError GetSteeringError( const FFlockState & state, const FFlockState & reference_state );
+
+    /* Steering velocities of the first tick of the synthetic flocks computed with the far field octree, compared against the same flocks without it,
+     * where every pair within the radii is tested */
+    FSteeringError MeasureFarFieldError( int32_t boids_count, const FSyntheticFlocksParams & params, const FSteeringOptions & options );
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "FlockingCore/AFCoreFlockState.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace AFFlockingCore
+{
+    struct FSchedulerCounters
+    {
+        FSchedulerCounters();
+
+        // Number of boids in each level of detail
+        int32_t LODBoidsCounts[ LODLevelsCount ];
+        // Boids whose update interval elapsed, but which are left for a next frame to respect the budget
+        int32_t DeferredBoidsCount;
+        int32_t UpdatedBoidsCount;
+    };
+
+    /* Decides which boids compute their steering velocity this frame, and fills FFlockState::BoidsToUpdate with them.
+     * - The level of detail of a boid depends on its distance to the closest viewer, and defines how many frames it waits between two updates.
+     * - When a budget is given, the boids which are due are sorted by staleness and only the ones which fit in the budget are updated.
+     *   The other ones become staler, so they come first the next frame, which round-robins the work across the frames.
+     * The cost of an update is estimated from the durations reported by the caller.
+     */
+    class FUpdateScheduler
+    {
+    public:
+        FUpdateScheduler();
+
+        FSchedulerCounters Schedule( FFlockState & state, const std::vector< FVec3 > & viewer_locations, float budget_microseconds );
+
+        // To call after the boids scheduled by the last call to Schedule have been updated
+        void ReportUpdateDuration( int32_t updated_boids_count, double build_neighbor_search_microseconds, double compute_steering_microseconds );
+
+    private:
+        int32_t GetLODLevel( const FLODParams & lod_params, const FVec3 & location, const std::vector< FVec3 > & viewer_locations ) const;
+
+        double BuildNeighborSearchMicroseconds;
+        double MicrosecondsPerBoid;
+        uint32_t FrameIndex;
+        std::vector< int32_t > DueBoidIndices;
+    };
+}